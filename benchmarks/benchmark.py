@@ -0,0 +1,280 @@
+"""
+Benchmarks of the hot paths of the C interface, run against a local snmpd
+(by default the one the tests use, started with tests/snmpd.conf).
+
+    python benchmarks/benchmark.py --output results.json
+    python benchmarks/benchmark.py --baseline results.json
+
+Results are written as JSON so that runs may be compared; with --baseline
+the run is compared to an earlier one and exits with a non-zero status if
+any benchmark got slower by more than --threshold percent.
+"""
+
+from __future__ import print_function, unicode_literals
+
+import argparse
+import json
+import logging
+import platform
+import sys
+import threading
+import time
+
+import easysnmp
+
+try:
+    cpu_time = time.process_time
+except AttributeError:  # Python 2
+    cpu_time = time.clock
+
+# OIDs of the system group, all of which tests/snmpd.conf serves
+SYSTEM_OIDS = [
+    'sysDescr.0', 'sysObjectID.0', 'sysUpTime.0', 'sysContact.0',
+    'sysName.0', 'sysLocation.0', 'sysServices.0', 'sysORLastChange.0'
+]
+
+# The value formatting options which read_variable branches on
+DECODE_OPTIONS = [
+    ('default', {}),
+    ('use_sprint_value', {'use_sprint_value': True}),
+    ('use_enums', {'use_enums': True}),
+    ('use_numeric', {'use_numeric': True}),
+    ('use_bytes', {'use_bytes': True}),
+]
+
+
+def percentile(samples, fraction):
+    samples = sorted(samples)
+    return samples[min(len(samples) - 1, int(len(samples) * fraction))]
+
+
+def summarise(samples, count=1):
+    """
+    Summarise the durations of repeated runs which each handled count
+    items (e.g. varbinds or rows)
+    """
+
+    median = percentile(samples, 0.5)
+    return {
+        'runs': len(samples),
+        'items': count,
+        'min': min(samples),
+        'median': median,
+        'p95': percentile(samples, 0.95),
+        'items_per_sec': count / median if median else None,
+    }
+
+
+def time_runs(func, repeat, clock=time.time):
+    """
+    Time repeat calls of func after a warm-up call, returning the
+    durations and whatever the last call returned
+    """
+
+    result = func()
+    samples = []
+    for _ in range(repeat):
+        start = clock()
+        result = func()
+        samples.append(clock() - start)
+
+    return samples, result
+
+
+def bench_get_single(session_args, repeat):
+    session = easysnmp.Session(**session_args)
+    samples, _ = time_runs(lambda: session.get('sysUpTime.0'), repeat)
+    return summarise(samples)
+
+
+def bench_get_multi(session_args, repeat):
+    session = easysnmp.Session(max_varbinds_per_pdu=0, **session_args)
+    samples, _ = time_runs(lambda: session.get(SYSTEM_OIDS), repeat)
+    return summarise(samples, len(SYSTEM_OIDS))
+
+
+def bench_walk(session_args, repeat, oid):
+    session = easysnmp.Session(**session_args)
+    samples, rows = time_runs(lambda: session.walk(oid), repeat)
+    return summarise(samples, len(rows))
+
+
+def bench_bulkwalk(session_args, repeat, oid):
+    session = easysnmp.Session(**session_args)
+    samples, rows = time_runs(lambda: session.bulkwalk(oid), repeat)
+    return summarise(samples, len(rows))
+
+
+def bench_bulkwalk_threads(session_args, repeat, oid, threads):
+    """
+    The wall clock time taken by threads threads bulkwalking at once, each
+    with its own session; since responses are decoded without the GIL this
+    should scale with the threads rather than stay near one thread's time
+    """
+
+    sessions = [easysnmp.Session(**session_args) for _ in range(threads)]
+    counts = [0] * threads
+
+    def walk(index):
+        counts[index] = len(sessions[index].bulkwalk(oid))
+
+    def run_threads():
+        workers = [
+            threading.Thread(target=walk, args=(index,))
+            for index in range(threads)
+        ]
+        for worker in workers:
+            worker.start()
+        for worker in workers:
+            worker.join()
+
+    samples, _ = time_runs(run_threads, repeat)
+    return summarise(samples, sum(counts))
+
+
+def bench_decode(session_args, repeat, oid, options):
+    """
+    The CPU time spent per varbind of a bulkwalk, most of which goes on
+    read_variable turning each varbind into an SNMPVariable; unlike wall
+    clock time this leaves out the time spent waiting for the agent
+    """
+
+    session_args = dict(session_args)
+    session_args.update(options)
+    session = easysnmp.Session(**session_args)
+    samples, rows = time_runs(
+        lambda: session.bulkwalk(oid), repeat, clock=cpu_time
+    )
+    result = summarise([sample / len(rows) for sample in samples])
+    result['items'] = len(rows)
+    return result
+
+
+def run(args):
+    session_args = {
+        'hostname': args.hostname,
+        'remote_port': args.port,
+        'version': args.version,
+    }
+    if args.version == 3:
+        session_args.update(
+            security_level='authPriv', security_username='initial',
+            privacy_password='priv_pass', auth_password='auth_pass'
+        )
+    else:
+        session_args['community'] = args.community
+
+    benchmarks = [
+        ('get_single', lambda: bench_get_single(session_args, args.repeat)),
+        ('get_multi', lambda: bench_get_multi(session_args, args.repeat)),
+        ('walk', lambda: bench_walk(session_args, args.walk_repeat,
+                                    args.walk_oid)),
+    ]
+    if args.version != 1:
+        benchmarks.append(
+            ('bulkwalk', lambda: bench_bulkwalk(session_args,
+                                                args.walk_repeat,
+                                                args.walk_oid))
+        )
+        benchmarks.append(
+            ('bulkwalk_threads', lambda: bench_bulkwalk_threads(
+                session_args, args.walk_repeat, args.walk_oid, args.threads
+            ))
+        )
+        for name, options in DECODE_OPTIONS:
+            benchmarks.append((
+                'decode_' + name,
+                lambda options=options: bench_decode(
+                    session_args, args.walk_repeat, args.walk_oid, options
+                )
+            ))
+
+    results = {}
+    for name, func in benchmarks:
+        if args.only and name not in args.only:
+            continue
+        results[name] = func()
+        print('{0:24} median {1:.6f}s  p95 {2:.6f}s'.format(
+            name, results[name]['median'], results[name]['p95']
+        ), file=sys.stderr)
+
+    return {
+        'metadata': {
+            'timestamp': time.time(),
+            'python': platform.python_version(),
+            'platform': platform.platform(),
+            'version': args.version,
+            'walk_oid': args.walk_oid,
+        },
+        'benchmarks': results,
+    }
+
+
+def compare(results, baseline, threshold):
+    """
+    Compare the medians of a run with those of a baseline run, returning
+    the names of the benchmarks which got slower by more than threshold
+    percent
+    """
+
+    regressions = []
+    for name, result in sorted(results['benchmarks'].items()):
+        before = baseline['benchmarks'].get(name)
+        if not before or not before['median']:
+            continue
+
+        change = (result['median'] - before['median']) / before['median']
+        print('{0:24} {1:+.1f}%'.format(name, change * 100), file=sys.stderr)
+        if change * 100 > threshold:
+            regressions.append(name)
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--hostname', default='localhost')
+    parser.add_argument('--port', type=int, default=11161)
+    parser.add_argument('--version', type=int, choices=(1, 2, 3), default=2)
+    parser.add_argument('--community', default='public')
+    parser.add_argument('--repeat', type=int, default=1000,
+                        help='runs of each get benchmark')
+    parser.add_argument('--walk-repeat', type=int, default=20,
+                        help='runs of each walk and decode benchmark')
+    parser.add_argument('--walk-oid', default='mib-2',
+                        help='subtree walked by the walk benchmarks')
+    parser.add_argument('--threads', type=int, default=4,
+                        help='threads of the bulkwalk_threads benchmark')
+    parser.add_argument('--only', action='append',
+                        help='run only the named benchmark (repeatable)')
+    parser.add_argument('--output', help='write the JSON results here')
+    parser.add_argument('--baseline',
+                        help='JSON results of an earlier run to compare to')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='percentage slowdown counted as a regression')
+    args = parser.parse_args()
+
+    # The C interface logs at DEBUG for every request
+    logging.getLogger('easysnmp.interface').disabled = True
+
+    results = run(args)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+    else:
+        json.dump(results, sys.stdout, indent=2, sort_keys=True)
+        print()
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = compare(results, json.load(f), args.threshold)
+        if regressions:
+            print('regressions: ' + ', '.join(regressions), file=sys.stderr)
+            return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
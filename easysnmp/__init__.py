@@ -1,11 +1,18 @@
 from .easy import (  # noqa
     snmp_get, snmp_set, snmp_set_multiple, snmp_get_next, snmp_get_bulk,
-    snmp_walk, snmp_bulkwalk
+    snmp_walk, snmp_bulkwalk, enable_session_cache, disable_session_cache
 )
+from .counters import CounterPoller  # noqa
 from .exceptions import (  # noqa
     EasySNMPError, EasySNMPConnectionError, EasySNMPTimeoutError,
     EasySNMPUnknownObjectIDError, EasySNMPNoSuchObjectError,
     EasySNMPNoSuchInstanceError, EasySNMPUndeterminedTypeError
 )
-from .session import Session  # noqa
+from .logs import refresh_log_level, set_log_level  # noqa
+from .mibs import load_mibs  # noqa
+from .poll import poll_many  # noqa
+from .pool import SessionPool  # noqa
+from .scheduler import PollJob, PollScheduler  # noqa
+from .session import PreparedRequest, Session  # noqa
+from .traps import SNMPNotification, TrapListener  # noqa
 from .variables import SNMPVariable  # noqa
@@ -0,0 +1,96 @@
+from __future__ import unicode_literals
+
+import os
+
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from . import interface
+
+
+class CounterPoller(object):
+    """
+    Polls COUNTER and COUNTER64 variables and returns how much each one
+    grew since it was last polled, and at what rate.  The last value of
+    every counter is kept by the C interface, keyed by agent and OID, so a
+    single poller may be used for any number of sessions.
+
+    A Counter32 which went backwards is assumed to have wrapped; a
+    Counter64 going backwards, a Counter32 falling by half its range or
+    more, or a counter changing type or going missing is taken to be a
+    discontinuity (e.g. the agent restarted) and gives no delta.
+
+    :param size_hint: the number of counters expected to be polled, so
+                      that the table need not grow to hold them
+    """
+
+    def __init__(self, size_hint=0):
+        self._table = interface.counter_table(size_hint)
+
+    def __len__(self):
+        return len(self._table)
+
+    @staticmethod
+    def _agent(session):
+        return '{0}:{1}/{2}'.format(
+            session.hostname, session.remote_port, session.context
+        )
+
+    def update(self, session, variables, timestamp=None):
+        """
+        Turns already retrieved counters into deltas and rates
+
+        :param session: the Session the variables were retrieved with
+        :param variables: a list of SNMPVariable objects
+        :param timestamp: the time at which they were retrieved in seconds
+                          (any clock will do as long as it is used for every
+                          update); defaults to a monotonic clock
+        :return: a list of (variable, delta, rate) tuples in the same order
+                 as variables, rate being per second; delta and rate are
+                 None for the first value of a counter, after a
+                 discontinuity and for variables which are not counters
+        """
+
+        return interface.counter_update(
+            self._table, self._agent(session), list(variables),
+            timestamp or 0
+        )
+
+    def poll(self, session, oids):
+        """
+        Retrieves counters with session.get and returns their deltas and
+        rates as for update
+
+        :param session: the Session to poll
+        :param oids: a list of OIDs as for Session.get
+        """
+
+        variables = session.get(oids)
+        if not isinstance(variables, list):
+            variables = [variables]
+
+        return self.update(session, variables)
+
+    def poll_walk(self, session, oids, **kwargs):
+        """
+        Walks counters (e.g. whole columns such as ifHCInOctets) with
+        session.bulkwalk, or session.walk for SNMP version 1, and returns
+        their deltas and rates as for update
+
+        :param session: the Session to poll
+        :param oids: a list of OIDs as for Session.bulkwalk
+        :param kwargs: further arguments of Session.bulkwalk
+        """
+
+        if session.version == 1:
+            variables = session.walk(oids)
+        else:
+            variables = session.bulkwalk(oids, **kwargs)
+
+        return self.update(session, variables)
+
+    def clear(self):
+        """
+        Forgets the last value of every counter
+        """
+
+        interface.counter_clear(self._table)
@@ -1,7 +1,98 @@
 from __future__ import unicode_literals
 
+import threading
+from collections import OrderedDict
+from contextlib import contextmanager
+
+from .exceptions import EasySNMPConnectionError, EasySNMPTimeoutError
 from .session import Session
 
+# The idle sessions kept by enable_session_cache, keyed by their arguments
+# and ordered from the least to the most recently used
+_session_cache = OrderedDict()
+_session_cache_lock = threading.Lock()
+_session_cache_size = 0
+
+
+def enable_session_cache(max_sessions=32):
+    """
+    Has the functions of the easy API reuse the sessions they open rather
+    than opening a new one on every call, which saves a socket and (for
+    SNMP version 3) an engine ID discovery and key localisation each
+    time.  Sessions are shared by calls with the same arguments (hostname,
+    port, version, credentials and all other options alike), a session
+    only ever being used by one call at a time, and the least recently
+    used are closed once more than max_sessions are idle.
+
+    :param max_sessions: the most idle sessions to keep open
+    """
+
+    global _session_cache_size
+
+    with _session_cache_lock:
+        _session_cache_size = max(0, int(max_sessions))
+        _trim_session_cache()
+
+
+def disable_session_cache():
+    """
+    Closes every session kept by enable_session_cache, and has the easy
+    API open a new session for every call again
+    """
+
+    enable_session_cache(0)
+
+
+def _trim_session_cache():
+    idle = sum(len(sessions) for sessions in _session_cache.values())
+    while idle > _session_cache_size:
+        key, sessions = next(iter(_session_cache.items()))
+        sessions.pop(0)
+        if not sessions:
+            del _session_cache[key]
+        idle -= 1
+
+
+@contextmanager
+def _session(session_kargs):
+    try:
+        key = tuple(sorted(session_kargs.items()))
+        hash(key)
+    except TypeError:
+        key = None
+
+    session = None
+    with _session_cache_lock:
+        if key is not None and _session_cache.get(key):
+            session = _session_cache[key].pop()
+            if not _session_cache[key]:
+                del _session_cache[key]
+
+    if session is None:
+        session = Session(**session_kargs)
+
+    discard = False
+    try:
+        yield session
+    except (EasySNMPConnectionError, EasySNMPTimeoutError):
+        # The agent may have gone away or restarted, so start afresh
+        discard = True
+        raise
+    finally:
+        if not discard:
+            _release_session(key, session)
+
+
+def _release_session(key, session):
+    with _session_cache_lock:
+        if key is None or not _session_cache_size:
+            return
+
+        _session_cache.setdefault(key, []).append(session)
+        # Python 2 has no move_to_end
+        _session_cache[key] = _session_cache.pop(key)
+        _trim_session_cache()
+
 
 def snmp_get(oids, **session_kargs):
     """
@@ -18,8 +109,8 @@ def snmp_get(oids, **session_kargs):
                           all parameters in the Session class are supported
     """
 
-    session = Session(**session_kargs)
-    return session.get(oids)
+    with _session(session_kargs) as session:
+        return session.get(oids)
 
 
 def snmp_set(oid, value, type=None, **session_kargs):
@@ -39,8 +130,8 @@ def snmp_set(oid, value, type=None, **session_kargs):
                           all parameters in the Session class are supported
     """
 
-    session = Session(**session_kargs)
-    return session.set(oid, value, type)
+    with _session(session_kargs) as session:
+        return session.set(oid, value, type)
 
 
 def snmp_set_multiple(oid_values, **session_kargs):
@@ -55,8 +146,8 @@ def snmp_set_multiple(oid_values, **session_kargs):
                           all parameters in the Session class are supported
     """
 
-    session = Session(**session_kargs)
-    return session.set_multiple(oid_values)
+    with _session(session_kargs) as session:
+        return session.set_multiple(oid_values)
 
 
 def snmp_get_next(oids, **session_kargs):
@@ -74,8 +165,8 @@ def snmp_get_next(oids, **session_kargs):
                           all parameters in the Session class are supported
     """
 
-    session = Session(**session_kargs)
-    return session.get_next(oids)
+    with _session(session_kargs) as session:
+        return session.get_next(oids)
 
 
 def snmp_get_bulk(oids, non_repeaters=0, max_repetitions=10, **session_kargs):
@@ -98,8 +189,8 @@ def snmp_get_bulk(oids, non_repeaters=0, max_repetitions=10, **session_kargs):
                           all parameters in the Session class are supported
     """
 
-    session = Session(**session_kargs)
-    return session.get_bulk(oids, non_repeaters, max_repetitions)
+    with _session(session_kargs) as session:
+        return session.get_bulk(oids, non_repeaters, max_repetitions)
 
 
 def snmp_walk(oids='.1.3.6.1.2.1', **session_kargs):
@@ -117,8 +208,8 @@ def snmp_walk(oids='.1.3.6.1.2.1', **session_kargs):
                           all parameters in the Session class are supported
     """
 
-    session = Session(**session_kargs)
-    return session.walk(oids)
+    with _session(session_kargs) as session:
+        return session.walk(oids)
 
 
 def snmp_bulkwalk(
@@ -143,5 +234,5 @@ def snmp_bulkwalk(
              were retrieved via SNMP
     """
 
-    session = Session(**session_kargs)
-    return session.bulkwalk(oids, non_repeaters, max_repetitions)
+    with _session(session_kargs) as session:
+        return session.bulkwalk(oids, non_repeaters, max_repetitions)
@@ -1,4 +1,6 @@
 #include <Python.h>
+#include <pythread.h>
+#include <structmember.h>
 #include <arpa/inet.h>
 #include <ctype.h>
 #include <errno.h>
@@ -12,6 +14,8 @@
 #include <sys/time.h>
 #endif
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,6 +27,15 @@
 /* include bitarray data structure for v1 queries */
 #include "simple_bitarray.h"
 
+/* include bounded cache used for OID translations */
+#include "simple_cache.h"
+
+/* include arena used for the per-call buffers of a session */
+#include "simple_arena.h"
+
+/* include hash table used for the state of polled counters */
+#include "simple_hashtable.h"
+
 /*
  * In snmpv1 when using retry_nosuch we need to track the
  * index of each bad OID in the responses using a bitarray;
@@ -32,6 +45,28 @@
  */
 #define DEFAULT_NUM_BAD_OIDS (sizeof(bitarray) * 8 * 3)
 
+/*
+ * Number of entries kept by each of the process-wide OID translation
+ * caches (tag and iid to OID array, response OID to label); a lookup that
+ * doesn't fit in OID_CACHE_MAX_KEY bytes bypasses the cache.
+ */
+#define OID_CACHE_SIZE (4096)
+#define OID_CACHE_MAX_KEY (512)
+
+/* Number of OIDs each session remembers its agent does not have */
+#define NOSUCH_CACHE_SIZE (1024)
+
+/*
+ * What a session remembers of an OID its agent does not have: the type
+ * it answered with (SNMP_NOSUCHOBJECT, SNMP_NOSUCHINSTANCE, or
+ * SNMP_ERR_NOSUCHNAME for an error elided by retry_nosuch) and when that
+ * is to be forgotten, in monotonic seconds.
+ */
+typedef struct {
+  long expires;
+  int type;
+} nosuch_cache_value;
+
 #define STRLEN(x) ((x) ? strlen((x)) : 0)
 
 #define SUCCESS (1)
@@ -41,6 +76,8 @@
 #define VARBIND_IID_F (1)
 #define VARBIND_VAL_F (2)
 #define VARBIND_TYPE_F (3)
+#define VARBIND_ROOT_F (4)
+#define VARBIND_NUM_F (5)
 
 #define TYPE_UNKNOWN (0)
 #define MAX_TYPE_NAME_LEN (32)
@@ -66,6 +103,35 @@
 
 typedef netsnmp_session SnmpSession;
 
+/*
+ * Upper bounds (in milliseconds) of the buckets of the RTT histogram kept
+ * by each session; a last bucket counts round trips longer than these.
+ */
+static const long session_rtt_bounds[] = {1,   2,   5,   10,   20,  50,
+                                          100, 200, 500, 1000, 5000};
+
+#define SESSION_RTT_BUCKETS                                                    \
+  (sizeof(session_rtt_bounds) / sizeof(session_rtt_bounds[0]) + 1)
+
+/*
+ * What a session has seen of its agent since it was created (or its
+ * statistics were last reset), returned by Session.stats().  Net-SNMP
+ * retransmits requests itself, so retries are inferred from how many
+ * times the timeout expired before a response came, and bytes_received
+ * is the BER size of the varbinds received rather than of whole packets.
+ */
+typedef struct {
+  unsigned long long pdus_sent;
+  unsigned long long responses;
+  unsigned long long retries;
+  unsigned long long timeouts;
+  unsigned long long nosuch_retries;
+  unsigned long long varbinds_decoded;
+  unsigned long long bytes_received;
+  double rtt_total;
+  unsigned long long rtt_histogram[SESSION_RTT_BUCKETS];
+} session_stats;
+
 /*
  * This structure is attached to the easysnmp.Session
  * object as a Python Capsule (or CObject).
@@ -73,7 +139,9 @@ typedef netsnmp_session SnmpSession;
  * This allows a one time allocation of large buffers
  * without resorting to (unnecessary) allocation on the
  * stack, but also remains thread safe; as long as only
- * one Session object is restricted to each thread.
+ * one Session object is restricted to each thread (see
+ * easysnmp.pool.SessionPool to share sessions between
+ * threads).
  *
  * This is allocated in create_session_capsule()
  * and later (automatically via garbage collection) destroyed
@@ -94,11 +162,87 @@ typedef struct {
   unsigned long snmp_version;
   int getlabel_flag;
   int sprintval_flag;
-  int old_format;
   int best_guess;
   int retry_nosuch;
+
+  /*
+   * Upper bound on the number of varbinds packed into a single GET or
+   * GETNEXT request; 0 means as many as the agent will accept.
+   */
+  int max_varbinds;
+
+  /*
+   * max_repetitions learned by adaptive bulkwalks on this session, 0 until
+   * the first one has run.
+   */
+  int bulk_repetitions;
+
+  /* return values as Python ints, bytes and tuples rather than strings */
+  int native_types;
+
+  /* return OCTET STR and Opaque values as bytes rather than strings */
+  int octet_bytes;
+
+  /*
+   * The options above are cached from the Session object on first use
+   * and reloaded whenever one of them is assigned to; oid_output_format
+   * is the NETSNMP_DS_LIB_OID_OUTPUT_FORMAT to format OIDs with (see
+   * __sprint_objid).
+   */
+  int options_loaded;
+  int oid_output_format;
+
+  /*
+   * Buffers of the operation in progress on this session, reset at the
+   * end of every call; arena_in_use guards against nested operations
+   * which then fall back to the heap.
+   */
+  simple_arena arena;
+  int arena_in_use;
+
+  session_stats stats;
+
+  /*
+   * OIDs which the agent answered NOSUCHOBJECT or NOSUCHINSTANCE to, or
+   * NOSUCHNAME to with retry_nosuch set, within the last missing_ttl
+   * seconds (nothing is kept when it is 0), which later GET requests
+   * leave out and answer locally rather than asking again (see
+   * send_packed_requests); allocated on first use and forgotten whenever
+   * the session options are reloaded.
+   */
+  simple_cache nosuch_cache;
+  long missing_ttl;
 } session_capsule_ctx;
 
+/*
+ * A response variable decoded by __decode_response: its MIB node and the
+ * offsets into decoded_pdu.strings of its label, instance index and (when
+ * it had to be formatted) value, each -1 if there is none.
+ */
+typedef struct {
+  netsnmp_variable_list *vars;
+  struct tree *tp;
+  int label_off;
+  int iid_off;
+  int value_off;
+  int value_len;
+} decoded_var;
+
+/*
+ * The variables of the last response of an operation decoded without the
+ * GIL, in response order, so that read_variable only has to build the
+ * Python objects; buffers are kept for the following responses.
+ */
+typedef struct {
+  decoded_var *vars;
+  size_t num_vars;
+  size_t size;
+  size_t next; /* where the next lookup starts */
+  char *strings;
+  size_t strings_len;
+  size_t strings_size;
+} decoded_pdu;
+
 typedef struct {
   char *op_name;
   int getlabel_flag;
@@ -122,17 +266,66 @@ typedef struct {
   char type_str[MAX_TYPE_NAME_LEN];
   u_char str_buf[STR_BUF_SIZE];
 
+  int borrowed_oids; /* oid arrays belong to a prepared_varlist */
+  session_capsule_ctx *arena_owner; /* arrays come from arena_owner->arena */
   int error;
+
+  decoded_pdu decoded;
 } snmp_op_data;
 
+/* allocate the per-call arrays of an snmp_op_data */
+#define OP_DATA_NEW(data, type, n)                                             \
+  ((data)->arena_owner                                                         \
+       ? (type *)simple_arena_alloc(&(data)->arena_owner->arena,               \
+                                    sizeof(type) * (n))                        \
+       : PyMem_New(type, (n)))
+
+/*
+ * A varlist whose OIDs were parsed and translated once by prepare(), so
+ * that operations passed it instead of a list of SNMPVariables borrow its
+ * arrays rather than rebuilding them on every call.
+ */
+typedef struct {
+  PyObject_HEAD
+  PyObject *varlist;
+  int varlist_len;
+  oid **oid_arr;
+  int *oid_arr_len;
+  char **oid_str_arr;
+  char **oid_idx_str_arr;
+} prepared_varlist;
+
+static PyTypeObject prepared_varlist_type;
+
+/* operations accept either a list of SNMPVariables or a prepared_varlist */
+#define VARLIST_CHECK(varlist)                                                 \
+  (PyList_Check(varlist) ||                                                    \
+   PyObject_TypeCheck((varlist), &prepared_varlist_type))
+
 static PyObject *create_session_capsule(SnmpSession *ss);
 static void *get_session_context(PyObject *session);
+static void __use_output_format(session_capsule_ctx *ctx);
 static void delete_session_capsule(PyObject *session_capsule);
 static void snmp_op_data_reset(snmp_op_data *data);
+static void snmp_op_data_use_arena(snmp_op_data *data,
+                                   session_capsule_ctx *session_ctx);
 static int snmp_op_data_load(snmp_op_data *data, int best_guess);
 static void snmp_op_data_finish(snmp_op_data *data);
-static int send_pdu_request(session_capsule_ctx *session_ctx, snmp_op_data* data);
-static PyObject *read_variable(netsnmp_variable_list *vars, snmp_op_data* data, int getlabel_flag, int sprintval_flag);
+static int send_pdu_request(session_capsule_ctx *session_ctx, snmp_op_data* data,
+                            bitarray *invalid_oids);
+static int send_packed_requests(session_capsule_ctx *session_ctx,
+                                snmp_op_data *data, int command,
+                                PyObject *result_varlist);
+static PyObject *read_variable(netsnmp_variable_list *vars,
+                               snmp_op_data *data,
+                               session_capsule_ctx *session_ctx);
+static PyObject *read_value(netsnmp_variable_list *vars, snmp_op_data *data,
+                            struct tree *tp, int sprintval_flag,
+                            int native_types, int octet_bytes);
+static struct tree *__read_label(netsnmp_variable_list *vars,
+                                 snmp_op_data *data,
+                                 session_capsule_ctx *session_ctx,
+                                 char **label, char **iid);
 
 static int __is_numeric_oid(char *oidstr);
 static int __is_leaf(struct tree *tp);
@@ -142,19 +335,55 @@ static int __snprint_value(char *buf, size_t buf_len,
                            netsnmp_variable_list *var, struct tree *tp,
                            int type, int flag);
 static int __sprint_num_objid(char *buf, oid *objid, int len);
+static struct tree *__sprint_objid(char *buf, size_t buf_len, oid *name,
+                                   size_t name_len, int format);
 static int __scan_num_objid(char *buf, oid *objid, size_t *len);
 static int __get_type_str(int type, char *str, int log_error);
 static int __get_label_iid(char *name, char **last_label, char **iid, int flag);
 static struct tree *__tag2oid(char *tag, char *iid, oid *oid_arr,
                               int *oid_arr_len, int *type, int best_guess);
+static struct tree *__tag2oid_cached(char *tag, char *iid, oid *oid_arr,
+                                     int *oid_arr_len, int *type,
+                                     int best_guess);
+static void __oid_cache_clear(void);
 static int __concat_oid_str(oid *doid_arr, int *doid_arr_len, char *soid_str);
 static int __add_var_val_str(netsnmp_pdu *pdu, oid *name, int name_length,
                              char *val, int len, int type);
+static size_t __estimate_response_size(netsnmp_pdu *response);
+static long __elapsed_usec(struct timeval *start);
 
-static void py_log_msg(int log_level, char *printf_fmt, ...);
+static void __py_log_msg(int log_level, char *printf_fmt, ...);
+static void __py_log_refresh_level(void);
 
 enum { INFO, WARNING, ERROR, DEBUG, EXCEPTION };
 
+/*
+ * Whether the easysnmp.interface logger has DEBUG enabled, so that
+ * disabled DEBUG messages are dropped before their arguments are even
+ * formatted.  Rather than asking the logger on every operation this is
+ * looked up when the module is imported, whenever a session or trap
+ * socket is created and when refresh_log_level() is called (which
+ * easysnmp.set_log_level does after changing the level).  Building with
+ * EASYSNMP_NO_DEBUG_LOG defined compiles DEBUG messages out altogether.
+ */
+static int py_log_debug_enabled = 1;
+
+#ifdef EASYSNMP_NO_DEBUG_LOG
+#define py_log_msg(log_level, ...)                                             \
+  do {                                                                         \
+    if ((log_level) != DEBUG) {                                                \
+      __py_log_msg((log_level), __VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
+#else
+#define py_log_msg(log_level, ...)                                             \
+  do {                                                                         \
+    if ((log_level) != DEBUG || py_log_debug_enabled) {                        \
+      __py_log_msg((log_level), __VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
+#endif
+
 static PyObject *easysnmp_import = NULL;
 static PyObject *easysnmp_exceptions_import = NULL;
 static PyObject *easysnmp_compat_import = NULL;
@@ -186,8 +415,40 @@ static void *compat_netsnmp_memdup(const void *from, size_t size) {
   return to;
 }
 
+/*
+ * Which MIBs are parsed when the module is imported, as chosen by the
+ * EASYSNMP_MIBS environment variable:
+ *
+ *   (unset)   every MIB Net-SNMP is configured to load, as before
+ *   lazy      none, until the first operation needing them: one of a
+ *             session without use_numeric, or translating a symbolic OID;
+ *             load_mibs() may also be used to load just some modules
+ *   numeric   none at all, not even the MIB directory indexes; only
+ *             numeric OIDs may be used, with use_numeric
+ *   modules   the modules listed (e.g. SNMPv2-MIB:IF-MIB), as for MIBS
+ *
+ * An empty EASYSNMP_MIBS is taken as unset.  Net-SNMP only reads the list
+ * of modules from MIBS, so that is set while init_snmp() runs and then put
+ * back as it was for anything the process starts later; the MIB
+ * directories are given to the library directly.
+ */
+enum { MIBS_LOAD_ALL, MIBS_LOAD_LAZY, MIBS_LOAD_NONE };
+static int mib_load_mode = MIBS_LOAD_ALL;
+static int mibs_loaded = 1;
+
+/*
+ * Held for reading while responses are decoded without the GIL (see
+ * __decode_response), which looks up MIB nodes, and for writing while
+ * MIBs are loaded into the tree; everything else touching the tree holds
+ * the GIL throughout.
+ */
+static pthread_rwlock_t mib_tree_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 void __libraries_init(char *appname) {
   static int have_inited = 0;
+  char *mibs = getenv("EASYSNMP_MIBS");
+  char *saved_mibs = NULL;
+  char *modules = NULL;
 
   if (have_inited) {
     return;
@@ -199,8 +460,40 @@ void __libraries_init(char *appname) {
   /* completely disable logging otherwise it will default to stderr */
   netsnmp_register_loghandler(NETSNMP_LOGHANDLER_NONE, 0);
 
+  if (mibs && !*mibs) {
+    mibs = NULL;
+  }
+
+  if (mibs && !strcmp(mibs, "lazy")) {
+    mib_load_mode = MIBS_LOAD_LAZY;
+    mibs_loaded = 0;
+    modules = "";
+  } else if (mibs && !strcmp(mibs, "numeric")) {
+    mib_load_mode = MIBS_LOAD_NONE;
+    modules = "";
+    netsnmp_set_mib_directory("");
+  } else if (mibs) {
+    modules = mibs;
+  }
+
+  if (modules) {
+    if (getenv("MIBS")) {
+      saved_mibs = strdup(getenv("MIBS"));
+    }
+    setenv("MIBS", modules, 1);
+  }
+
   init_snmp(appname);
 
+  if (modules) {
+    if (saved_mibs) {
+      setenv("MIBS", saved_mibs, 1);
+      free(saved_mibs);
+    } else {
+      unsetenv("MIBS");
+    }
+  }
+
   netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
                          NETSNMP_DS_LIB_DONT_BREAKDOWN_OIDS, 1);
   netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_PRINT_SUFFIX_ONLY,
@@ -209,6 +502,23 @@ void __libraries_init(char *appname) {
                      NETSNMP_OID_OUTPUT_SUFFIX);
 }
 
+/*
+ * Load every MIB the first time one is needed when they are loaded lazily;
+ * the OID caches hold nothing from before then worth keeping.
+ */
+static void __load_mibs_on_demand(void) {
+  if (mibs_loaded) {
+    return;
+  }
+  mibs_loaded = 1;
+
+  py_log_msg(DEBUG, "loading MIBs on first use");
+  pthread_rwlock_wrlock(&mib_tree_lock);
+  read_all_mibs();
+  pthread_rwlock_unlock(&mib_tree_lock);
+  __oid_cache_clear();
+}
+
 static int __is_numeric_oid(char *oidstr) {
   if (!oidstr) {
     return 0;
@@ -380,7 +690,7 @@ static int __snprint_value(char *buf, size_t buf_len,
   } else {
     switch (var->type) {
     case ASN_INTEGER:
-      if (flag == USE_ENUMS) {
+      if (flag == USE_ENUMS && tp) {
         for (ep = tp->enums; ep; ep = ep->next) {
           if (ep->value == *var->val.integer) {
             strlcpy(buf, ep->label, buf_len);
@@ -494,6 +804,83 @@ static int __sprint_num_objid(char *buf, oid *objid, int len) {
   return SUCCESS;
 }
 
+/*
+ * Format an OID for the given NETSNMP_DS_LIB_OID_OUTPUT_FORMAT as Net-SNMP
+ * itself would with DONT_BREAKDOWN_OIDS set, i.e. with every arc below the
+ * deepest MIB node matched printed numerically:
+ *
+ *   NETSNMP_OID_OUTPUT_SUFFIX  - sysContact.0
+ *   NETSNMP_OID_OUTPUT_FULL    - .iso.org.dod.internet.mgmt.mib-2.system.sysContact.0
+ *   NETSNMP_OID_OUTPUT_NUMERIC - .1.3.6.1.2.1.1.4.0
+ *
+ * Unlike netsnmp_sprint_realloc_objid_tree this leaves the library-wide
+ * output format alone, so that sessions formatting OIDs differently may
+ * be used from several threads at once.
+ *
+ * returns : the deepest MIB node matching the OID, or NULL if none does
+ */
+static struct tree *__sprint_objid(char *buf, size_t buf_len, oid *name,
+                                   size_t name_len, int format) {
+  struct tree *tp = NULL;
+  struct tree *subtree = get_tree_head();
+  size_t matched = 0;
+  size_t out_len = 0;
+  size_t i;
+  int len;
+
+  buf[0] = '\0';
+
+  /* match as many arcs as possible against the MIB tree */
+  while (subtree && matched < name_len) {
+    while (subtree && subtree->subid != name[matched]) {
+      subtree = subtree->next_peer;
+    }
+    if (!subtree) {
+      break;
+    }
+    tp = subtree;
+    matched++;
+    subtree = subtree->child_list;
+  }
+
+  if (format == NETSNMP_OID_OUTPUT_NUMERIC || !tp) {
+    matched = 0;
+  } else if (format == NETSNMP_OID_OUTPUT_FULL) {
+    /* labels of every node along the way, found back up from the deepest */
+    for (subtree = tp, i = matched; subtree && i > 0;
+         subtree = subtree->parent, i--) {
+      out_len += strlen(subtree->label) + 1;
+    }
+    if (out_len >= buf_len) {
+      return tp;
+    }
+    buf[out_len] = '\0';
+    for (subtree = tp, i = out_len; subtree && i > 0;
+         subtree = subtree->parent) {
+      len = strlen(subtree->label);
+      i -= len;
+      memcpy(buf + i, subtree->label, len);
+      buf[--i] = '.';
+    }
+  } else {
+    len = snprintf(buf, buf_len, "%s", tp->label);
+    out_len = (len < 0 || (size_t)len >= buf_len) ? buf_len - 1 : len;
+  }
+
+  for (i = matched; i < name_len && out_len < buf_len - 1; i++) {
+    len = snprintf(buf + out_len, buf_len - out_len, ".%lu",
+                   (unsigned long)name[i]);
+    if (len < 0 || (size_t)len >= buf_len - out_len) {
+      /* truncated, as Net-SNMP would */
+      out_len = buf_len - 1;
+      break;
+    }
+    out_len += len;
+  }
+
+  return tp;
+}
+
 static int __scan_num_objid(char *buf, oid *objid, size_t *len) {
   char *cp;
   *len = 0;
@@ -726,6 +1113,10 @@ static struct tree *__tag2oid(char *tag, char *iid, oid *oid_arr,
     goto done;
   }
 
+  if (!__is_numeric_oid(tag)) {
+    __load_mibs_on_demand();
+  }
+
   /*********************************************************/
   /* best_guess = 0 - same as no switches (read_objid)     */
   /*                  if multiple parts, or uses find_node */
@@ -831,6 +1222,204 @@ done:
   return rtp;
 }
 
+/*
+ * Process-wide OID translation caches, shared by every session: tags (with
+ * their iid) to OID arrays for building requests, and response OIDs to
+ * labels for read_variable.  They are guarded by oid_cache_lock rather
+ * than the GIL, and hold pointers into the MIB tree, so they must be
+ * cleared with __oid_cache_clear whenever MIBs are (re)loaded.
+ */
+static PyThread_type_lock oid_cache_lock = NULL;
+static simple_cache tag_oid_cache;
+static simple_cache label_oid_cache;
+
+/* cached values are this header followed by the OID array or the labels */
+typedef struct tag_oid_cache_value {
+  struct tree *tp;
+  int type;
+  int oid_arr_len;
+} tag_oid_cache_value;
+
+typedef struct label_oid_cache_value {
+  struct tree *tp;
+  size_t label_len;
+  size_t iid_len;
+} label_oid_cache_value;
+
+static int __oid_cache_init(void) {
+  if (!(oid_cache_lock = PyThread_allocate_lock())) {
+    return -1;
+  }
+
+  if (simple_cache_init(&tag_oid_cache, OID_CACHE_SIZE) < 0 ||
+      simple_cache_init(&label_oid_cache, OID_CACHE_SIZE) < 0) {
+    simple_cache_free(&tag_oid_cache);
+    simple_cache_free(&label_oid_cache);
+    PyThread_free_lock(oid_cache_lock);
+    oid_cache_lock = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void __oid_cache_clear(void) {
+  if (!oid_cache_lock) {
+    return;
+  }
+
+  PyThread_acquire_lock(oid_cache_lock, WAIT_LOCK);
+  simple_cache_clear(&tag_oid_cache);
+  simple_cache_clear(&label_oid_cache);
+  PyThread_release_lock(oid_cache_lock);
+}
+
+/*
+ * Same as __tag2oid, remembering successful translations so the MIB tree
+ * is only searched the first time a tag and iid are seen.
+ */
+static struct tree *__tag2oid_cached(char *tag, char *iid, oid *oid_arr,
+                                     int *oid_arr_len, int *type,
+                                     int best_guess) {
+  char key[OID_CACHE_MAX_KEY];
+  unsigned char value[sizeof(tag_oid_cache_value) + MAX_OID_LEN * sizeof(oid)];
+  unsigned char *cached = NULL;
+  tag_oid_cache_value entry;
+  size_t tag_len = STRLEN(tag);
+  size_t iid_len = STRLEN(iid);
+  size_t key_len = 1 + tag_len + 1 + iid_len;
+  struct tree *tp = NULL;
+
+  if (!tag || !oid_arr || !oid_arr_len || !oid_cache_lock ||
+      key_len > sizeof(key)) {
+    return __tag2oid(tag, iid, oid_arr, oid_arr_len, type, best_guess);
+  }
+
+  /* key is <best_guess><tag>\0<iid> */
+  key[0] = (char)best_guess;
+  memcpy(key + 1, tag, tag_len + 1);
+  if (iid_len) {
+    memcpy(key + 1 + tag_len + 1, iid, iid_len);
+  }
+
+  PyThread_acquire_lock(oid_cache_lock, WAIT_LOCK);
+  cached = simple_cache_get(&tag_oid_cache, key, key_len, NULL);
+  if (cached) {
+    memcpy(&entry, cached, sizeof(entry));
+    memcpy(oid_arr, cached + sizeof(entry), entry.oid_arr_len * sizeof(oid));
+  }
+  PyThread_release_lock(oid_cache_lock);
+
+  if (cached) {
+    *oid_arr_len = entry.oid_arr_len;
+    if (type) {
+      *type = entry.type;
+    }
+    return entry.tp;
+  }
+
+  tp = __tag2oid(tag, iid, oid_arr, oid_arr_len, &entry.type, best_guess);
+  if (type) {
+    *type = entry.type;
+  }
+
+  if (*oid_arr_len > 0 && *oid_arr_len <= MAX_OID_LEN) {
+    entry.tp = tp;
+    entry.oid_arr_len = *oid_arr_len;
+    memcpy(value, &entry, sizeof(entry));
+    memcpy(value + sizeof(entry), oid_arr, entry.oid_arr_len * sizeof(oid));
+
+    PyThread_acquire_lock(oid_cache_lock, WAIT_LOCK);
+    simple_cache_put(&tag_oid_cache, key, key_len, value,
+                     sizeof(entry) + entry.oid_arr_len * sizeof(oid));
+    PyThread_release_lock(oid_cache_lock);
+  }
+
+  return tp;
+}
+
+/*
+ * Build the key for the label of a response OID: the label also depends
+ * on the OID output format and getlabel_flag it was formatted with.
+ *
+ * returns : the key length, or 0 if the OID is too long to be cached
+ */
+static size_t __label_cache_key(unsigned char *key, oid *name,
+                                size_t name_len, int oid_output_format,
+                                int getlabel_flag) {
+  int format[2];
+
+  if (name_len > MAX_OID_LEN) {
+    return 0;
+  }
+
+  format[0] = oid_output_format;
+  format[1] = getlabel_flag;
+  memcpy(key, format, sizeof(format));
+  memcpy(key + sizeof(format), name, name_len * sizeof(oid));
+
+  return sizeof(format) + name_len * sizeof(oid);
+}
+
+/*
+ * Look up the label and iid of a response OID, copying them into buf
+ * (which must be STR_BUF_SIZE bytes) as two consecutive strings.
+ *
+ * returns : the MIB node of the OID on a hit, NULL on a miss
+ */
+static struct tree *__label_cache_get(unsigned char *key, size_t key_len,
+                                      u_char *buf, char **label,
+                                      char **iid) {
+  unsigned char *cached = NULL;
+  label_oid_cache_value entry;
+
+  if (!key_len || !oid_cache_lock) {
+    return NULL;
+  }
+
+  PyThread_acquire_lock(oid_cache_lock, WAIT_LOCK);
+  cached = simple_cache_get(&label_oid_cache, key, key_len, NULL);
+  if (cached) {
+    memcpy(&entry, cached, sizeof(entry));
+    memcpy(buf, cached + sizeof(entry), entry.label_len + entry.iid_len + 2);
+  }
+  PyThread_release_lock(oid_cache_lock);
+
+  if (!cached) {
+    return NULL;
+  }
+
+  *label = (char *)buf;
+  *iid = (char *)buf + entry.label_len + 1;
+  return entry.tp;
+}
+
+static void __label_cache_put(unsigned char *key, size_t key_len,
+                              struct tree *tp, char *label, char *iid) {
+  unsigned char value[sizeof(label_oid_cache_value) + STR_BUF_SIZE];
+  label_oid_cache_value entry;
+
+  if (!key_len || !oid_cache_lock || !tp || !label || !iid) {
+    return;
+  }
+
+  entry.tp = tp;
+  entry.label_len = strlen(label);
+  entry.iid_len = strlen(iid);
+  if (entry.label_len + entry.iid_len + 2 > STR_BUF_SIZE) {
+    return;
+  }
+
+  memcpy(value, &entry, sizeof(entry));
+  memcpy(value + sizeof(entry), label, entry.label_len + 1);
+  memcpy(value + sizeof(entry) + entry.label_len + 1, iid, entry.iid_len + 1);
+
+  PyThread_acquire_lock(oid_cache_lock, WAIT_LOCK);
+  simple_cache_put(&label_oid_cache, key, key_len, value,
+                   sizeof(entry) + entry.label_len + entry.iid_len + 2);
+  PyThread_release_lock(oid_cache_lock);
+}
+
 /* function: __concat_oid_str
  *
  * This function converts a dotted-decimal string, soid_str, to an array
@@ -992,16 +1581,62 @@ static int __add_var_val_str(netsnmp_pdu *pdu, oid *name, int name_length,
   return ret;
 }
 
+/* count a response to a request sent on handle rtt microseconds ago */
+static void __stats_response(session_stats *stats, void *handle,
+                             netsnmp_pdu *response, long rtt) {
+  netsnmp_session *ss = snmp_sess_session(handle);
+  size_t bucket;
+  long retries;
+
+  if (!stats) {
+    return;
+  }
+
+  stats->responses++;
+  stats->rtt_total += rtt / 1e6;
+  for (bucket = 0; bucket < SESSION_RTT_BUCKETS - 1; bucket++) {
+    if (rtt < session_rtt_bounds[bucket] * 1000L) {
+      break;
+    }
+  }
+  stats->rtt_histogram[bucket]++;
+
+  if (ss && ss->timeout > 0) {
+    retries = rtt / ss->timeout;
+    stats->retries += retries < ss->retries ? retries : ss->retries;
+  }
+
+  if (response) {
+    stats->bytes_received += __estimate_response_size(response);
+  }
+}
+
+/* count a request sent on handle which was never answered */
+static void __stats_timeout(session_stats *stats, void *handle) {
+  netsnmp_session *ss = snmp_sess_session(handle);
+
+  if (!stats) {
+    return;
+  }
+
+  stats->timeouts++;
+  if (ss && ss->retries > 0) {
+    stats->retries += ss->retries;
+  }
+}
+
 /* takes ss and pdu as input and updates the 'response' argument */
 /* the input 'pdu' argument will be freed */
+/* (what was sent and received is counted in stats unless it is NULL) */
 static int __send_sync_pdu(netsnmp_session *ss, netsnmp_pdu *pdu,
                            netsnmp_pdu **response, int retry_nosuch,
                            char *err_str, int *err_num, int *err_ind,
-                           bitarray *invalid_oids) {
+                           bitarray *invalid_oids, session_stats *stats) {
   int status = 0;
   long command = pdu->command;
   char *tmp_err_str;
   size_t retry_num = 0;
+  struct timeval start;
 
   /* Note: SNMP uses 1-based indexing with OIDs, so 0 is unused */
   unsigned long last_errindex = 0;
@@ -1022,10 +1657,19 @@ static int __send_sync_pdu(netsnmp_session *ss, netsnmp_pdu *pdu,
 
 retry:
 
+  if (stats) {
+    stats->pdus_sent++;
+  }
+  netsnmp_get_monotonic_clock(&start);
+
   Py_BEGIN_ALLOW_THREADS
   status = snmp_sess_synch_response(ss, pdu, response);
   Py_END_ALLOW_THREADS
 
+  if (*response) {
+    __stats_response(stats, ss, *response, __elapsed_usec(&start));
+  }
+
       if ((*response == NULL) && (status == STAT_SUCCESS)) {
     status = STAT_ERROR;
   }
@@ -1100,6 +1744,9 @@ retry:
         }
 
         retry_num++;
+        if (stats) {
+          stats->nosuch_retries++;
+        }
         goto retry;
       } else /* !retry_nosuch */
       {
@@ -1142,6 +1789,7 @@ retry:
     break;
 
   case STAT_TIMEOUT:
+    __stats_timeout(stats, ss);
     snmp_sess_error(ss, err_num, err_ind, &tmp_err_str);
     strlcpy(err_str, tmp_err_str, STR_BUF_SIZE);
     py_log_msg(ERROR, "sync PDU: %s", err_str);
@@ -1175,10 +1823,6 @@ done:
   return status;
 }
 
-static PyObject *py_netsnmp_construct_varbind(void) {
-  return PyObject_CallMethod(easysnmp_import, "SNMPVariable", NULL);
-}
-
 static int py_netsnmp_attr_string(PyObject *obj, char *attr_name, char **val,
                                   Py_ssize_t *len) {
   *val = NULL;
@@ -1251,35 +1895,196 @@ static int py_netsnmp_attr_set_string(PyObject *obj, char *attr_name, char *val,
   return ret;
 }
 
-/**
- * Update python session object error attributes.
- *
- * Copy the error info which may have been returned from __send_sync_pdu(...)
- * into the python object. This will allow the python code to determine if
- * an error occured during an snmp operation.
- *
- * Currently there are 3 attributes we care about
- *
- * error_number - Copy of the value of netsnmp_session.s_errno. This is the
- * system errno that was generated during our last call into the net-snmp
- * library.
- *
- * error_index - Copy of the value of netsmp_session.s_snmp_errno. These error
- * numbers are separate from the system errno's and describe SNMP errors.
- *
- * error_string - A string describing the error_index that was returned during
- * our last operation.
+/*
+ * Native base type for easysnmp.variables.SNMPVariable.
  *
- * @param[in] session The python object that represents our current Session
- * @param[in|out] err_str A string describing err_ind
- * @param[in|out] err_num The system errno currently stored by our session
- * @param[in|out] err_ind The snmp errno currently stored by our session
+ * Results are allocated directly as instances of SNMPVariable (which
+ * derives from this type) and their fields stored into the object,
+ * rather than calling the class and setting each attribute through
+ * SNMPVariable.__setattr__().
  */
-static void __py_netsnmp_update_session_errors(PyObject *session, char *err_str,
-                                               int err_num, int err_ind) {
-  PyObject *tmp_for_conversion;
+typedef struct {
+  PyObject_HEAD
+  PyObject *fields[VARBIND_NUM_F];
+} varbind_object;
 
-  py_netsnmp_attr_set_string(session, "error_string", err_str, STRLEN(err_str));
+static char *varbind_field_names[VARBIND_NUM_F] = {"oid", "oid_index",
+                                                   "value", "snmp_type",
+                                                   "root_oid"};
+
+/* the SNMPVariable class, looked up the first time a result is built */
+static PyTypeObject *varbind_type = NULL;
+
+static int varbind_traverse(varbind_object *self, visitproc visit, void *arg) {
+  int i;
+
+  for (i = 0; i < VARBIND_NUM_F; i++) {
+    Py_VISIT(self->fields[i]);
+  }
+  return 0;
+}
+
+static int varbind_clear(varbind_object *self) {
+  int i;
+
+  for (i = 0; i < VARBIND_NUM_F; i++) {
+    Py_CLEAR(self->fields[i]);
+  }
+  return 0;
+}
+
+static void varbind_dealloc(varbind_object *self) {
+  PyObject_GC_UnTrack(self);
+  varbind_clear(self);
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyMemberDef varbind_members[] = {
+    {"oid", T_OBJECT, offsetof(varbind_object, fields[VARBIND_TAG_F]), 0,
+     "the OID being manipulated"},
+    {"oid_index", T_OBJECT, offsetof(varbind_object, fields[VARBIND_IID_F]),
+     0, "the index of the OID"},
+    {"value", T_OBJECT, offsetof(varbind_object, fields[VARBIND_VAL_F]), 0,
+     "the OID value"},
+    {"snmp_type", T_OBJECT, offsetof(varbind_object, fields[VARBIND_TYPE_F]),
+     0, "the SNMP type of the value"},
+    {"root_oid", T_OBJECT, offsetof(varbind_object, fields[VARBIND_ROOT_F]),
+     0, "the OID requested which this variable was returned for"},
+    {NULL} /* Sentinel */
+};
+
+static PyTypeObject varbind_base_type = {
+    PyVarObject_HEAD_INIT(NULL, 0) "easysnmp.interface.SNMPVariableBase",
+    sizeof(varbind_object),                   /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)varbind_dealloc,              /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    "native storage for the fields of an SNMPVariable", /* tp_doc */
+    (traverseproc)varbind_traverse,           /* tp_traverse */
+    (inquiry)varbind_clear,                   /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    0,                                        /* tp_methods */
+    varbind_members,                          /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    PyType_GenericNew,                        /* tp_new */
+};
+
+static PyObject *py_netsnmp_construct_varbind(void) {
+  if (!varbind_type) {
+    PyObject *cls = PyObject_GetAttrString(easysnmp_import, "SNMPVariable");
+
+    if (!cls) {
+      return NULL;
+    }
+
+    if (!PyType_Check(cls) ||
+        !PyType_IsSubtype((PyTypeObject *)cls, &varbind_base_type)) {
+      /* a replacement class, which needs constructing the slow way */
+      PyObject *varbind = PyObject_CallObject(cls, NULL);
+      Py_DECREF(cls);
+      return varbind;
+    }
+
+    varbind_type = (PyTypeObject *)cls;
+  }
+
+  /* skip SNMPVariable.__init__(), every field starts out as None */
+  return varbind_type->tp_alloc(varbind_type, 0);
+}
+
+/*
+ * Set one of the VARBIND_*_F fields of a varbind to val_obj, stealing the
+ * reference; fields of a native varbind are stored without __setattr__.
+ */
+static int py_netsnmp_varbind_set_object(PyObject *varbind, int field,
+                                         PyObject *val_obj) {
+  PyObject *old_obj = NULL;
+  int ret;
+
+  if (!varbind || !val_obj) {
+    Py_XDECREF(val_obj);
+    return -1;
+  }
+
+  if (!PyObject_TypeCheck(varbind, &varbind_base_type)) {
+    ret = PyObject_SetAttrString(varbind, varbind_field_names[field], val_obj);
+    Py_DECREF(val_obj);
+    return ret;
+  }
+
+  old_obj = ((varbind_object *)varbind)->fields[field];
+  ((varbind_object *)varbind)->fields[field] = val_obj;
+  Py_XDECREF(old_obj);
+  return 0;
+}
+
+/*
+ * Set one of the VARBIND_*_F fields of a varbind to the latin-1 decoding
+ * of val, as py_netsnmp_attr_set_string() would set the attribute.
+ */
+static int py_netsnmp_varbind_set_string(PyObject *varbind, int field,
+                                         char *val, size_t len) {
+  if (!varbind) {
+    return -1;
+  }
+
+  return py_netsnmp_varbind_set_object(
+      varbind, field, PyUnicode_Decode(val, len, "latin-1", "surrogateescape"));
+}
+
+/**
+ * Update python session object error attributes.
+ *
+ * Copy the error info which may have been returned from __send_sync_pdu(...)
+ * into the python object. This will allow the python code to determine if
+ * an error occured during an snmp operation.
+ *
+ * Currently there are 3 attributes we care about
+ *
+ * error_number - Copy of the value of netsnmp_session.s_errno. This is the
+ * system errno that was generated during our last call into the net-snmp
+ * library.
+ *
+ * error_index - Copy of the value of netsmp_session.s_snmp_errno. These error
+ * numbers are separate from the system errno's and describe SNMP errors.
+ *
+ * error_string - A string describing the error_index that was returned during
+ * our last operation.
+ *
+ * @param[in] session The python object that represents our current Session
+ * @param[in|out] err_str A string describing err_ind
+ * @param[in|out] err_num The system errno currently stored by our session
+ * @param[in|out] err_ind The snmp errno currently stored by our session
+ */
+static void __py_netsnmp_update_session_errors(PyObject *session, char *err_str,
+                                               int err_num, int err_ind) {
+  PyObject *tmp_for_conversion;
+
+  py_netsnmp_attr_set_string(session, "error_string", err_str, STRLEN(err_str));
 
   tmp_for_conversion = PyLong_FromLong(err_num);
   if (!tmp_for_conversion) {
@@ -1301,6 +2106,9 @@ static PyObject *create_session_capsule(SnmpSession *session) {
   session_capsule_ctx *ctx = NULL;
   PyObject *capsule = NULL;
 
+  /* a new session is a good time to pick up any change to the log level */
+  __py_log_refresh_level();
+
   /* create a long lived handle from throwaway session object */
   if (!(handle = snmp_sess_open(session))) {
     PyErr_SetString(EasySNMPConnectionError, "couldn't create SNMP handle");
@@ -1329,9 +2137,19 @@ static PyObject *create_session_capsule(SnmpSession *session) {
   ctx->snmp_version = 0;
   ctx->getlabel_flag = NO_FLAGS;
   ctx->sprintval_flag = USE_BASIC;
-  ctx->old_format = 0;
   ctx->best_guess = 0;
   ctx->retry_nosuch = 0;
+  ctx->max_varbinds = 1;
+  ctx->bulk_repetitions = 0;
+  ctx->native_types = 0;
+  ctx->octet_bytes = 0;
+  ctx->options_loaded = 0;
+  ctx->oid_output_format = 0;
+  simple_arena_init(&ctx->arena);
+  ctx->arena_in_use = 0;
+  memset(&ctx->stats, 0, sizeof(ctx->stats));
+  memset(&ctx->nosuch_cache, 0, sizeof(ctx->nosuch_cache));
+  ctx->missing_ttl = 0;
   return (capsule);
 
 except:
@@ -1351,95 +2169,167 @@ except:
   return NULL;
 }
 
-static void *get_session_context(PyObject *session) {
+/*
+ * Load the options deciding how response variables are decoded by
+ * read_variable, which a TrapListener takes as a session does.
+ *
+ * returns : 0 on success or -1 with an exception set when an option could
+ *           not be read as an integer
+ */
+static int __load_decode_options(session_capsule_ctx *ctx, PyObject *obj) {
+  ctx->getlabel_flag = NO_FLAGS;
+  ctx->sprintval_flag = USE_BASIC;
+  ctx->oid_output_format = NETSNMP_OID_OUTPUT_SUFFIX;
 
+  if (py_netsnmp_attr_long(obj, "use_long_names")) {
+    ctx->getlabel_flag |= USE_LONG_NAMES;
+    ctx->oid_output_format = NETSNMP_OID_OUTPUT_FULL;
+  } else if (py_netsnmp_attr_long(obj, "use_numeric")) {
+    /*
+     * Setting use_numeric forces use_long_names on so check for
+     * use_numeric after use_long_names (above) to make sure the final
+     * outcome of NETSNMP_DS_LIB_OID_OUTPUT_FORMAT is
+     * NETSNMP_OID_OUTPUT_NUMERIC
+     */
+    ctx->getlabel_flag |= USE_LONG_NAMES;
+    ctx->getlabel_flag |= USE_NUMERIC_OIDS;
+    ctx->oid_output_format = NETSNMP_OID_OUTPUT_NUMERIC;
+  }
+
+  if (py_netsnmp_attr_long(obj, "use_enums")) {
+    ctx->sprintval_flag = USE_ENUMS;
+  }
+
+  if (py_netsnmp_attr_long(obj, "use_sprint_value")) {
+    ctx->sprintval_flag = USE_SPRINT_VALUE;
+  }
+
+  ctx->native_types = py_netsnmp_attr_long(obj, "use_native_types") > 0;
+  ctx->octet_bytes = py_netsnmp_attr_long(obj, "use_bytes") > 0;
+
+  return PyErr_Occurred() ? -1 : 0;
+}
+
+/*
+ * (Re)load the options of a session into its context; this happens the
+ * first time the session is used and whenever one of its options is
+ * assigned to afterwards (see Session.__setattr__ and update_session), so
+ * that each operation does not need to read them back from the object.
+ *
+ * returns : 0 on success or -1 with an exception set
+ */
+static int __load_session_options(session_capsule_ctx *ctx,
+                                  PyObject *session) {
   char *tmpstr = NULL;
   Py_ssize_t tmplen;
+
+  py_log_msg(DEBUG, "Loading session options");
+
+  __load_decode_options(ctx, session);
+  ctx->snmp_version = py_netsnmp_attr_long(session, "version");
+
+  if (py_netsnmp_attr_string(session, "error_string", &tmpstr, &tmplen) < 0) {
+    return -1;
+  }
+  if (tmplen >= (Py_ssize_t)sizeof(ctx->err_str)) {
+    tmplen = sizeof(ctx->err_str) - 1;
+  }
+  memcpy(&ctx->err_str, tmpstr, tmplen);
+  ctx->err_str[tmplen] = '\0';
+  ctx->err_num = py_netsnmp_attr_long(session, "error_number");
+  ctx->err_ind = py_netsnmp_attr_long(session, "error_index");
+
+  ctx->best_guess = py_netsnmp_attr_long(session, "best_guess");
+  ctx->retry_nosuch = py_netsnmp_attr_long(session, "retry_no_such");
+  ctx->max_varbinds = py_netsnmp_attr_long(session, "max_varbinds_per_pdu");
+  if (ctx->max_varbinds < 0) {
+    ctx->max_varbinds = 0;
+  }
+  ctx->missing_ttl = py_netsnmp_attr_long(session, "missing_oid_ttl");
+  if (ctx->missing_ttl < 0) {
+    ctx->missing_ttl = 0;
+  }
+
+  /* a different version or retry_nosuch may see a different agent */
+  simple_cache_clear(&ctx->nosuch_cache);
+
+  /* options of the wrong type simply read as -1, as they always have */
+  PyErr_Clear();
+  ctx->options_loaded = 1;
+
+  return 0;
+}
+
+static session_capsule_ctx *__session_capsule_ctx(PyObject *session) {
+  static PyObject *sess_ptr_name = NULL;
   session_capsule_ctx *ctx = NULL;
+  PyObject *session_capsule = NULL;
+
+  if (!sess_ptr_name &&
+      !(sess_ptr_name = PyUnicode_InternFromString("sess_ptr"))) {
+    return NULL;
+  }
+
   py_log_msg(DEBUG, "Getting session ptr");
-  PyObject *session_capsule = PyObject_GetAttrString(session, "sess_ptr");
+  session_capsule = PyObject_GetAttr(session, sess_ptr_name);
 
   if (!session_capsule) {
     PyErr_SetString(PyExc_RuntimeError,
                     "NULL arg calling get_session_context_from_capsule");
-
-    goto done;
+    return NULL;
   }
 
   py_log_msg(DEBUG, "getting session capsule");
   ctx = PyCapsule_GetPointer(session_capsule, NULL);
+  Py_DECREF(session_capsule);
 
-  if (ctx) {
-    py_log_msg(DEBUG, "Got session capsule");
-    ctx->getlabel_flag = NO_FLAGS;
-    ctx->sprintval_flag = USE_BASIC;
-    ctx->snmp_version = py_netsnmp_attr_long(session, "version");
-
-    if (py_netsnmp_attr_string(session, "error_string", &tmpstr, &tmplen) <
-        0) {
-      goto done;
-    }
-    memcpy(&ctx->err_str, tmpstr, tmplen);
-    ctx->err_num = py_netsnmp_attr_long(session, "error_number");
-    ctx->err_ind = py_netsnmp_attr_long(session, "error_index");
-
-    ctx->old_format = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
-                                    NETSNMP_DS_LIB_OID_OUTPUT_FORMAT);
+  return ctx;
+}
 
-    if (py_netsnmp_attr_long(session, "use_long_names")) {
-      /*
-      ** Set up for numeric or full OID's, if necessary.  Save the old
-      ** output format so that it can be restored when we finish -- this
-      ** is a library-wide global, and has to be set/restored for each
-      ** session.
-      */
-      ctx->getlabel_flag |= USE_LONG_NAMES;
+static void *get_session_context(PyObject *session) {
+  session_capsule_ctx *ctx = NULL;
 
-      netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
-                         NETSNMP_DS_LIB_OID_OUTPUT_FORMAT,
-                         NETSNMP_OID_OUTPUT_FULL);
-    } else if (py_netsnmp_attr_long(session, "use_numeric")) {
-      /*
-       * Setting use_numeric forces use_long_names on so check for
-       * use_numeric after use_long_names (above) to make sure the final
-       * outcome of NETSNMP_DS_LIB_OID_OUTPUT_FORMAT is
-       * NETSNMP_OID_OUTPUT_NUMERIC
-       */
-      ctx->getlabel_flag |= USE_LONG_NAMES;
-      ctx->getlabel_flag |= USE_NUMERIC_OIDS;
+  ctx = __session_capsule_ctx(session);
 
-      netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
-                         NETSNMP_DS_LIB_OID_OUTPUT_FORMAT,
-                         NETSNMP_OID_OUTPUT_NUMERIC);
-    }
+  if (ctx) {
+    py_log_msg(DEBUG, "Got session capsule");
 
-    if (py_netsnmp_attr_long(session, "use_enums")) {
-      ctx->sprintval_flag = USE_ENUMS;
+    if (!ctx->options_loaded && __load_session_options(ctx, session) < 0) {
+      return NULL;
     }
 
-    if (py_netsnmp_attr_long(session, "use_sprint_value")) {
-      ctx->sprintval_flag = USE_SPRINT_VALUE;
+    /* OIDs are only printed without the MIBs with use_numeric */
+    if (ctx->oid_output_format != NETSNMP_OID_OUTPUT_NUMERIC) {
+      __load_mibs_on_demand();
     }
-
-    ctx->best_guess = py_netsnmp_attr_long(session, "best_guess");
-    ctx->retry_nosuch = py_netsnmp_attr_long(session, "retry_no_such");
   }
 
-done:
-  Py_DECREF(session_capsule);
   return ctx;
 }
 
+/*
+ * Set up Net-SNMP for suffix, numeric or full OIDs as the session asks
+ * for.  OIDs are formatted by __sprint_objid, so this is only needed when
+ * Net-SNMP prints values itself (use_sprint_value); as the output format
+ * is a library-wide global it is set right before each such value is
+ * printed, while the GIL is held, not once per operation.
+ */
+static void __use_output_format(session_capsule_ctx *ctx) {
+  if (ctx->oid_output_format) {
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_OID_OUTPUT_FORMAT,
+                       ctx->oid_output_format);
+  }
+}
+
 static void delete_session_capsule(PyObject *session_capsule) {
   session_capsule_ctx *ctx = NULL;
 
-  // Reset output format
   ctx = PyCapsule_GetPointer(session_capsule, NULL);
-  netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_OID_OUTPUT_FORMAT,
-                     ctx->old_format);
 
   if (ctx) {
     snmp_sess_close(ctx->handle);
+    simple_arena_free(&ctx->arena);
+    simple_cache_free(&ctx->nosuch_cache);
     free(ctx);
   }
 }
@@ -1459,14 +2349,30 @@ static void snmp_op_data_reset(snmp_op_data *data) {
   data->varlist_len = 0;
   data->len = 0;
   data->type = 0;
+  data->borrowed_oids = 0;
+  data->arena_owner = NULL;
   data->error = 0;
+  memset(&data->decoded, 0, sizeof(data->decoded));
+}
+
+/*
+ * Have snmp_op_data_load take its arrays from the arena of the session
+ * rather than the heap, unless another operation of the session is using
+ * it; the arena is released again by snmp_op_data_finish.
+ */
+static void snmp_op_data_use_arena(snmp_op_data *data,
+                                   session_capsule_ctx *session_ctx) {
+  if (session_ctx && !session_ctx->arena_in_use) {
+    session_ctx->arena_in_use = 1;
+    data->arena_owner = session_ctx;
+  }
 }
 
 static int snmp_op_data_load(snmp_op_data *data, int best_guess) {
   int error = 0;
-  int varlist_len = data->varlist_len = PySequence_Length(data->varlist);
+  int varlist_len = 0;
   int varlist_ind = 0;
-  PyObject *varlist_iter = PyObject_GetIter(data->varlist);
+  PyObject *varlist_iter = NULL;
   PyObject *varbind = NULL;
 
   data->pdu = NULL;
@@ -1475,14 +2381,31 @@ static int snmp_op_data_load(snmp_op_data *data, int best_guess) {
   data->len = 0;
   data->type = 0;
 
-  data->initial_oid_str_arr = PyMem_New(char *, varlist_len);
-  data->oid_str_arr = PyMem_New(char *, varlist_len);
-  data->oid_idx_str_arr = PyMem_New(char *, varlist_len);
-  data->oid_arr = PyMem_New(oid *, varlist_len);
-  data->oid_arr_len = PyMem_New(int, varlist_len);
+  if (PyObject_TypeCheck(data->varlist, &prepared_varlist_type)) {
+    prepared_varlist *prepared = (prepared_varlist *)data->varlist;
+
+    py_log_msg(DEBUG, "%s: Using prepared varlist", data->op_name);
+    data->varlist_len = prepared->varlist_len;
+    data->oid_arr = prepared->oid_arr;
+    data->oid_arr_len = prepared->oid_arr_len;
+    data->initial_oid_str_arr = prepared->oid_str_arr;
+    data->oid_str_arr = prepared->oid_str_arr;
+    data->oid_idx_str_arr = prepared->oid_idx_str_arr;
+    data->borrowed_oids = 1;
+    return 0;
+  }
+
+  varlist_len = data->varlist_len = PySequence_Length(data->varlist);
+  varlist_iter = PyObject_GetIter(data->varlist);
+
+  data->initial_oid_str_arr = OP_DATA_NEW(data, char *, varlist_len);
+  data->oid_str_arr = OP_DATA_NEW(data, char *, varlist_len);
+  data->oid_idx_str_arr = OP_DATA_NEW(data, char *, varlist_len);
+  data->oid_arr = OP_DATA_NEW(data, oid *, varlist_len);
+  data->oid_arr_len = OP_DATA_NEW(data, int, varlist_len);
 
   for (varlist_ind = 0; varlist_ind < varlist_len; varlist_ind++) {
-    data->oid_arr[varlist_ind] = PyMem_New(oid, MAX_OID_LEN);
+    data->oid_arr[varlist_ind] = OP_DATA_NEW(data, oid, MAX_OID_LEN);
     data->oid_arr_len[varlist_ind] = MAX_OID_LEN;
   }
 
@@ -1500,9 +2423,10 @@ static int snmp_op_data_load(snmp_op_data *data, int best_guess) {
                  data->op_name,
                  data->oid_str_arr[varlist_ind], data->oid_idx_str_arr[varlist_ind]);
 
-      __tag2oid(data->oid_str_arr[varlist_ind], data->oid_idx_str_arr[varlist_ind],
-                data->oid_arr[varlist_ind], &data->oid_arr_len[varlist_ind],
-                NULL, best_guess);
+      __tag2oid_cached(data->oid_str_arr[varlist_ind],
+                       data->oid_idx_str_arr[varlist_ind],
+                       data->oid_arr[varlist_ind],
+                       &data->oid_arr_len[varlist_ind], NULL, best_guess);
     } else {
       data->oid_arr_len[varlist_ind] = 0;
     }
@@ -1529,6 +2453,9 @@ done:
 }
 
 static void snmp_op_data_finish(snmp_op_data *data) {
+  int varlist_len = data->varlist_len;
+  int varlist_ind = 0;
+
   if (data->pdu) {
     snmp_free_pdu(data->pdu);
   }
@@ -1537,1546 +2464,6794 @@ static void snmp_op_data_finish(snmp_op_data *data) {
     snmp_free_pdu(data->response);
   }
 
-  SAFE_FREE(data->oid_arr_len);
-  int varlist_len = data->varlist_len;
-  int varlist_ind = 0;
-  while (varlist_ind < varlist_len) {
-    SAFE_FREE(data->oid_arr[varlist_ind]);
-    varlist_ind++;
+  free(data->decoded.vars);
+  free(data->decoded.strings);
+
+  if (data->arena_owner) {
+    /* every array came out of the session arena */
+    simple_arena_reset(&data->arena_owner->arena);
+    data->arena_owner->arena_in_use = 0;
+  } else if (!data->borrowed_oids) {
+    if (data->oid_arr) {
+      for (varlist_ind = 0; varlist_ind < varlist_len; varlist_ind++) {
+        PyMem_Free(data->oid_arr[varlist_ind]);
+      }
+    }
+    PyMem_Free(data->oid_arr);
+    PyMem_Free(data->oid_arr_len);
+    PyMem_Free(data->oid_str_arr);
+    PyMem_Free(data->oid_idx_str_arr);
+    PyMem_Free(data->initial_oid_str_arr);
   }
-  SAFE_FREE(data->oid_arr);
-  SAFE_FREE(data->oid_str_arr);
-  SAFE_FREE(data->oid_idx_str_arr);
-  SAFE_FREE(data->initial_oid_str_arr);
 
   snmp_op_data_reset(data);
 }
 
-static int send_pdu_request(session_capsule_ctx *session_ctx, snmp_op_data* data) {
-  int status = __send_sync_pdu(session_ctx->handle, data->pdu, &data->response, session_ctx->retry_nosuch, session_ctx->err_str,
-                           &session_ctx->err_num, &session_ctx->err_ind, NULL);
+/*
+ * Responses with fewer variables than this are decoded with the GIL held,
+ * as releasing it would cost more than it saves.
+ */
+#define DECODE_NOGIL_MIN_VARS (8)
+
+/*
+ * Append len bytes of str and a NUL to decoded->strings.
+ *
+ * returns : the offset of the copy, -1 if str is NULL, or -2 when out of
+ *           memory
+ */
+static int __decoded_add_string(decoded_pdu *decoded, const char *str,
+                                size_t len) {
+  size_t size = decoded->strings_size ? decoded->strings_size : 1024;
+  size_t off = decoded->strings_len;
+  char *strings = NULL;
 
-  data->pdu = NULL;
+  if (!str) {
+    return -1;
+  }
 
-  return status;
-}
+  if (off + len + 1 > decoded->strings_size) {
+    while (size < off + len + 1) {
+      size *= 2;
+    }
+    if (!(strings = realloc(decoded->strings, size))) {
+      return -2;
+    }
+    decoded->strings = strings;
+    decoded->strings_size = size;
+  }
 
-static PyObject *read_variable(netsnmp_variable_list *vars, snmp_op_data* data, int getlabel_flag, int sprintval_flag) {
-  PyObject *varbind = py_netsnmp_construct_varbind();
-  struct tree *tp = NULL;
-  char *op_name = data->op_name;
-  char *oid = NULL;
-  char *oid_idx = NULL;
-  int val_type = 0;
-  char val_type_str[MAX_TYPE_NAME_LEN];
-  int val_len = 0;
+  memcpy(decoded->strings + off, str, len);
+  decoded->strings[off + len] = '\0';
+  decoded->strings_len = off + len + 1;
 
-  u_char *str_buf = data->str_buf;
-  size_t str_buf_len = sizeof(data->str_buf);
-  size_t out_len = 0;
-  int buf_over = 0;
+  return (int)off;
+}
 
-  *data->str_buf = '.';
-  *(data->str_buf + 1) = '\0';
-  py_log_msg(DEBUG, "%s: str_buf: %s:%lu:%lu", op_name, str_buf,
-             str_buf_len, out_len);
-  tp = netsnmp_sprint_realloc_objid_tree(&str_buf, &str_buf_len,
-                                         &out_len, 0, &buf_over,
-                                         vars->name, vars->name_length);
+/* the types whose labels and values __decode_var can format by itself */
+static int __decodable_type(int type) {
+  switch (type) {
+  case ASN_INTEGER:
+  case ASN_GAUGE:
+  case ASN_COUNTER:
+  case ASN_TIMETICKS:
+  case ASN_UINTEGER:
+  case ASN_COUNTER64:
+  case ASN_OCTET_STR:
+  case ASN_OPAQUE:
+  case ASN_IPADDRESS:
+  case ASN_OBJECT_ID:
+  case ASN_NULL:
+    return 1;
+  default:
+    return 0;
+  }
+}
 
-  data->str_buf[sizeof(data->str_buf) - 1] = '\0';
-  py_log_msg(DEBUG, "%s: str_buf: %s:%lu:%lu", op_name, str_buf,
-             str_buf_len, out_len);
+/*
+ * Decode the label, instance index and (unless read_value builds it from
+ * the PDU anyway) value of a variable into decoded; called without the
+ * GIL, with mib_tree_lock held for reading.
+ *
+ * returns : 0, or -1 when out of memory
+ */
+static int __decode_var(decoded_pdu *decoded, netsnmp_variable_list *vars,
+                        snmp_op_data *data,
+                        session_capsule_ctx *session_ctx) {
+  decoded_var *dv = NULL;
+  char *label = NULL;
+  char *iid = NULL;
+  size_t size = decoded->size ? decoded->size * 2 : 32;
+  int len;
 
-  val_type = __translate_asn_type(vars->type);
+  if (!__decodable_type(vars->type)) {
+    return 0;
+  }
 
-  if (__is_leaf(tp)) {
-    py_log_msg(DEBUG, "%s: is_leaf: %d", op_name, tp->type);
-  } else {
-    getlabel_flag |= NON_LEAF_NAME;
-    py_log_msg(DEBUG, "%s: !is_leaf: %d", op_name, tp->type);
+  if (decoded->num_vars == decoded->size) {
+    if (!(dv = realloc(decoded->vars, size * sizeof(decoded_var)))) {
+      return -1;
+    }
+    decoded->vars = dv;
+    decoded->size = size;
+  }
+
+  dv = &decoded->vars[decoded->num_vars];
+  dv->vars = vars;
+  dv->value_off = -1;
+  dv->value_len = 0;
+
+  /* both point into data->str_buf, so are copied before the value */
+  dv->tp = __read_label(vars, data, session_ctx, &label, &iid);
+  if ((dv->label_off = __decoded_add_string(decoded, label,
+                                            STRLEN(label))) < -1 ||
+      (dv->iid_off = __decoded_add_string(decoded, iid, STRLEN(iid))) < -1) {
+    return -1;
+  }
+
+  if (!session_ctx->native_types && vars->type != ASN_OCTET_STR &&
+      vars->type != ASN_OPAQUE) {
+    len = __snprint_value((char *)data->str_buf, sizeof(data->str_buf), vars,
+                          dv->tp, __translate_asn_type(vars->type),
+                          session_ctx->sprintval_flag);
+    if ((dv->value_off = __decoded_add_string(
+             decoded, (char *)data->str_buf, len)) < -1) {
+      return -1;
+    }
+    dv->value_len = len;
   }
 
-  py_log_msg(DEBUG, "%s: str_buf: %s", op_name, str_buf);
+  decoded->num_vars++;
+  return 0;
+}
 
-  // Set varbind properties
-  py_netsnmp_attr_set_string(varbind, "root_oid", data->initial_oid, STRLEN(data->initial_oid));
+/*
+ * Decode the variables of data->response into data->decoded without the
+ * GIL, so that decoding the responses of sessions used from different
+ * threads runs in parallel.  Values printed by Net-SNMP itself
+ * (use_sprint_value) depend on the library-wide output format and are
+ * left to read_variable, as are small responses; variables which could
+ * not be decoded here are simply decoded by read_variable as before.
+ */
+static void __decode_response(session_capsule_ctx *session_ctx,
+                              snmp_op_data *data) {
+  decoded_pdu *decoded = &data->decoded;
+  netsnmp_variable_list *vars = NULL;
+  int num_vars = 0;
 
-  __get_label_iid((char *)data->str_buf, &oid, &oid_idx, getlabel_flag);
-  py_netsnmp_attr_set_string(varbind, "oid", oid, STRLEN(oid));
-  py_netsnmp_attr_set_string(varbind, "oid_index", oid_idx, STRLEN(oid_idx));
+  decoded->num_vars = 0;
+  decoded->next = 0;
+  decoded->strings_len = 0;
 
-  __get_type_str(val_type, val_type_str, 1);
-  py_netsnmp_attr_set_string(varbind, "snmp_type", val_type_str,
-                             strlen(val_type_str));
+  if (!data->response || data->response->errstat != SNMP_ERR_NOERROR ||
+      session_ctx->sprintval_flag == USE_SPRINT_VALUE) {
+    return;
+  }
 
-  val_len = __snprint_value((char *)data->str_buf, sizeof(data->str_buf), vars, tp, val_type,
-                        sprintval_flag);
-  str_buf[val_len] = '\0';
-  py_netsnmp_attr_set_string(varbind, "value", (char *)str_buf, val_len);
+  for (vars = data->response->variables; vars; vars = vars->next_variable) {
+    num_vars++;
+  }
+  if (num_vars < DECODE_NOGIL_MIN_VARS) {
+    return;
+  }
 
-  return varbind;
+  Py_BEGIN_ALLOW_THREADS
+  pthread_rwlock_rdlock(&mib_tree_lock);
+  for (vars = data->response->variables; vars; vars = vars->next_variable) {
+    if (__decode_var(decoded, vars, data, session_ctx) < 0) {
+      break;
+    }
+  }
+  pthread_rwlock_unlock(&mib_tree_lock);
+  Py_END_ALLOW_THREADS
 }
 
-static PyObject *netsnmp_create_session(PyObject *self, PyObject *args) {
-  int version;
-  char *community;
-  char *peer;
-  int lport;
-  int retries;
-  int timeout;
-  SnmpSession session = {0};
+/*
+ * The decoded form of vars, if __decode_response decoded it; lookups are
+ * expected in response order, so each starts after the last one found.
+ */
+static decoded_var *__decoded_lookup(decoded_pdu *decoded,
+                                     netsnmp_variable_list *vars) {
+  size_t i;
+
+  for (i = decoded->next; i < decoded->num_vars; i++) {
+    if (decoded->vars[i].vars == vars) {
+      decoded->next = i + 1;
+      return &decoded->vars[i];
+    }
+  }
 
-  if (!PyArg_ParseTuple(args, "issiii", &version, &community, &peer, &lport,
-                        &retries, &timeout)) {
-    goto done;
+  for (i = 0; i < decoded->next && i < decoded->num_vars; i++) {
+    if (decoded->vars[i].vars == vars) {
+      decoded->next = i + 1;
+      return &decoded->vars[i];
+    }
   }
 
-  snmp_sess_init(&session);
+  return NULL;
+}
 
-  session.version = -1;
-#ifndef DISABLE_SNMPV1
-  if (version == 1) {
-    session.version = SNMP_VERSION_1;
-  }
-#endif
-#ifndef DISABLE_SNMPV2C
-  if (version == 2) {
-    session.version = SNMP_VERSION_2c;
-  }
+/*
+ * Send data->pdu and wait for the response.  NOSUCHNAME errors are only
+ * repaired (with retry_nosuch) when invalid_oids is given to record which
+ * varbinds were elided, that is for get and get_next; walks, getbulk and
+ * bulkwalk always see the error, as eliding a varbind would misalign
+ * their responses with the OIDs requested.
+ */
+static int send_pdu_request(session_capsule_ctx *session_ctx, snmp_op_data* data,
+                            bitarray *invalid_oids) {
+  int status = __send_sync_pdu(session_ctx->handle, data->pdu, &data->response,
+                               invalid_oids ? session_ctx->retry_nosuch
+                                            : NO_RETRY_NOSUCH,
+                               session_ctx->err_str, &session_ctx->err_num,
+                               &session_ctx->err_ind, invalid_oids,
+                               &session_ctx->stats);
+
+  data->pdu = NULL;
+  __decode_response(session_ctx, data);
+
+  return status;
+}
+
+/*
+ * Convert the value of a response variable straight into a Python object
+ * for session option use_native_types: integers of every size become ints,
+ * OBJECT IDENTIFIERs become tuples of ints and NULL becomes None (OCTET STR
+ * and Opaque values are turned into bytes by read_value itself).
+ *
+ * returns : a new reference, or NULL when the value should be formatted as
+ *           a string as usual (with a Python exception set on failure)
+ */
+static PyObject *__native_value(netsnmp_variable_list *var, struct tree *tp,
+                                int sprintval_flag) {
+  PyObject *val_obj = NULL;
+  size_t num_arcs;
+  size_t i;
+
+  switch (var->type) {
+  case ASN_INTEGER:
+    /* enumeration labels take precedence when use_enums is set */
+    if (sprintval_flag == USE_ENUMS && tp && tp->enums) {
+      return NULL;
+    }
+    return PyLong_FromLong(*var->val.integer);
+
+  case ASN_GAUGE:
+  case ASN_COUNTER:
+  case ASN_TIMETICKS:
+  case ASN_UINTEGER:
+    return PyLong_FromUnsignedLong((unsigned long)*var->val.integer);
+
+  case ASN_COUNTER64:
+#ifdef OPAQUE_SPECIAL_TYPES
+  case ASN_OPAQUE_COUNTER64:
+  case ASN_OPAQUE_U64:
 #endif
-  if (version == 3) {
-    session.version = SNMP_VERSION_3;
+    return PyLong_FromUnsignedLongLong(
+        ((unsigned long long)var->val.counter64->high << 32) |
+        (unsigned long long)var->val.counter64->low);
+
+#ifdef OPAQUE_SPECIAL_TYPES
+  case ASN_OPAQUE_I64:
+    return PyLong_FromLongLong(
+        (long long)(((unsigned long long)var->val.counter64->high << 32) |
+                    (unsigned long long)var->val.counter64->low));
+
+  case ASN_OPAQUE_FLOAT:
+    if (var->val.floatVal) {
+      return PyFloat_FromDouble(*var->val.floatVal);
+    }
+    return NULL;
+
+  case ASN_OPAQUE_DOUBLE:
+    if (var->val.doubleVal) {
+      return PyFloat_FromDouble(*var->val.doubleVal);
+    }
+    return NULL;
+#endif
+
+  case ASN_OBJECT_ID:
+    num_arcs = var->val_len / sizeof(oid);
+    if (!(val_obj = PyTuple_New(num_arcs))) {
+      return NULL;
+    }
+    for (i = 0; i < num_arcs; i++) {
+      PyObject *arc = PyLong_FromUnsignedLong(var->val.objid[i]);
+
+      if (!arc) {
+        Py_DECREF(val_obj);
+        return NULL;
+      }
+      PyTuple_SET_ITEM(val_obj, i, arc);
+    }
+    return val_obj;
+
+  case ASN_NULL:
+    Py_INCREF(Py_None);
+    return Py_None;
+
+  default:
+    return NULL;
   }
-  if (session.version == -1) {
-    PyErr_Format(PyExc_ValueError, "unsupported SNMP version (%d)", version);
-    goto done;
+}
+
+/*
+ * Build the value of a response variable, formatted into data->str_buf
+ * as a string unless native_types (or octet_bytes, for strings) calls for
+ * a native Python object; tp is the MIB node of the variable, needed for
+ * USE_ENUMS.
+ */
+static PyObject *read_value(netsnmp_variable_list *vars, snmp_op_data *data,
+                            struct tree *tp, int sprintval_flag,
+                            int native_types, int octet_bytes) {
+  int val_len = 0;
+
+  /*
+   * Strings are taken straight from the response PDU rather than being
+   * copied into str_buf first, which would also truncate them to its size
+   */
+  if ((vars->type == ASN_OCTET_STR || vars->type == ASN_OPAQUE) &&
+      sprintval_flag != USE_SPRINT_VALUE) {
+    char *val = vars->val.string ? (char *)vars->val.string : "";
+
+    if (native_types || octet_bytes) {
+      return PyBytes_FromStringAndSize(val, vars->val_len);
+    }
+    return PyUnicode_Decode(val, vars->val_len, "latin-1", "surrogateescape");
   }
 
-  session.community_len = STRLEN((char *)community);
-  session.community = (u_char *)community;
-  session.peername = peer;
-  session.local_port = lport;
-  session.retries = retries; /* 5 */
-  session.timeout = timeout; /* 1000000L */
-  session.authenticator = NULL;
+  if (native_types && sprintval_flag != USE_SPRINT_VALUE) {
+    PyObject *val_obj = __native_value(vars, tp, sprintval_flag);
 
-  return create_session_capsule(&session);
+    if (val_obj || PyErr_Occurred()) {
+      return val_obj;
+    }
+  }
 
-done:
+  val_len = __snprint_value((char *)data->str_buf, sizeof(data->str_buf), vars,
+                            tp, __translate_asn_type(vars->type),
+                            sprintval_flag);
 
-  return NULL;
+  return PyUnicode_Decode((char *)data->str_buf, val_len, "latin-1",
+                          "surrogateescape");
 }
 
-static PyObject *netsnmp_create_session_v3(PyObject *self, PyObject *args) {
-  int version;
-  char *peer;
-  int lport;
-  int retries;
-  int timeout;
-  char *sec_name;
-  int sec_level;
-  char *sec_eng_id;
-  char *context_eng_id;
-  char *context;
-  char *auth_proto;
-  char *auth_pass;
-  char *priv_proto;
-  char *priv_pass;
-  int eng_boots;
-  int eng_time;
-  SnmpSession session = {0};
-  int md5_enabled = 1;
-  int des_enabled = 1;
+/*
+ * Split the name of a response variable into its label and instance
+ * index, from the label cache or else by translating it into
+ * data->str_buf; *label and *iid point into data->str_buf (or are NULL
+ * when the name could not be split).  This neither logs nor touches any
+ * Python object, so that __decode_response may call it without the GIL.
+ *
+ * returns : the MIB node of the variable, or NULL
+ */
+static struct tree *__read_label(netsnmp_variable_list *vars,
+                                 snmp_op_data *data,
+                                 session_capsule_ctx *session_ctx,
+                                 char **label, char **iid) {
+  int getlabel_flag = session_ctx->getlabel_flag;
+  struct tree *tp = NULL;
+  char *oid = NULL;
+  char *oid_idx = NULL;
 
-#ifndef DISABLE_MD5
-  md5_enabled = 0;
-#endif
-#ifndef DISABLE_DES
-  des_enabled = 0;
-#endif
+  unsigned char label_key[2 * sizeof(int) + MAX_OID_LEN * sizeof(oid)];
+  size_t label_key_len = 0;
 
-  if (!PyArg_ParseTuple(args, "isiiisisssssssii", &version, &peer, &lport,
-                        &retries, &timeout, &sec_name, &sec_level, &sec_eng_id,
-                        &context_eng_id, &context, &auth_proto, &auth_pass,
-                        &priv_proto, &priv_pass, &eng_boots, &eng_time)) {
-    return NULL;
+  label_key_len = __label_cache_key(label_key, vars->name, vars->name_length,
+                                    session_ctx->oid_output_format,
+                                    getlabel_flag);
+  tp = __label_cache_get(label_key, label_key_len, data->str_buf, &oid,
+                         &oid_idx);
+
+  if (!tp) {
+    tp = __sprint_objid((char *)data->str_buf, sizeof(data->str_buf),
+                        vars->name, vars->name_length,
+                        session_ctx->oid_output_format);
+
+    if (__get_label_iid((char *)data->str_buf, &oid, &oid_idx,
+                        getlabel_flag |
+                            (__is_leaf(tp) ? 0 : NON_LEAF_NAME)) == SUCCESS) {
+      __label_cache_put(label_key, label_key_len, tp, oid, oid_idx);
+    }
   }
 
-  snmp_sess_init(&session);
+  *label = oid;
+  *iid = oid_idx;
+  return tp;
+}
 
-  if (version == 3) {
-    session.version = SNMP_VERSION_3;
+static PyObject *read_variable(netsnmp_variable_list *vars,
+                               snmp_op_data *data,
+                               session_capsule_ctx *session_ctx) {
+  PyObject *varbind = py_netsnmp_construct_varbind();
+  PyObject *val_obj = NULL;
+  struct tree *tp = NULL;
+  decoded_var *decoded = __decoded_lookup(&data->decoded, vars);
+  char *strings = data->decoded.strings;
+  char *oid = NULL;
+  char *oid_idx = NULL;
+  int val_type = 0;
+  char val_type_str[MAX_TYPE_NAME_LEN];
+
+  session_ctx->stats.varbinds_decoded++;
+
+  /* values printed by Net-SNMP itself may hold OIDs too */
+  if (session_ctx->sprintval_flag == USE_SPRINT_VALUE) {
+    __use_output_format(session_ctx);
+  }
+
+  if (decoded) {
+    tp = decoded->tp;
+    oid = (decoded->label_off >= 0) ? strings + decoded->label_off : NULL;
+    oid_idx = (decoded->iid_off >= 0) ? strings + decoded->iid_off : NULL;
   } else {
-    PyErr_Format(PyExc_ValueError, "unsupported SNMP version (%d)", version);
-    goto done;
+    tp = __read_label(vars, data, session_ctx, &oid, &oid_idx);
   }
 
-  session.peername = peer;
-  session.retries = retries; /* 5 */
-  session.timeout = timeout; /* 1000000L */
-  session.authenticator = NULL;
-  session.contextNameLen = STRLEN(context);
-  session.contextName = context;
-  session.securityNameLen = STRLEN(sec_name);
-  session.securityName = sec_name;
-  session.securityLevel = sec_level;
-  session.securityModel = USM_SEC_MODEL_NUMBER;
-  session.securityEngineIDLen =
-      hex_to_binary2((unsigned char *)sec_eng_id, STRLEN(sec_eng_id),
-                     (char **)&session.securityEngineID);
-  session.contextEngineIDLen =
-      hex_to_binary2((unsigned char *)context_eng_id, STRLEN(sec_eng_id),
-                     (char **)&session.contextEngineID);
-  session.engineBoots = eng_boots;
-  session.engineTime = eng_time;
+  val_type = __translate_asn_type(vars->type);
+
+  // Set varbind properties
+  py_netsnmp_varbind_set_string(varbind, VARBIND_ROOT_F, data->initial_oid, STRLEN(data->initial_oid));
 
+  py_netsnmp_varbind_set_string(varbind, VARBIND_TAG_F, oid, STRLEN(oid));
+  py_netsnmp_varbind_set_string(varbind, VARBIND_IID_F, oid_idx,
+                                STRLEN(oid_idx));
 
-    if ((md5_enabled == 1) && !strcmp(auth_proto, "MD5")) {
-      session.securityAuthProto =
-          snmp_duplicate_objid(usmHMACMD5AuthProtocol, USM_AUTH_PROTO_MD5_LEN);
-      session.securityAuthProtoLen = USM_AUTH_PROTO_MD5_LEN;
-    } else if (!strcmp(auth_proto, "SHA")) {
-    session.securityAuthProto =
-        snmp_duplicate_objid(usmHMACSHA1AuthProtocol, USM_AUTH_PROTO_SHA_LEN);
-    session.securityAuthProtoLen = USM_AUTH_PROTO_SHA_LEN;
-  } else if (!strcmp(auth_proto, "DEFAULT")) {
-    const oid *a = get_default_authtype(&session.securityAuthProtoLen);
-    session.securityAuthProto =
-        snmp_duplicate_objid(a, session.securityAuthProtoLen);
+  __get_type_str(val_type, val_type_str, 1);
+  py_netsnmp_varbind_set_string(varbind, VARBIND_TYPE_F, val_type_str,
+                                strlen(val_type_str));
+
+  if (decoded && decoded->value_off >= 0) {
+    val_obj = PyUnicode_Decode(strings + decoded->value_off,
+                               decoded->value_len, "latin-1",
+                               "surrogateescape");
   } else {
-    PyErr_Format(PyExc_ValueError, "unsupported authentication protocol (%s)",
-                 auth_proto);
-    goto done;
+    val_obj = read_value(vars, data, tp, session_ctx->sprintval_flag,
+                         session_ctx->native_types, session_ctx->octet_bytes);
   }
-  if (session.securityLevel >= SNMP_SEC_LEVEL_AUTHNOPRIV) {
-    if (STRLEN(auth_pass) > 0) {
-      session.securityAuthKeyLen = USM_AUTH_KU_LEN;
-      if (generate_Ku(session.securityAuthProto, session.securityAuthProtoLen,
-                      (u_char *)auth_pass, STRLEN(auth_pass),
-                      session.securityAuthKey,
-                      &session.securityAuthKeyLen) != SNMPERR_SUCCESS) {
-        PyErr_SetString(EasySNMPConnectionError,
-                        "error generating Ku from authentication "
-                        "password");
-        goto done;
-      }
+  if (!val_obj) {
+    Py_XDECREF(varbind);
+    return NULL;
+  }
+  py_netsnmp_varbind_set_object(varbind, VARBIND_VAL_F, val_obj);
+
+  return varbind;
+}
+
+/*
+ * Build the SNMPVariable for a response variable; NOSUCHOBJECT and
+ * NOSUCHINSTANCE exceptions are reported against data->initial_oid.
+ */
+static PyObject *__build_response_varbind(netsnmp_variable_list *vars,
+                                          snmp_op_data *data,
+                                          session_capsule_ctx *session_ctx) {
+  PyObject *varbind = NULL;
+
+  if ((vars->type == SNMP_NOSUCHOBJECT) ||
+      (vars->type == SNMP_NOSUCHINSTANCE)) {
+    char val_type_str[MAX_TYPE_NAME_LEN];
+
+    __get_type_str(vars->type, val_type_str, 1);
+    varbind = py_netsnmp_construct_varbind();
+    if (!varbind) {
+      return NULL;
+    }
+
+    py_netsnmp_varbind_set_string(varbind, VARBIND_ROOT_F, data->initial_oid,
+                                  STRLEN(data->initial_oid));
+    py_netsnmp_varbind_set_string(varbind, VARBIND_TAG_F, data->initial_oid,
+                                  STRLEN(data->initial_oid));
+    py_netsnmp_varbind_set_string(varbind, VARBIND_TYPE_F, val_type_str,
+                                  strlen(val_type_str));
+    return varbind;
+  }
+
+  return read_variable(vars, data, session_ctx);
+}
+
+/*
+ * Append a single response variable for the request at varlist_ind to
+ * result_varlist, applying the same end conditions as a single varbind
+ * GET/GETNEXT request would.
+ */
+static void __append_response_var(netsnmp_variable_list *vars,
+                                  snmp_op_data *data, int varlist_ind,
+                                  session_capsule_ctx *session_ctx,
+                                  PyObject *result_varlist) {
+  PyObject *varbind = NULL;
+  char *op_name = data->op_name;
+
+  data->initial_oid = data->initial_oid_str_arr[varlist_ind];
+
+  if (vars->type == SNMP_ENDOFMIBVIEW) {
+    py_log_msg(DEBUG, "%s: encountered end condition "
+                      "(ENDOFMIBVIEW)", op_name);
+    return;
+  }
+
+  if ((vars->type != SNMP_NOSUCHOBJECT) &&
+      (vars->type != SNMP_NOSUCHINSTANCE) &&
+      ((vars->name_length < data->oid_arr_len[varlist_ind]) ||
+       (memcmp(data->oid_arr[varlist_ind], vars->name,
+               data->oid_arr_len[varlist_ind] * sizeof(oid)) != 0))) {
+    py_log_msg(DEBUG, "%s: encountered end condition (next subtree "
+                      "iteration out of scope) var_len: %d/op_var_len: %d",
+               op_name, vars->name_length, data->oid_arr_len[varlist_ind]);
+    return;
+  }
+
+  varbind = __build_response_varbind(vars, data, session_ctx);
+
+  if (varbind) {
+    PyList_Append(result_varlist, varbind);
+    Py_DECREF(varbind);
+  } else {
+    py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
+  }
+}
+
+static long __nosuch_cache_now(void) {
+  struct timeval now;
+
+  netsnmp_get_monotonic_clock(&now);
+  return now.tv_sec;
+}
+
+/*
+ * Look up whether the agent of a session is known not to have the OID
+ * name, returning the type it answered with or 0 if it is not known to be
+ * missing (or has not been for long enough to be forgotten).
+ */
+static int __nosuch_cache_get(session_capsule_ctx *session_ctx, oid *name,
+                              int name_len) {
+  nosuch_cache_value value;
+  size_t value_len = 0;
+  void *cached = simple_cache_get(&session_ctx->nosuch_cache, name,
+                                  name_len * sizeof(oid), &value_len);
+
+  if (!cached || value_len != sizeof(value)) {
+    return 0;
+  }
+
+  memcpy(&value, cached, sizeof(value));
+  if (value.expires <= __nosuch_cache_now()) {
+    return 0;
+  }
+
+  return value.type;
+}
+
+/*
+ * Remember that the agent answered type to the OID name, for missing_ttl
+ * seconds; nothing is remembered when no TTL is set.
+ */
+static void __nosuch_cache_put(session_capsule_ctx *session_ctx, oid *name,
+                               int name_len, int type) {
+  nosuch_cache_value value;
+
+  if (session_ctx->missing_ttl <= 0) {
+    return;
+  }
+
+  if (!session_ctx->nosuch_cache.slots &&
+      simple_cache_init(&session_ctx->nosuch_cache, NOSUCH_CACHE_SIZE) < 0) {
+    return;
+  }
+
+  memset(&value, 0, sizeof(value));
+  value.type = type;
+  value.expires = __nosuch_cache_now() + session_ctx->missing_ttl;
+
+  simple_cache_put(&session_ctx->nosuch_cache, name, name_len * sizeof(oid),
+                   &value, sizeof(value));
+}
+
+/*
+ * Append a placeholder for a request which the agent rejected with
+ * NOSUCHNAME and which was elided from the PDU by retry_nosuch.
+ */
+static void __append_elided_var(snmp_op_data *data, int varlist_ind,
+                                PyObject *result_varlist) {
+  char *initial_oid = data->initial_oid_str_arr[varlist_ind];
+  PyObject *varbind = py_netsnmp_construct_varbind();
+
+  if (!varbind) {
+    return;
+  }
+
+  py_netsnmp_varbind_set_string(varbind, VARBIND_ROOT_F, initial_oid,
+                                STRLEN(initial_oid));
+  py_netsnmp_varbind_set_string(varbind, VARBIND_TAG_F, initial_oid,
+                                STRLEN(initial_oid));
+  py_netsnmp_varbind_set_string(varbind, VARBIND_TYPE_F, "NULL", 4);
+
+  PyList_Append(result_varlist, varbind);
+  Py_DECREF(varbind);
+}
+
+/*
+ * Answer the request at varlist_ind locally for an OID the agent is known
+ * not to have, just as it last answered it.
+ */
+static void __append_missing_var(snmp_op_data *data, int varlist_ind,
+                                 int type, session_capsule_ctx *session_ctx,
+                                 PyObject *result_varlist) {
+  netsnmp_variable_list var;
+
+  if (type == SNMP_ERR_NOSUCHNAME) {
+    __append_elided_var(data, varlist_ind, result_varlist);
+    return;
+  }
+
+  memset(&var, 0, sizeof(var));
+  var.name = data->oid_arr[varlist_ind];
+  var.name_length = data->oid_arr_len[varlist_ind];
+  var.type = type;
+
+  __append_response_var(&var, data, varlist_ind, session_ctx, result_varlist);
+}
+
+/*
+ * Send every OID in data as GET or GETNEXT requests, packing up to
+ * session_ctx->max_varbinds varbinds into each PDU (0 means no limit).
+ *
+ * When the agent answers SNMP_ERR_TOOBIG the chunk is halved and resent,
+ * and the smaller chunk size is kept for the remainder of the request.
+ * Response varbinds are mapped back onto their originating request so
+ * that root_oid and the subtree checks refer to initial_oid_str_arr.
+ *
+ * A v1 agent names only one missing OID per NOSUCHNAME response, so with
+ * missing_ttl set the OIDs it turns out not to have with retry_nosuch are
+ * remembered for that long and given their placeholders straight away on
+ * later GETs, as are those answered NOSUCHOBJECT or NOSUCHINSTANCE.
+ *
+ * returns : STAT_SUCCESS, or the failing status with session_ctx errors
+ *           (and possibly a Python exception) set
+ */
+static int send_packed_requests(session_capsule_ctx *session_ctx,
+                                snmp_op_data *data, int command,
+                                PyObject *result_varlist) {
+  BITARRAY_DECLARE(default_invalid_oids, DEFAULT_NUM_BAD_OIDS);
+  bitarray *invalid_oids = default_invalid_oids;
+  int default_missing_types[DEFAULT_NUM_BAD_OIDS];
+  int *missing_types = default_missing_types;
+  netsnmp_variable_list *vars = NULL;
+  char *op_name = data->op_name;
+  int varlist_len = data->varlist_len;
+  int varlist_ind = 0;
+  int chunk_len = session_ctx->max_varbinds;
+  int status = STAT_SUCCESS;
+  int use_nosuch_cache =
+      command == SNMP_MSG_GET && session_ctx->missing_ttl > 0;
+  int num_varbinds;
+  int num_sent;
+  int pdu_ind;
+  int missing;
+  int i;
+
+  if (chunk_len <= 0 || chunk_len > varlist_len) {
+    chunk_len = varlist_len;
+  }
+
+  if (chunk_len > DEFAULT_NUM_BAD_OIDS) {
+    invalid_oids = bitarray_calloc(chunk_len);
+    missing_types = malloc(chunk_len * sizeof(int));
+    if (!invalid_oids || !missing_types) {
+      PyErr_NoMemory();
+      status = STAT_ERROR;
+      goto done;
+    }
+  }
+
+  while (varlist_ind < varlist_len) {
+    num_varbinds = varlist_len - varlist_ind;
+    if (num_varbinds > chunk_len) {
+      num_varbinds = chunk_len;
+    }
+
+    num_sent = 0;
+
+    data->pdu = snmp_pdu_create(command);
+    for (i = varlist_ind; i < varlist_ind + num_varbinds; i++) {
+      missing_types[i - varlist_ind] =
+          use_nosuch_cache ? __nosuch_cache_get(session_ctx, data->oid_arr[i],
+                                                data->oid_arr_len[i])
+                           : 0;
+      if (missing_types[i - varlist_ind]) {
+        continue;
+      }
+
+      snmp_add_null_var(data->pdu, data->oid_arr[i], data->oid_arr_len[i]);
+      num_sent++;
+
+      py_log_msg(DEBUG, "%s: filling request: oid(%s) "
+                        "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
+                 op_name, data->oid_str_arr[i], data->oid_idx_str_arr[i],
+                 data->oid_arr_len[i], session_ctx->best_guess);
+    }
+
+    bitarray_zero(invalid_oids);
+
+    if (!num_sent) {
+      /* the agent is known to have none of them */
+      snmp_free_pdu(data->pdu);
+      data->pdu = NULL;
+      for (i = 0; i < num_varbinds; i++) {
+        __append_missing_var(data, varlist_ind + i, missing_types[i],
+                             session_ctx, result_varlist);
+      }
+      varlist_ind += num_varbinds;
+      continue;
+    }
+
+    py_log_msg(DEBUG, "%s: Sending pdu req with %d varbinds", op_name,
+               num_sent);
+
+    status = send_pdu_request(session_ctx, data, invalid_oids);
+
+    if (data->response && data->response->errstat == SNMP_ERR_TOOBIG &&
+        num_sent > 1) {
+      /* split the request and retry, discarding the too big error */
+      PyErr_Clear();
+      snmp_free_pdu(data->response);
+      data->response = NULL;
+      session_ctx->err_str[0] = '\0';
+      session_ctx->err_num = 0;
+      session_ctx->err_ind = 0;
+
+      chunk_len = num_varbinds / 2;
+      py_log_msg(DEBUG, "%s: response too big, retrying with %d varbinds",
+                 op_name, chunk_len);
+      continue;
+    }
+
+    if ((status != STAT_SUCCESS) || PyErr_Occurred()) {
+      py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
+                 op_name, status);
+      if (status == STAT_SUCCESS) {
+        status = STAT_ERROR;
+      }
+      goto done;
+    }
+
+    /*
+     * With retry_nosuch enabled the varbinds which returned NOSUCHNAME were
+     * elided from the final request; if every varbind was elided we are
+     * left holding the error response, which carries no values.
+     */
+    vars = NULL;
+    if (data->response && data->response->errstat == SNMP_ERR_NOERROR) {
+      vars = data->response->variables;
+    }
+
+    pdu_ind = 0;
+    for (i = 0; i < num_varbinds; i++) {
+      if (missing_types[i]) {
+        __append_missing_var(data, varlist_ind + i, missing_types[i],
+                             session_ctx, result_varlist);
+        continue;
+      }
+
+      missing = bitarray_test_bit(invalid_oids, pdu_ind++);
+      if (missing && use_nosuch_cache) {
+        __nosuch_cache_put(session_ctx, data->oid_arr[varlist_ind + i],
+                           data->oid_arr_len[varlist_ind + i],
+                           SNMP_ERR_NOSUCHNAME);
+      }
+
+      if (missing || !vars) {
+        __append_elided_var(data, varlist_ind + i, result_varlist);
+        continue;
+      }
+
+      if (use_nosuch_cache && (vars->type == SNMP_NOSUCHOBJECT ||
+                               vars->type == SNMP_NOSUCHINSTANCE)) {
+        __nosuch_cache_put(session_ctx, data->oid_arr[varlist_ind + i],
+                           data->oid_arr_len[varlist_ind + i], vars->type);
+      }
+
+      __append_response_var(vars, data, varlist_ind + i, session_ctx,
+                            result_varlist);
+      vars = vars->next_variable;
+    }
+
+    py_log_msg(DEBUG, "%s: Finished reading all variables from request",
+               op_name);
+
+    if (data->response) {
+      snmp_free_pdu(data->response);
+      data->response = NULL;
+    }
+
+    varlist_ind += num_varbinds;
+  }
+
+done:
+
+  if (invalid_oids != default_invalid_oids) {
+    bitarray_free(invalid_oids);
+  }
+  if (missing_types != default_missing_types) {
+    free(missing_types);
+  }
+
+  return status;
+}
+
+/*
+ * Adaptive max_repetitions for bulkwalk.
+ *
+ * GETBULK responses are kept below ADAPTIVE_MAX_RESPONSE_SIZE so they fit
+ * in a single Ethernet frame.  max_repetitions grows while full responses
+ * come back quickly with room to spare.  It shrinks when responses grow
+ * too big, when the agent answers SNMP_ERR_TOOBIG, or when a request
+ * times out.  The value learned is kept in the session context and used
+ * to start the next adaptive bulkwalk of that session.
+ */
+#define ADAPTIVE_MAX_RESPONSE_SIZE (1400)
+#define ADAPTIVE_MAX_REPETITIONS (256)
+
+/* a response is "fast" when it takes under 1/10th of the session timeout */
+#define ADAPTIVE_FAST_RESPONSE_DIVISOR (10)
+
+/* BER encoded size of a tag and length header for len bytes of content */
+static size_t __ber_header_size(size_t len) {
+  return (len < 0x80) ? 2 : (len < 0x100) ? 3 : 4;
+}
+
+static size_t __ber_oid_size(const oid *name, size_t name_len) {
+  size_t size = 1;
+  size_t i;
+  oid arc;
+
+  for (i = 2; i < name_len; i++) {
+    for (arc = name[i] >> 7, size++; arc; arc >>= 7) {
+      size++;
+    }
+  }
+  return size;
+}
+
+/*
+ * Estimate the encoded size of the variable bindings in a response; the
+ * message header is left to the slack in ADAPTIVE_MAX_RESPONSE_SIZE.
+ */
+static size_t __estimate_response_size(netsnmp_pdu *response) {
+  netsnmp_variable_list *vars = NULL;
+  size_t size = 0;
+  size_t name_size;
+  size_t val_size;
+
+  for (vars = response->variables; vars; vars = vars->next_variable) {
+    name_size = __ber_oid_size(vars->name, vars->name_length);
+
+    switch (vars->type) {
+    case ASN_OCTET_STR:
+    case ASN_OPAQUE:
+    case ASN_IPADDRESS:
+    case ASN_BIT_STR:
+      val_size = vars->val_len;
+      break;
+
+    case ASN_OBJECT_ID:
+      val_size = __ber_oid_size(vars->val.objid, vars->val_len / sizeof(oid));
+      break;
+
+    case ASN_COUNTER64:
+      val_size = 9;
+      break;
+
+    case ASN_NULL:
+    case SNMP_NOSUCHOBJECT:
+    case SNMP_NOSUCHINSTANCE:
+    case SNMP_ENDOFMIBVIEW:
+      val_size = 0;
+      break;
+
+    default:
+      val_size = 5;
+      break;
+    }
+
+    name_size += __ber_header_size(name_size);
+    val_size += __ber_header_size(val_size);
+    size += name_size + val_size + __ber_header_size(name_size + val_size);
+  }
+
+  return size;
+}
+
+/* the max_repetitions to start an adaptive bulkwalk with */
+static int __adaptive_initial_repetitions(session_capsule_ctx *session_ctx,
+                                          int max_repetitions) {
+  if (session_ctx->bulk_repetitions > 0) {
+    return session_ctx->bulk_repetitions;
+  }
+  return max_repetitions > 0 ? max_repetitions : 1;
+}
+
+/*
+ * Retune *repetitions after a successful response to a GETBULK request
+ * carrying num_columns repeating varbinds, which took rtt microseconds.
+ */
+static void __adapt_repetitions(session_capsule_ctx *session_ctx,
+                                int *repetitions, netsnmp_pdu *response,
+                                int num_columns, long rtt) {
+  netsnmp_session *ss = snmp_sess_session(session_ctx->handle);
+  netsnmp_variable_list *vars = NULL;
+  size_t size = __estimate_response_size(response);
+  size_t row_size;
+  int num_vars = 0;
+  int num_rows;
+  int fit;
+  int next = *repetitions;
+
+  for (vars = response->variables; vars; vars = vars->next_variable) {
+    num_vars++;
+  }
+
+  num_rows = num_vars / (num_columns > 0 ? num_columns : 1);
+  if (!num_rows) {
+    return;
+  }
+
+  row_size = size / num_rows;
+  fit = row_size ? ADAPTIVE_MAX_RESPONSE_SIZE / row_size : *repetitions;
+  if (fit < 1) {
+    fit = 1;
+  }
+  if (fit > ADAPTIVE_MAX_REPETITIONS) {
+    fit = ADAPTIVE_MAX_REPETITIONS;
+  }
+
+  if (size > ADAPTIVE_MAX_RESPONSE_SIZE) {
+    next = fit;
+  } else if (num_rows >= *repetitions && ss &&
+             rtt < ss->timeout / ADAPTIVE_FAST_RESPONSE_DIVISOR) {
+    /* only a full response tells us the agent could have sent more */
+    next = *repetitions * 2;
+    if (next > fit) {
+      next = fit;
+    }
+  }
+
+  if (next < 1) {
+    next = 1;
+  }
+
+  if (next != *repetitions) {
+    py_log_msg(DEBUG, "adaptive bulkwalk: max_repetitions %d -> %d "
+                      "(%d rows, ~%d bytes, %ld usec)",
+               *repetitions, next, num_rows, (int)size, rtt);
+    *repetitions = next;
+  }
+  session_ctx->bulk_repetitions = next;
+}
+
+/*
+ * Decide whether a failed GETBULK request should be retried with fewer
+ * repetitions; when it should, *repetitions is halved and the error is
+ * discarded.  Only a tooBig response is always retried: a request which
+ * got no answer at all is retried once per walk (*timeout_retried then
+ * being set), as the agent may simply be unreachable, and any other error
+ * is left to the caller.
+ */
+static int __adaptive_retry(session_capsule_ctx *session_ctx,
+                            snmp_op_data *data, int status,
+                            int *repetitions, int *timeout_retried) {
+  int too_big = data->response &&
+                data->response->errstat == SNMP_ERR_TOOBIG;
+  /*
+   * __send_sync_pdu reports most errors as STAT_TIMEOUT, so look at what
+   * actually came back instead
+   */
+  int timed_out = !data->response && status != STAT_SUCCESS &&
+                  session_ctx->err_ind == SNMPERR_TIMEOUT;
+
+  if (*repetitions <= 1) {
+    return 0;
+  }
+
+  if (!too_big) {
+    if (!timed_out || *timeout_retried) {
+      return 0;
+    }
+    *timeout_retried = 1;
+  }
+
+  PyErr_Clear();
+  if (data->response) {
+    snmp_free_pdu(data->response);
+    data->response = NULL;
+  }
+  session_ctx->err_str[0] = '\0';
+  session_ctx->err_num = 0;
+  session_ctx->err_ind = 0;
+
+  *repetitions /= 2;
+  session_ctx->bulk_repetitions = *repetitions;
+
+  py_log_msg(DEBUG, "%s: %s, retrying with max_repetitions %d",
+             data->op_name, too_big ? "response too big" : "timed out",
+             *repetitions);
+  return 1;
+}
+
+static long __elapsed_usec(struct timeval *start) {
+  struct timeval now;
+
+  netsnmp_get_monotonic_clock(&now);
+  return (now.tv_sec - start->tv_sec) * 1000000L +
+         (now.tv_usec - start->tv_usec);
+}
+
+/*
+ * Walk state for several subtrees at once.  Every column starts at
+ * data->oid_arr[column] and is advanced independently from the name of the
+ * last variable returned for it; a column is dropped from the following
+ * requests as soon as it leaves its subtree or the agent runs out of MIB.
+ */
+typedef struct walk_columns walk_columns;
+
+/*
+ * Called for every in-scope response variable of a column, in the order
+ * the agent returned them; return -1 with a Python exception set to abort.
+ */
+typedef int (*walk_emit_fn)(walk_columns *walk, snmp_op_data *data,
+                            int column, netsnmp_variable_list *vars);
+
+struct walk_columns {
+  session_capsule_ctx *session_ctx;
+  int command;
+  int max_repetitions;
+
+  /* cap on the columns carried by one request, 0 for no limit */
+  int max_columns;
+
+  /* retune max_repetitions from each response (GETBULK only) */
+  int adaptive;
+
+  /* set once a timed out request has been retried, see __adaptive_retry */
+  int timeout_retried;
+
+  int num_columns;
+  int num_active;
+  int *active;
+  int *pdu_columns;
+  int num_pdu_columns;
+  char *ended;
+
+  oid **last_oid;
+  size_t *last_oid_len;
+
+  walk_emit_fn emit;
+  void *emit_arg;
+};
+
+static void walk_columns_free(walk_columns *walk) {
+  int i;
+
+  if (walk->last_oid) {
+    for (i = 0; i < walk->num_columns; i++) {
+      PyMem_Free(walk->last_oid[i]);
+    }
+  }
+  PyMem_Free(walk->last_oid);
+  PyMem_Free(walk->last_oid_len);
+  PyMem_Free(walk->active);
+  PyMem_Free(walk->pdu_columns);
+  PyMem_Free(walk->ended);
+  memset(walk, 0, sizeof(*walk));
+}
+
+static int walk_columns_init(walk_columns *walk, snmp_op_data *data,
+                             session_capsule_ctx *session_ctx, int command,
+                             int max_repetitions, walk_emit_fn emit,
+                             void *emit_arg) {
+  int num_columns = data->varlist_len;
+  int i;
+
+  memset(walk, 0, sizeof(*walk));
+  walk->session_ctx = session_ctx;
+  walk->command = command;
+  walk->max_repetitions = max_repetitions > 0 ? max_repetitions : 1;
+  walk->emit = emit;
+  walk->emit_arg = emit_arg;
+
+  walk->active = PyMem_New(int, num_columns);
+  walk->pdu_columns = PyMem_New(int, num_columns);
+  walk->ended = PyMem_New(char, num_columns);
+  walk->last_oid = PyMem_New(oid *, num_columns);
+  walk->last_oid_len = PyMem_New(size_t, num_columns);
+
+  if (!walk->active || !walk->pdu_columns || !walk->ended ||
+      !walk->last_oid || !walk->last_oid_len) {
+    walk_columns_free(walk);
+    PyErr_NoMemory();
+    return -1;
+  }
+
+  walk->num_columns = num_columns;
+  for (i = 0; i < num_columns; i++) {
+    walk->last_oid[i] = NULL;
+  }
+
+  for (i = 0; i < num_columns; i++) {
+    walk->last_oid[i] = PyMem_New(oid, MAX_OID_LEN);
+    if (!walk->last_oid[i]) {
+      walk_columns_free(walk);
+      PyErr_NoMemory();
+      return -1;
+    }
+
+    memcpy(walk->last_oid[i], data->oid_arr[i],
+           data->oid_arr_len[i] * sizeof(oid));
+    walk->last_oid_len[i] = data->oid_arr_len[i];
+    walk->active[i] = i;
+  }
+  walk->num_active = num_columns;
+
+  return 0;
+}
+
+/* build the next request, carrying one varbind per active column */
+static netsnmp_pdu *walk_columns_next_pdu(walk_columns *walk) {
+  netsnmp_pdu *pdu = snmp_pdu_create(walk->command);
+  int max_columns = walk->max_columns;
+  int column;
+  int i;
+
+  if (walk->command == SNMP_MSG_GETBULK) {
+    pdu->non_repeaters = 0;
+    pdu->max_repetitions = walk->max_repetitions;
+  }
+
+  walk->num_pdu_columns = walk->num_active;
+  if (max_columns > 0 && walk->num_pdu_columns > max_columns) {
+    walk->num_pdu_columns = max_columns;
+  }
+
+  for (i = 0; i < walk->num_pdu_columns; i++) {
+    column = walk->active[i];
+    walk->pdu_columns[i] = column;
+    snmp_add_null_var(pdu, walk->last_oid[column],
+                      walk->last_oid_len[column]);
+  }
+
+  return pdu;
+}
+
+/*
+ * Consume a response to walk_columns_next_pdu().  Repeated varbinds are
+ * laid out row by row, so response variable k belongs to the column at
+ * pdu_columns[k % num_pdu_columns].
+ */
+static int walk_columns_read_response(walk_columns *walk, snmp_op_data *data,
+                                      netsnmp_pdu *response) {
+  netsnmp_variable_list *vars = NULL;
+  char *op_name = data->op_name;
+  int num_vars = 0;
+  int column;
+  int i;
+  int j;
+
+  for (i = 0; i < walk->num_pdu_columns; i++) {
+    walk->ended[walk->pdu_columns[i]] = 0;
+  }
+
+  for (vars = response ? response->variables : NULL; vars;
+       vars = vars->next_variable, num_vars++) {
+    column = walk->pdu_columns[num_vars % walk->num_pdu_columns];
+
+    if (walk->ended[column]) {
+      continue;
+    }
+
+    if (vars->type == SNMP_ENDOFMIBVIEW) {
+      py_log_msg(DEBUG, "%s: encountered end condition (ENDOFMIBVIEW) for "
+                        "%s", op_name, data->initial_oid_str_arr[column]);
+      walk->ended[column] = 1;
+      continue;
+    }
+
+    if ((vars->type == SNMP_NOSUCHOBJECT) ||
+        (vars->type == SNMP_NOSUCHINSTANCE)) {
+      walk->ended[column] = 1;
+    } else if ((vars->name_length < data->oid_arr_len[column]) ||
+               (memcmp(data->oid_arr[column], vars->name,
+                       data->oid_arr_len[column] * sizeof(oid)) != 0)) {
+      py_log_msg(DEBUG, "%s: encountered end condition (next subtree "
+                        "iteration out of scope) for %s",
+                 op_name, data->initial_oid_str_arr[column]);
+      walk->ended[column] = 1;
+      continue;
+    } else if (snmp_oid_compare(vars->name, vars->name_length,
+                                walk->last_oid[column],
+                                walk->last_oid_len[column]) <= 0) {
+      py_log_msg(ERROR, "%s: OID not increasing for %s, ending its walk",
+                 op_name, data->initial_oid_str_arr[column]);
+      walk->ended[column] = 1;
+      continue;
+    } else {
+      memcpy(walk->last_oid[column], vars->name,
+             vars->name_length * sizeof(oid));
+      walk->last_oid_len[column] = vars->name_length;
+    }
+
+    data->initial_oid = data->initial_oid_str_arr[column];
+    if (walk->emit(walk, data, column, vars) < 0) {
+      return -1;
+    }
+  }
+
+  /* an empty response would otherwise repeat the same request forever */
+  if (!num_vars) {
+    for (i = 0; i < walk->num_pdu_columns; i++) {
+      walk->ended[walk->pdu_columns[i]] = 1;
+    }
+  }
+
+  /* keep request order while dropping every column which has ended */
+  for (i = 0, j = 0; i < walk->num_active; i++) {
+    column = walk->active[i];
+    if (i < walk->num_pdu_columns && walk->ended[column]) {
+      continue;
+    }
+    walk->active[j++] = column;
+  }
+  walk->num_active = j;
+
+  return 0;
+}
+
+/*
+ * Perform a single request/response round trip of the walk.
+ *
+ * returns : STAT_SUCCESS, or the failing status with session_ctx errors
+ *           (and possibly a Python exception) set
+ */
+static int walk_columns_step(walk_columns *walk, snmp_op_data *data) {
+  int status;
+
+  struct timeval start;
+
+  data->pdu = walk_columns_next_pdu(walk);
+
+  py_log_msg(DEBUG, "%s: Sending pdu req with %d varbinds", data->op_name,
+             walk->num_pdu_columns);
+
+  netsnmp_get_monotonic_clock(&start);
+  status = send_pdu_request(walk->session_ctx, data, NULL);
+
+  if (walk->adaptive) {
+    /* nothing has been consumed, so the next step resends the request */
+    if (__adaptive_retry(walk->session_ctx, data, status,
+                         &walk->max_repetitions, &walk->timeout_retried)) {
+      return STAT_SUCCESS;
+    }
+
+    if ((status == STAT_SUCCESS) && !PyErr_Occurred()) {
+      __adapt_repetitions(walk->session_ctx, &walk->max_repetitions,
+                          data->response, walk->num_pdu_columns,
+                          __elapsed_usec(&start));
+    }
+  }
+  if ((status != STAT_SUCCESS) || PyErr_Occurred()) {
+    py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
+               data->op_name, status);
+    return (status == STAT_SUCCESS) ? STAT_ERROR : status;
+  }
+
+  if (walk_columns_read_response(walk, data, data->response) < 0) {
+    status = STAT_ERROR;
+  }
+
+  if (data->response) {
+    snmp_free_pdu(data->response);
+    data->response = NULL;
+  }
+
+  return status;
+}
+
+static int walk_columns_run(walk_columns *walk, snmp_op_data *data) {
+  int status = STAT_SUCCESS;
+
+  while (walk->num_active > 0 && status == STAT_SUCCESS) {
+    status = walk_columns_step(walk, data);
+  }
+
+  return status;
+}
+
+/* walk_emit_fn collecting SNMPVariables into one list per column */
+static int __emit_column_varbind(walk_columns *walk, snmp_op_data *data,
+                                 int column, netsnmp_variable_list *vars) {
+  PyObject **column_lists = walk->emit_arg;
+  PyObject *varbind = __build_response_varbind(vars, data, walk->session_ctx);
+  int ret;
+
+  if (!varbind) {
+    py_log_msg(ERROR, "%s bad varbind (%d)", data->op_name, column);
+    return PyErr_Occurred() ? -1 : 0;
+  }
+
+  ret = PyList_Append(column_lists[column], varbind);
+  Py_DECREF(varbind);
+  return ret;
+}
+
+/*
+ * Walk every subtree in data side by side with GETBULK requests, returning
+ * the results in the same order as walking each subtree in turn.  With
+ * adaptive set, max_repetitions only seeds the first request.
+ */
+static int bulkwalk_parallel(session_capsule_ctx *session_ctx,
+                             snmp_op_data *data, int max_repetitions,
+                             int adaptive, PyObject *result_varlist) {
+  walk_columns walk;
+  PyObject **column_lists = NULL;
+  int status = STAT_ERROR;
+  int i;
+
+  column_lists = PyMem_New(PyObject *, data->varlist_len);
+  if (!column_lists) {
+    PyErr_NoMemory();
+    return STAT_ERROR;
+  }
+
+  for (i = 0; i < data->varlist_len; i++) {
+    column_lists[i] = NULL;
+  }
+
+  for (i = 0; i < data->varlist_len; i++) {
+    if (!(column_lists[i] = PyList_New(0))) {
+      goto done;
+    }
+  }
+
+  if (walk_columns_init(&walk, data, session_ctx, SNMP_MSG_GETBULK,
+                        max_repetitions, __emit_column_varbind,
+                        column_lists) < 0) {
+    goto done;
+  }
+  walk.adaptive = adaptive;
+
+  status = walk_columns_run(&walk, data);
+  walk_columns_free(&walk);
+
+  if (status == STAT_SUCCESS) {
+    for (i = 0; i < data->varlist_len; i++) {
+      Py_ssize_t len = PyList_GET_SIZE(result_varlist);
+
+      if (PyList_SetSlice(result_varlist, len, len, column_lists[i]) < 0) {
+        status = STAT_ERROR;
+        break;
+      }
+    }
+  }
+
+done:
+
+  for (i = 0; i < data->varlist_len; i++) {
+    Py_XDECREF(column_lists[i]);
+  }
+  PyMem_Free(column_lists);
+
+  return status;
+}
+
+/*
+ * Sink for a table walk.  Rows are keyed by the instance index (the part
+ * of the OID past the column) and laid out in the order they are first
+ * seen; a column missing for a row holds None.
+ */
+typedef struct {
+  PyObject *index;     /* list of the index of each row */
+  PyObject *rows;      /* dict of index to row number */
+  PyObject **columns;  /* list of values of each column, aligned to index */
+  int num_columns;
+} walk_table;
+
+/* walk_emit_fn storing the values of a table walk into a walk_table */
+static int __emit_table_value(walk_columns *walk, snmp_op_data *data,
+                              int column, netsnmp_variable_list *vars) {
+  walk_table *table = walk->emit_arg;
+  session_capsule_ctx *session_ctx = walk->session_ctx;
+  PyObject *index = NULL;
+  PyObject *row = NULL;
+  PyObject *value = NULL;
+  struct tree *tp = NULL;
+  char *index_str = (char *)data->str_buf;
+  Py_ssize_t row_ind;
+  int i;
+
+  /* columns of a table hold no NOSUCH exceptions worth a row */
+  if ((vars->type == SNMP_NOSUCHOBJECT) ||
+      (vars->type == SNMP_NOSUCHINSTANCE)) {
+    return 0;
+  }
+
+  /* values printed by Net-SNMP itself may hold OIDs */
+  if (session_ctx->sprintval_flag == USE_SPRINT_VALUE) {
+    __use_output_format(session_ctx);
+  }
+
+  __sprint_num_objid(index_str, vars->name + data->oid_arr_len[column],
+                     vars->name_length - data->oid_arr_len[column]);
+  if (*index_str == '.') {
+    index_str++;
+  }
+
+  if (!(index = PyUnicode_FromString(index_str))) {
+    return -1;
+  }
+
+  row = PyDict_GetItem(table->rows, index);
+  if (row) {
+    row_ind = PyLong_AsSsize_t(row);
+  } else {
+    row_ind = PyList_GET_SIZE(table->index);
+
+    if (!(row = PyLong_FromSsize_t(row_ind)) ||
+        PyDict_SetItem(table->rows, index, row) < 0 ||
+        PyList_Append(table->index, index) < 0) {
+      Py_XDECREF(row);
+      Py_DECREF(index);
+      return -1;
+    }
+    Py_DECREF(row);
+
+    for (i = 0; i < table->num_columns; i++) {
+      if (PyList_Append(table->columns[i], Py_None) < 0) {
+        Py_DECREF(index);
+        return -1;
+      }
+    }
+  }
+  Py_DECREF(index);
+
+  if (session_ctx->sprintval_flag == USE_ENUMS) {
+    tp = get_tree(vars->name, vars->name_length, get_tree_head());
+  }
+
+  value = read_value(vars, data, tp, session_ctx->sprintval_flag,
+                     session_ctx->native_types, session_ctx->octet_bytes);
+  if (!value) {
+    return -1;
+  }
+
+  /* PyList_SetItem steals the reference to value */
+  return PyList_SetItem(table->columns[column], row_ind, value);
+}
+
+/*
+ * Walk the columns of a table side by side, with GETBULK requests from
+ * SNMPv2c onwards and GETNEXT requests for SNMPv1, into table.
+ */
+static int walk_table_run(session_capsule_ctx *session_ctx,
+                          snmp_op_data *data, int max_repetitions,
+                          walk_table *table) {
+  walk_columns walk;
+  int status;
+  int command = (session_ctx->snmp_version == 1) ? SNMP_MSG_GETNEXT
+                                                  : SNMP_MSG_GETBULK;
+
+  if (walk_columns_init(&walk, data, session_ctx, command, max_repetitions,
+                        __emit_table_value, table) < 0) {
+    return STAT_ERROR;
+  }
+
+  /* a v1 GETNEXT carries as many columns as a get_next() would */
+  if (command == SNMP_MSG_GETNEXT) {
+    walk.max_columns = session_ctx->max_varbinds;
+  }
+
+  status = walk_columns_run(&walk, data);
+  walk_columns_free(&walk);
+
+  return status;
+}
+
+/* formats of the records written by netsnmp_walk_export() */
+#define EXPORT_NDJSON 0
+#define EXPORT_MSGPACK 1
+
+/* the number of fields of every exported record */
+#define EXPORT_NUM_FIELDS 5
+
+/* a growing buffer of encoded records */
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t size;
+} export_buf;
+
+static int __export_reserve(export_buf *out, size_t len) {
+  size_t size = out->size ? out->size : 256;
+  char *buf = NULL;
+
+  if (out->len + len <= out->size) {
+    return 0;
+  }
+
+  while (size < out->len + len) {
+    size *= 2;
+  }
+
+  if (!(buf = PyMem_Realloc(out->buf, size))) {
+    PyErr_NoMemory();
+    return -1;
+  }
+
+  out->buf = buf;
+  out->size = size;
+  return 0;
+}
+
+static int __export_write(export_buf *out, const void *bytes, size_t len) {
+  if (__export_reserve(out, len) < 0) {
+    return -1;
+  }
+
+  memcpy(out->buf + out->len, bytes, len);
+  out->len += len;
+  return 0;
+}
+
+/* store val as a big endian integer of num_bytes bytes at p */
+static char *__export_put_be(char *p, size_t val, int num_bytes) {
+  int i;
+
+  for (i = num_bytes - 1; i >= 0; i--) {
+    p[i] = (char)(val & 0xff);
+    val >>= 8;
+  }
+
+  return p + num_bytes;
+}
+
+/*
+ * Write a JSON string holding str as latin-1 (as SNMPVariable fields are
+ * decoded), or null when str is NULL.
+ */
+static int __export_json_string(export_buf *out, const char *str,
+                                size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  char *p = NULL;
+  size_t i;
+
+  if (!str) {
+    return __export_write(out, "null", 4);
+  }
+
+  /* at worst every byte becomes a \u00XX escape */
+  if (__export_reserve(out, len * 6 + 2) < 0) {
+    return -1;
+  }
+
+  p = out->buf + out->len;
+  *p++ = '"';
+  for (i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)str[i];
+
+    if (c == '"' || c == '\\') {
+      *p++ = '\\';
+      *p++ = (char)c;
+    } else if (c < 0x20 || c >= 0x7f) {
+      *p++ = '\\';
+      *p++ = 'u';
+      *p++ = '0';
+      *p++ = '0';
+      *p++ = hex[c >> 4];
+      *p++ = hex[c & 0xf];
+    } else {
+      *p++ = (char)c;
+    }
+  }
+  *p++ = '"';
+
+  out->len = p - out->buf;
+  return 0;
+}
+
+/*
+ * Write a msgpack str holding str transcoded from latin-1 to UTF-8, a bin
+ * holding it as is when is_bin is set, or nil when str is NULL.
+ */
+static int __export_msgpack_string(export_buf *out, const char *str,
+                                   size_t len, int is_bin) {
+  size_t enc_len = len;
+  char *p = NULL;
+  size_t i;
+
+  if (!str) {
+    return __export_write(out, "\xc0", 1);
+  }
+
+  if (!is_bin) {
+    for (i = 0; i < len; i++) {
+      if ((unsigned char)str[i] >= 0x80) {
+        enc_len++;
+      }
+    }
+  }
+
+  if (__export_reserve(out, enc_len + 5) < 0) {
+    return -1;
+  }
+
+  p = out->buf + out->len;
+  if (is_bin) {
+    if (enc_len < 0x100) {
+      *p++ = (char)0xc4;
+      p = __export_put_be(p, enc_len, 1);
+    } else if (enc_len < 0x10000) {
+      *p++ = (char)0xc5;
+      p = __export_put_be(p, enc_len, 2);
+    } else {
+      *p++ = (char)0xc6;
+      p = __export_put_be(p, enc_len, 4);
+    }
+
+    memcpy(p, str, len);
+    p += len;
+  } else {
+    if (enc_len < 32) {
+      *p++ = (char)(0xa0 | enc_len);
+    } else if (enc_len < 0x100) {
+      *p++ = (char)0xd9;
+      p = __export_put_be(p, enc_len, 1);
+    } else if (enc_len < 0x10000) {
+      *p++ = (char)0xda;
+      p = __export_put_be(p, enc_len, 2);
+    } else {
+      *p++ = (char)0xdb;
+      p = __export_put_be(p, enc_len, 4);
+    }
+
+    for (i = 0; i < len; i++) {
+      unsigned char c = (unsigned char)str[i];
+
+      if (c >= 0x80) {
+        *p++ = (char)(0xc0 | (c >> 6));
+        *p++ = (char)(0x80 | (c & 0x3f));
+      } else {
+        *p++ = (char)c;
+      }
+    }
+  }
+
+  out->len = p - out->buf;
+  return 0;
+}
+
+/*
+ * Write one field of a record: a "name": value member of a JSON object, or
+ * a key and value of a msgpack map.  Octet strings (is_bin) are written
+ * as msgpack bin, and as latin-1 JSON strings.
+ */
+static int __export_field(export_buf *out, int format, int first,
+                          const char *name, const char *val, size_t len,
+                          int is_bin) {
+  if (format == EXPORT_MSGPACK) {
+    if (__export_msgpack_string(out, name, strlen(name), 0) < 0) {
+      return -1;
+    }
+    return __export_msgpack_string(out, val, len, is_bin);
+  }
+
+  if ((!first && __export_write(out, ",", 1) < 0) ||
+      __export_json_string(out, name, strlen(name)) < 0 ||
+      __export_write(out, ":", 1) < 0) {
+    return -1;
+  }
+  return __export_json_string(out, val, len);
+}
+
+/*
+ * Start a record: a JSON object, or a msgpack map behind a placeholder
+ * for its 4 byte big endian length, which __export_end() fills in.
+ */
+static int __export_begin(export_buf *out, int format) {
+  char header[5];
+
+  if (format == EXPORT_MSGPACK) {
+    memset(header, 0, 4);
+    header[4] = (char)(0x80 | EXPORT_NUM_FIELDS);
+    return __export_write(out, header, sizeof(header));
+  }
+
+  return __export_write(out, "{", 1);
+}
+
+static int __export_end(export_buf *out, int format, size_t start) {
+  if (format == EXPORT_MSGPACK) {
+    __export_put_be(out->buf + start, out->len - start - 4, 4);
+    return 0;
+  }
+
+  return __export_write(out, "}\n", 2);
+}
+
+/* the sink of a walk exporting its variables, one buffer per column */
+typedef struct {
+  export_buf *columns;
+  int format;
+} walk_export;
+
+/*
+ * walk_emit_fn encoding a variable into the buffer of its column, with
+ * the fields and values an SNMPVariable would hold had use_native_types
+ * and use_bytes not been set (octet strings are kept as bytes in msgpack)
+ */
+static int __emit_export_record(walk_columns *walk, snmp_op_data *data,
+                                int column, netsnmp_variable_list *vars) {
+  walk_export *export = walk->emit_arg;
+  session_capsule_ctx *session_ctx = walk->session_ctx;
+  export_buf *out = &export->columns[column];
+  int format = export->format;
+  char type_str[MAX_TYPE_NAME_LEN];
+  struct tree *tp = NULL;
+  char *label = data->initial_oid;
+  char *iid = NULL;
+  char *val = NULL;
+  size_t val_len = 0;
+  int is_bin = 0;
+  int nosuch = 0;
+  size_t start = out->len;
+
+  nosuch = (vars->type == SNMP_NOSUCHOBJECT) ||
+           (vars->type == SNMP_NOSUCHINSTANCE);
+
+  if (nosuch) {
+    __get_type_str(vars->type, type_str, 1);
+  } else {
+    session_ctx->stats.varbinds_decoded++;
+
+    /* values printed by Net-SNMP itself may hold OIDs too */
+    if (session_ctx->sprintval_flag == USE_SPRINT_VALUE) {
+      __use_output_format(session_ctx);
+    }
+
+    tp = __read_label(vars, data, session_ctx, &label, &iid);
+    __get_type_str(__translate_asn_type(vars->type), type_str, 1);
+
+    if (!label) {
+      label = "";
+    }
+    if (!iid) {
+      iid = "";
+    }
+  }
+
+  /* the label is written before the value is formatted over it */
+  if (__export_begin(out, format) < 0 ||
+      __export_field(out, format, 1, "oid", label, STRLEN(label), 0) < 0 ||
+      __export_field(out, format, 0, "oid_index", iid, STRLEN(iid), 0) < 0 ||
+      __export_field(out, format, 0, "snmp_type", type_str, strlen(type_str),
+                     0) < 0 ||
+      __export_field(out, format, 0, "root_oid", data->initial_oid,
+                     STRLEN(data->initial_oid), 0) < 0) {
+    return -1;
+  }
+
+  if (nosuch) {
+    val = NULL;
+  } else if ((vars->type == ASN_OCTET_STR || vars->type == ASN_OPAQUE) &&
+             session_ctx->sprintval_flag != USE_SPRINT_VALUE) {
+    /* straight from the response PDU, as for read_value() */
+    val = vars->val.string ? (char *)vars->val.string : "";
+    val_len = vars->val_len;
+    is_bin = 1;
+  } else {
+    val = (char *)data->str_buf;
+    val_len = __snprint_value(val, sizeof(data->str_buf), vars, tp,
+                              __translate_asn_type(vars->type),
+                              session_ctx->sprintval_flag);
+  }
+
+  if (__export_field(out, format, 0, "value", val, val_len, is_bin) < 0) {
+    return -1;
+  }
+
+  return __export_end(out, format, start);
+}
+
+/*
+ * Walk every subtree in data side by side, with GETBULK requests from
+ * SNMPv2c onwards and GETNEXT requests for SNMPv1, encoding the variables
+ * of each into export->columns[i] as they arrive.
+ */
+static int walk_export_run(session_capsule_ctx *session_ctx,
+                           snmp_op_data *data, int max_repetitions,
+                           walk_export *export) {
+  walk_columns walk;
+  int status;
+  int command = (session_ctx->snmp_version == 1) ? SNMP_MSG_GETNEXT
+                                                  : SNMP_MSG_GETBULK;
+
+  if (walk_columns_init(&walk, data, session_ctx, command, max_repetitions,
+                        __emit_export_record, export) < 0) {
+    return STAT_ERROR;
+  }
+
+  /* a v1 GETNEXT carries as many columns as a get_next() would */
+  if (command == SNMP_MSG_GETNEXT) {
+    walk.max_columns = session_ctx->max_varbinds;
+  }
+
+  status = walk_columns_run(&walk, data);
+  walk_columns_free(&walk);
+
+  return status;
+}
+
+static PyObject *netsnmp_create_session(PyObject *self, PyObject *args) {
+  int version;
+  char *community;
+  char *peer;
+  int lport;
+  int retries;
+  int timeout;
+  SnmpSession session = {0};
+
+  if (!PyArg_ParseTuple(args, "issiii", &version, &community, &peer, &lport,
+                        &retries, &timeout)) {
+    goto done;
+  }
+
+  snmp_sess_init(&session);
+
+  session.version = -1;
+#ifndef DISABLE_SNMPV1
+  if (version == 1) {
+    session.version = SNMP_VERSION_1;
+  }
+#endif
+#ifndef DISABLE_SNMPV2C
+  if (version == 2) {
+    session.version = SNMP_VERSION_2c;
+  }
+#endif
+  if (version == 3) {
+    session.version = SNMP_VERSION_3;
+  }
+  if (session.version == -1) {
+    PyErr_Format(PyExc_ValueError, "unsupported SNMP version (%d)", version);
+    goto done;
+  }
+
+  session.community_len = STRLEN((char *)community);
+  session.community = (u_char *)community;
+  session.peername = peer;
+  session.local_port = lport;
+  session.retries = retries; /* 5 */
+  session.timeout = timeout; /* 1000000L */
+  session.authenticator = NULL;
+
+  return create_session_capsule(&session);
+
+done:
+
+  return NULL;
+}
+
+static PyObject *netsnmp_create_session_v3(PyObject *self, PyObject *args) {
+  int version;
+  char *peer;
+  int lport;
+  int retries;
+  int timeout;
+  char *sec_name;
+  int sec_level;
+  char *sec_eng_id;
+  char *context_eng_id;
+  char *context;
+  char *auth_proto;
+  char *auth_pass;
+  char *priv_proto;
+  char *priv_pass;
+  int eng_boots;
+  int eng_time;
+  SnmpSession session = {0};
+  int md5_enabled = 1;
+  int des_enabled = 1;
+
+#ifndef DISABLE_MD5
+  md5_enabled = 0;
+#endif
+#ifndef DISABLE_DES
+  des_enabled = 0;
+#endif
+
+  if (!PyArg_ParseTuple(args, "isiiisisssssssii", &version, &peer, &lport,
+                        &retries, &timeout, &sec_name, &sec_level, &sec_eng_id,
+                        &context_eng_id, &context, &auth_proto, &auth_pass,
+                        &priv_proto, &priv_pass, &eng_boots, &eng_time)) {
+    return NULL;
+  }
+
+  snmp_sess_init(&session);
+
+  if (version == 3) {
+    session.version = SNMP_VERSION_3;
+  } else {
+    PyErr_Format(PyExc_ValueError, "unsupported SNMP version (%d)", version);
+    goto done;
+  }
+
+  session.peername = peer;
+  session.retries = retries; /* 5 */
+  session.timeout = timeout; /* 1000000L */
+  session.authenticator = NULL;
+  session.contextNameLen = STRLEN(context);
+  session.contextName = context;
+  session.securityNameLen = STRLEN(sec_name);
+  session.securityName = sec_name;
+  session.securityLevel = sec_level;
+  session.securityModel = USM_SEC_MODEL_NUMBER;
+  session.securityEngineIDLen =
+      hex_to_binary2((unsigned char *)sec_eng_id, STRLEN(sec_eng_id),
+                     (char **)&session.securityEngineID);
+  session.contextEngineIDLen =
+      hex_to_binary2((unsigned char *)context_eng_id, STRLEN(sec_eng_id),
+                     (char **)&session.contextEngineID);
+  session.engineBoots = eng_boots;
+  session.engineTime = eng_time;
+
+
+    if ((md5_enabled == 1) && !strcmp(auth_proto, "MD5")) {
+      session.securityAuthProto =
+          snmp_duplicate_objid(usmHMACMD5AuthProtocol, USM_AUTH_PROTO_MD5_LEN);
+      session.securityAuthProtoLen = USM_AUTH_PROTO_MD5_LEN;
+    } else if (!strcmp(auth_proto, "SHA")) {
+    session.securityAuthProto =
+        snmp_duplicate_objid(usmHMACSHA1AuthProtocol, USM_AUTH_PROTO_SHA_LEN);
+    session.securityAuthProtoLen = USM_AUTH_PROTO_SHA_LEN;
+  } else if (!strcmp(auth_proto, "DEFAULT")) {
+    const oid *a = get_default_authtype(&session.securityAuthProtoLen);
+    session.securityAuthProto =
+        snmp_duplicate_objid(a, session.securityAuthProtoLen);
+  } else {
+    PyErr_Format(PyExc_ValueError, "unsupported authentication protocol (%s)",
+                 auth_proto);
+    goto done;
+  }
+  if (session.securityLevel >= SNMP_SEC_LEVEL_AUTHNOPRIV) {
+    if (STRLEN(auth_pass) > 0) {
+      session.securityAuthKeyLen = USM_AUTH_KU_LEN;
+      if (generate_Ku(session.securityAuthProto, session.securityAuthProtoLen,
+                      (u_char *)auth_pass, STRLEN(auth_pass),
+                      session.securityAuthKey,
+                      &session.securityAuthKeyLen) != SNMPERR_SUCCESS) {
+        PyErr_SetString(EasySNMPConnectionError,
+                        "error generating Ku from authentication "
+                        "password");
+        goto done;
+      }
+    }
+  }
+  if ((des_enabled == 1) && !strcmp(priv_proto, "DES")) {
+    session.securityPrivProto =
+        snmp_duplicate_objid(usmDESPrivProtocol, USM_PRIV_PROTO_DES_LEN);
+    session.securityPrivProtoLen = USM_PRIV_PROTO_DES_LEN;
+  } else if (!strncmp(priv_proto, "AES", 3)) {
+    session.securityPrivProto =
+        snmp_duplicate_objid(usmAESPrivProtocol, USM_PRIV_PROTO_AES_LEN);
+    session.securityPrivProtoLen = USM_PRIV_PROTO_AES_LEN;
+  } else if (!strcmp(priv_proto, "DEFAULT")) {
+    const oid *p = get_default_privtype(&session.securityPrivProtoLen);
+    session.securityPrivProto =
+        snmp_duplicate_objid(p, session.securityPrivProtoLen);
+  } else {
+    PyErr_Format(PyExc_ValueError, "unsupported privacy protocol (%s)",
+                 priv_proto);
+    goto done;
+  }
+
+  if (session.securityLevel >= SNMP_SEC_LEVEL_AUTHPRIV) {
+    session.securityPrivKeyLen = USM_PRIV_KU_LEN;
+    if (generate_Ku(session.securityAuthProto, session.securityAuthProtoLen,
+                    (u_char *)priv_pass, STRLEN(priv_pass),
+                    session.securityPrivKey,
+                    &session.securityPrivKeyLen) != SNMPERR_SUCCESS) {
+      PyErr_SetString(EasySNMPConnectionError,
+                      "couldn't gen Ku from priv pass phrase");
+      goto done;
+    }
+  }
+
+  return create_session_capsule(&session);
+
+done:
+
+  SAFE_FREE(session.securityEngineID);
+  SAFE_FREE(session.contextEngineID);
+
+  return NULL;
+}
+
+static PyObject *netsnmp_create_session_tunneled(PyObject *self,
+                                                 PyObject *args) {
+  int version;
+  char *peer;
+  int lport;
+  int retries;
+  int timeout;
+  char *sec_name;
+  int sec_level;
+  char *context_eng_id;
+  char *context;
+  char *our_identity;
+  char *their_identity;
+  char *their_hostname;
+  char *trust_cert;
+  SnmpSession session = {0};
+
+  if (!PyArg_ParseTuple(args, "isiiisissssss", &version, &peer, &lport,
+                        &retries, &timeout, &sec_name, &sec_level,
+                        &context_eng_id, &context, &our_identity,
+                        &their_identity, &their_hostname, &trust_cert)) {
+    return NULL;
+  }
+
+  if (version != 3) {
+    PyErr_SetString(PyExc_ValueError,
+                    "you must use SNMP version 3 as it's the only "
+                    "version that supports tunneling");
+    return NULL;
+  }
+
+  snmp_sess_init(&session);
+
+  session.peername = peer;
+  session.retries = retries; /* 5 */
+  session.timeout = timeout; /* 1000000L */
+  session.contextNameLen = STRLEN(context);
+  session.contextName = context;
+  session.securityNameLen = STRLEN(sec_name);
+  session.securityName = sec_name;
+  session.securityLevel = sec_level;
+  session.securityModel = NETSNMP_TSM_SECURITY_MODEL;
+
+  /* create the transport configuration store */
+  if (!session.transport_configuration) {
+    netsnmp_container_init_list();
+    session.transport_configuration =
+        netsnmp_container_find("transport_configuration:fifo");
+    if (!session.transport_configuration) {
+      py_log_msg(ERROR, "failed to initialize the transport "
+                        "configuration container");
+      goto done;
+    }
+
+    session.transport_configuration->compare =
+        (netsnmp_container_compare *)netsnmp_transport_config_compare;
+  }
+
+  if (our_identity && our_identity[0] != '\0')
+    CONTAINER_INSERT(
+        session.transport_configuration,
+        netsnmp_transport_create_config("localCert", our_identity));
+
+  if (their_identity && their_identity[0] != '\0')
+    CONTAINER_INSERT(
+        session.transport_configuration,
+        netsnmp_transport_create_config("peerCert", their_identity));
+
+  if (their_hostname && their_hostname[0] != '\0')
+    CONTAINER_INSERT(
+        session.transport_configuration,
+        netsnmp_transport_create_config("their_hostname", their_hostname));
+
+  if (trust_cert && trust_cert[0] != '\0')
+    CONTAINER_INSERT(session.transport_configuration,
+                     netsnmp_transport_create_config("trust_cert", trust_cert));
+
+  return create_session_capsule(&session);
+
+done:
+
+  return NULL;
+}
+
+/*
+ * Reload the cached options of a session after one of them has changed.
+ */
+static PyObject *netsnmp_update_session(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *ctx = NULL;
+
+  if (!PyArg_ParseTuple(args, "O", &session)) {
+    return NULL;
+  }
+
+  if (!(ctx = __session_capsule_ctx(session))) {
+    return NULL;
+  }
+
+  if (__load_session_options(ctx, session) < 0) {
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+/*
+ * Load a MIB module by name (or a MIB file at the path given), adding it
+ * to those already loaded.  With EASYSNMP_MIBS=lazy, loading modules this
+ * way before MIBs are first needed means that only those modules are ever
+ * loaded.
+ */
+static PyObject *netsnmp_load_mib(PyObject *self, PyObject *args) {
+  char *name = NULL;
+
+  if (!PyArg_ParseTuple(args, "s", &name)) {
+    return NULL;
+  }
+
+  if (mib_load_mode == MIBS_LOAD_NONE) {
+    PyErr_SetString(EasySNMPError,
+                    "MIBs cannot be loaded with EASYSNMP_MIBS=numeric");
+    return NULL;
+  }
+
+  pthread_rwlock_wrlock(&mib_tree_lock);
+  if (strchr(name, '/')) {
+    if (!read_mib(name)) {
+      pthread_rwlock_unlock(&mib_tree_lock);
+      PyErr_Format(EasySNMPError, "could not read MIB file (%s)", name);
+      return NULL;
+    }
+  } else {
+    if (which_module(name) < 0) {
+      pthread_rwlock_unlock(&mib_tree_lock);
+      PyErr_Format(EasySNMPError, "unknown MIB module (%s)", name);
+      return NULL;
+    }
+    netsnmp_read_module(name);
+  }
+  pthread_rwlock_unlock(&mib_tree_lock);
+  py_log_msg(DEBUG, "load_mib: loaded %s", name);
+
+  mibs_loaded = 1;
+  __oid_cache_clear();
+
+  Py_RETURN_NONE;
+}
+
+/*
+ * Look up again whether the easysnmp.interface logger has DEBUG enabled,
+ * after its level (or that of its parents) was changed.
+ */
+static PyObject *netsnmp_refresh_log_level(PyObject *self, PyObject *args) {
+  __py_log_refresh_level();
+
+  Py_RETURN_NONE;
+}
+
+/*
+ * Forget every cached OID translation, e.g. after loading further MIBs.
+ */
+static PyObject *netsnmp_clear_oid_cache(PyObject *self, PyObject *args) {
+  __oid_cache_clear();
+
+  Py_RETURN_NONE;
+}
+
+/*
+ * Return the statistics of a session as a dict, resetting them afterwards
+ * if reset is true.
+ */
+static PyObject *netsnmp_session_stats(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  PyObject *stats = NULL;
+  PyObject *histogram = NULL;
+  PyObject *bucket = NULL;
+  session_capsule_ctx *ctx = NULL;
+  session_stats *s = NULL;
+  int reset = 0;
+  size_t i;
+
+  if (!PyArg_ParseTuple(args, "O|i", &session, &reset)) {
+    return NULL;
+  }
+
+  if (!(ctx = get_session_context(session))) {
+    return NULL;
+  }
+  s = &ctx->stats;
+
+  if (!(histogram = PyList_New(SESSION_RTT_BUCKETS))) {
+    return NULL;
+  }
+  for (i = 0; i < SESSION_RTT_BUCKETS; i++) {
+    /* (upper bound in seconds or None, count) */
+    if (i < SESSION_RTT_BUCKETS - 1) {
+      bucket = Py_BuildValue("(dK)", session_rtt_bounds[i] / 1000.0,
+                             s->rtt_histogram[i]);
+    } else {
+      bucket = Py_BuildValue("(OK)", Py_None, s->rtt_histogram[i]);
+    }
+    if (!bucket) {
+      Py_DECREF(histogram);
+      return NULL;
+    }
+    PyList_SET_ITEM(histogram, i, bucket);
+  }
+
+  stats = Py_BuildValue(
+      "{sKsKsKsKsKsKsKsdsN}", "pdus_sent", s->pdus_sent, "responses",
+      s->responses, "retries", s->retries, "timeouts", s->timeouts,
+      "nosuch_retries", s->nosuch_retries, "varbinds_decoded",
+      s->varbinds_decoded, "bytes_received", s->bytes_received, "rtt_total",
+      s->rtt_total, "rtt_histogram", histogram);
+
+  if (stats && reset) {
+    memset(s, 0, sizeof(*s));
+  }
+
+  return stats;
+}
+
+static void prepared_varlist_dealloc(prepared_varlist *prepared) {
+  int i;
+
+  for (i = 0; i < prepared->varlist_len; i++) {
+    if (prepared->oid_arr) {
+      PyMem_Free(prepared->oid_arr[i]);
+    }
+    if (prepared->oid_str_arr) {
+      PyMem_Free(prepared->oid_str_arr[i]);
+    }
+    if (prepared->oid_idx_str_arr) {
+      PyMem_Free(prepared->oid_idx_str_arr[i]);
+    }
+  }
+  PyMem_Free(prepared->oid_arr);
+  PyMem_Free(prepared->oid_arr_len);
+  PyMem_Free(prepared->oid_str_arr);
+  PyMem_Free(prepared->oid_idx_str_arr);
+
+  Py_XDECREF(prepared->varlist);
+  PyObject_Del(prepared);
+}
+
+static Py_ssize_t prepared_varlist_length(prepared_varlist *prepared) {
+  return prepared->varlist_len;
+}
+
+static PySequenceMethods prepared_varlist_as_sequence = {
+    (lenfunc)prepared_varlist_length, /* sq_length */
+};
+
+static PyTypeObject prepared_varlist_type = {
+    PyVarObject_HEAD_INIT(NULL, 0) "easysnmp.interface.PreparedVarlist",
+    sizeof(prepared_varlist),                 /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)prepared_varlist_dealloc,     /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &prepared_varlist_as_sequence,            /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    "varlist with its OIDs translated ahead of time", /* tp_doc */
+};
+
+/* copy a string into memory owned by a prepared_varlist */
+static char *__prepared_strdup(char *str) {
+  char *copy = NULL;
+  size_t len = STRLEN(str);
+
+  if ((copy = PyMem_New(char, len + 1))) {
+    if (len) {
+      memcpy(copy, str, len);
+    }
+    copy[len] = '\0';
+  }
+
+  return copy;
+}
+
+/*
+ * Parse and translate the OIDs of a varlist once, returning a
+ * PreparedVarlist which can be passed to any operation in place of the
+ * varlist.  Translation uses the best_guess option of the session at the
+ * time of the call.
+ */
+static PyObject *netsnmp_prepare(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  PyObject *varlist = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  prepared_varlist *prepared = NULL;
+  snmp_op_data op_data;
+  char *op_name = "netsnmp_prepare";
+  int len;
+  int i;
+
+  snmp_op_data_reset(&op_data);
+
+  if (!PyArg_ParseTuple(args, "OO", &session, &varlist)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    return NULL;
+  }
+
+  if (!PyList_Check(varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    return NULL;
+  }
+
+  if (!(session_ctx = get_session_context(session))) {
+    return NULL;
+  }
+
+  op_data.varlist = varlist;
+  op_data.op_name = op_name;
+  if (snmp_op_data_load(&op_data, session_ctx->best_guess) ||
+      PyErr_Occurred()) {
+    if (!PyErr_Occurred()) {
+      PyErr_SetString(EasySNMPError, "could not load the varlist");
+    }
+    snmp_op_data_finish(&op_data);
+    return NULL;
+  }
+
+  if (!(prepared = PyObject_New(prepared_varlist, &prepared_varlist_type))) {
+    snmp_op_data_finish(&op_data);
+    return NULL;
+  }
+
+  /* take over the translated OIDs, the strings are copied below */
+  len = op_data.varlist_len;
+  Py_INCREF(varlist);
+  prepared->varlist = varlist;
+  prepared->varlist_len = len;
+  prepared->oid_arr = op_data.oid_arr;
+  prepared->oid_arr_len = op_data.oid_arr_len;
+  prepared->oid_str_arr = PyMem_New(char *, len);
+  prepared->oid_idx_str_arr = PyMem_New(char *, len);
+  op_data.oid_arr = NULL;
+  op_data.oid_arr_len = NULL;
+  op_data.varlist_len = 0;
+
+  if (prepared->oid_str_arr) {
+    memset(prepared->oid_str_arr, 0, len * sizeof(char *));
+  }
+  if (prepared->oid_idx_str_arr) {
+    memset(prepared->oid_idx_str_arr, 0, len * sizeof(char *));
+  }
+
+  for (i = 0; prepared->oid_str_arr && prepared->oid_idx_str_arr && i < len;
+       i++) {
+    if (!(prepared->oid_str_arr[i] =
+              __prepared_strdup(op_data.oid_str_arr[i])) ||
+        !(prepared->oid_idx_str_arr[i] =
+              __prepared_strdup(op_data.oid_idx_str_arr[i]))) {
+      break;
+    }
+  }
+  snmp_op_data_finish(&op_data);
+
+  if (i < len || !prepared->oid_str_arr || !prepared->oid_idx_str_arr) {
+    Py_DECREF(prepared);
+    return PyErr_NoMemory();
+  }
+
+  py_log_msg(DEBUG, "%s: Prepared %d OIDs", op_name, len);
+
+  return (PyObject *)prepared;
+}
+
+static PyObject *netsnmp_get(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  PyObject *result_varlist = NULL;
+  int status = 0;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_get";
+
+  snmp_op_data_reset(&op_data);
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!args) {
+    const char *err_msg = "%s: missing arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  if (!PyArg_ParseTuple(args, "OO", &session, &op_data.varlist)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Getting session context", op_name);
+  session_ctx = get_session_context(session);
+
+  if (!session_ctx) {
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Got session context", op_name);
+
+  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if(PyErr_Occurred()) {
+      goto exception;
+    }
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+
+  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+
+  result_varlist = PyList_New(0);
+  status = send_packed_requests(session_ctx, &op_data, SNMP_MSG_GET,
+                                result_varlist);
+
+  if (status != STAT_SUCCESS) {
+    if (PyErr_Occurred()) {
+      Py_DECREF(result_varlist);
+      goto exception;
+    }
+
+    error = 1;
+  }
+  goto done;
+
+exception:
+  snmp_op_data_finish(&op_data);
+  return NULL;
+
+done:
+  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+
+  snmp_op_data_finish(&op_data);
+
+  if(error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+      session_ctx->err_num, session_ctx->err_ind);
+
+    Py_XDECREF(result_varlist);
+    return NULL;
+  }
+
+  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+
+  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+
+  return Py_BuildValue("N", result_varlist);
+}
+
+static PyObject *netsnmp_getnext(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  PyObject *result_varlist = NULL;
+  int status = 0;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_getnext";
+  snmp_op_data_reset(&op_data);
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!args) {
+    const char *err_msg = "%s: missing arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  if (!PyArg_ParseTuple(args, "OO", &session, &op_data.varlist)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Getting session context", op_name);
+  session_ctx = get_session_context(session);
+
+  if (!session_ctx) {
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Got session context", op_name);
+
+  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if(PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+
+  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+
+  result_varlist = PyList_New(0);
+  status = send_packed_requests(session_ctx, &op_data, SNMP_MSG_GETNEXT,
+                                result_varlist);
+
+  if (status != STAT_SUCCESS) {
+    if (PyErr_Occurred()) {
+      Py_DECREF(result_varlist);
+      goto exception;
+    }
+
+    error = 1;
+  }
+  goto done;
+
+exception:
+  snmp_op_data_finish(&op_data);
+  return NULL;
+
+done:
+  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+
+  snmp_op_data_finish(&op_data);
+
+  if(error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+      session_ctx->err_num, session_ctx->err_ind);
+
+    Py_XDECREF(result_varlist);
+    return NULL;
+  }
+
+  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+
+  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+
+  return Py_BuildValue("N", result_varlist);
+}
+
+static PyObject *netsnmp_walk(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  PyObject *result_varlist = NULL;
+  netsnmp_variable_list *vars = NULL;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_walk";
+  snmp_op_data_reset(&op_data);
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!args) {
+    const char *err_msg = "%s: missing arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  if (!PyArg_ParseTuple(args, "OO", &session, &op_data.varlist)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Getting session context", op_name);
+  session_ctx = get_session_context(session);
+
+  if (!session_ctx) {
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Got session context", op_name);
+
+  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if(PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+
+  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+
+  result_varlist = PyList_New(0);
+  PyObject * varbind = NULL;
+  int notdone = 0;
+  int status = 0;
+  int varlist_ind = 0;
+  int varlist_len = op_data.varlist_len;
+
+  while (varlist_ind < varlist_len) {
+    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
+    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+
+    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
+                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
+                op_data.op_name,
+                op_data.oid_str_arr[varlist_ind],
+                op_data.oid_idx_str_arr[varlist_ind],
+                op_data.oid_arr_len[varlist_ind],
+                session_ctx->best_guess);
+
+    notdone = 1;
+    while (notdone) {
+      py_log_msg(DEBUG, "%s: Sending pdu req",
+        op_data.op_name);
+
+      status = send_pdu_request(session_ctx, &op_data, NULL);
+      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+
+        if(PyErr_Occurred()) {
+          goto exception;
+        }
+
+        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
+          op_data.op_name, status);
+        error = 1;
+        goto done;
+      }
+
+      if (notdone) {
+        vars = op_data.response->variables;
+        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+
+        while (vars) {
+
+          if (vars->type == SNMP_ENDOFMIBVIEW) {
+            py_log_msg(DEBUG, "%s: encountered end condition "
+                              "(ENDOFMIBVIEW)", op_name);
+            notdone = 0;
+            break;
+          }
+          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
+          (vars->type == SNMP_NOSUCHINSTANCE)) {
+            char val_type_str[MAX_TYPE_NAME_LEN];
+
+            __get_type_str(vars->type, val_type_str, 1);
+            varbind = py_netsnmp_construct_varbind();
+
+            py_netsnmp_varbind_set_string(varbind, VARBIND_ROOT_F, op_data.initial_oid, STRLEN(op_data.initial_oid));
+            py_netsnmp_varbind_set_string(varbind, VARBIND_TAG_F, op_data.initial_oid, STRLEN(op_data.initial_oid));
+            py_netsnmp_varbind_set_string(varbind, VARBIND_TYPE_F, val_type_str,
+                                          strlen(val_type_str));
+
+            PyList_Append(result_varlist, varbind);
+            Py_DECREF(varbind);
+
+            notdone = 0;
+            break;
+          }
+          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
+              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
+                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
+            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
+              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
+              sizeof(op_data.oid_arr[varlist_ind]),
+              sizeof(vars->name)
+            );
+            notdone = 0;
+            break;
+          }
+
+          varbind = read_variable(vars, &op_data, session_ctx);
+
+          if (varbind) {
+            PyList_Append(result_varlist, varbind);
+            Py_DECREF(varbind);
+          } else {
+            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
+          }
+
+          // Create next request if we've reached the end
+          if (vars->next_variable == NULL) {
+            op_data.pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
+            snmp_add_null_var(op_data.pdu, vars->name, vars->name_length);
+            py_log_msg(DEBUG,
+              "%s: Creating pdu request for %s",
+              op_name, op_data.initial_oid
+            );
+          }
+
+          // Move on to next
+          vars = vars->next_variable;
+        }
+
+        py_log_msg(DEBUG,
+          "%s: Partially finished reading all variables from request for %s",
+          op_name, op_data.initial_oid
+        );
+      }
+
+      if (op_data.response) {
+        snmp_free_pdu(op_data.response);
+        op_data.response = NULL;
+        py_log_msg(DEBUG,
+          "%s: Finished reading all variables from request for %s",
+          op_name, op_data.initial_oid
+        );
+      }
+    }
+    varlist_ind++;
+  }
+
+  py_log_msg(DEBUG, "%s: Finished reading all variables",op_name);
+  goto done;
+
+exception:
+  snmp_op_data_finish(&op_data);
+  return NULL;
+
+done:
+  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+
+  snmp_op_data_finish(&op_data);
+
+  if(error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+      session_ctx->err_num, session_ctx->err_ind);
+
+    Py_XDECREF(result_varlist);
+    return NULL;
+  }
+
+  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+
+  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+
+  return Py_BuildValue("N", result_varlist);
+}
+
+static PyObject *netsnmp_getbulk(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  PyObject *result_varlist = NULL;
+  netsnmp_variable_list *vars = NULL;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_getbulk";
+  int nonrepeaters;
+  int maxrepetitions;
+
+  snmp_op_data_reset(&op_data);
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!args) {
+    const char *err_msg = "%s: missing arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  if (!PyArg_ParseTuple(args, "OOii", &session, &op_data.varlist, &nonrepeaters,
+                        &maxrepetitions)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Getting session context", op_name);
+  session_ctx = get_session_context(session);
+
+  if (!session_ctx) {
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Got session context", op_name);
+
+  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if(PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+
+  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+
+  result_varlist = PyList_New(0);
+  PyObject * varbind = NULL;
+  int notdone = 0;
+  int status = 0;
+  int varlist_ind = 0;
+  int varlist_len = op_data.varlist_len;
+
+  while (varlist_ind < varlist_len) {
+    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+    op_data.pdu->non_repeaters = nonrepeaters;
+    op_data.pdu->max_repetitions = maxrepetitions;
+    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+
+    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
+                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
+                op_data.op_name,
+                op_data.oid_str_arr[varlist_ind],
+                op_data.oid_idx_str_arr[varlist_ind],
+                op_data.oid_arr_len[varlist_ind],
+                session_ctx->best_guess);
+
+    notdone = 1;
+    while (notdone) {
+      py_log_msg(DEBUG, "%s: Sending pdu req",
+        op_data.op_name);
+
+      status = send_pdu_request(session_ctx, &op_data, NULL);
+      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+
+        if(PyErr_Occurred()) {
+          goto exception;
+        }
+
+        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
+          op_data.op_name, status);
+        error = 1;
+        goto done;
+      }
+
+      if (notdone) {
+        vars = op_data.response->variables;
+        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+
+        while (vars) {
+
+          if (vars->type == SNMP_ENDOFMIBVIEW) {
+            py_log_msg(DEBUG, "%s: encountered end condition "
+                              "(ENDOFMIBVIEW)", op_name);
+            notdone = 0;
+            break;
+          }
+          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
+          (vars->type == SNMP_NOSUCHINSTANCE)) {
+            char val_type_str[MAX_TYPE_NAME_LEN];
+
+            __get_type_str(vars->type, val_type_str, 1);
+            varbind = py_netsnmp_construct_varbind();
+
+            py_netsnmp_varbind_set_string(varbind, VARBIND_ROOT_F, op_data.initial_oid, STRLEN(op_data.initial_oid));
+            py_netsnmp_varbind_set_string(varbind, VARBIND_TAG_F, op_data.initial_oid, STRLEN(op_data.initial_oid));
+            py_netsnmp_varbind_set_string(varbind, VARBIND_TYPE_F, val_type_str,
+                                          strlen(val_type_str));
+
+            PyList_Append(result_varlist, varbind);
+            Py_DECREF(varbind);
+
+            notdone = 0;
+            break;
+          }
+          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
+              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
+                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
+            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
+              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
+              sizeof(op_data.oid_arr[varlist_ind]),
+              sizeof(vars->name)
+            );
+            notdone = 0;
+            break;
+          }
+
+          varbind = read_variable(vars, &op_data, session_ctx);
+
+          if (varbind) {
+            PyList_Append(result_varlist, varbind);
+            Py_DECREF(varbind);
+          } else {
+            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
+          }
+
+          // Move on to next
+          vars = vars->next_variable;
+        }
+
+        py_log_msg(DEBUG,
+          "%s: Partially finished reading all variables from request for %s",
+          op_name, op_data.initial_oid
+        );
+      }
+
+      if (op_data.response) {
+        snmp_free_pdu(op_data.response);
+        op_data.response = NULL;
+        py_log_msg(DEBUG,
+          "%s: Finished reading all variables from request for %s",
+          op_name, op_data.initial_oid
+        );
+        notdone = 0;
+      }
+    }
+    varlist_ind++;
+  }
+
+  py_log_msg(DEBUG, "%s: Finished reading all variables",op_name);
+  goto done;
+
+exception:
+  snmp_op_data_finish(&op_data);
+  return NULL;
+
+done:
+  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+
+  snmp_op_data_finish(&op_data);
+
+  if(error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+      session_ctx->err_num, session_ctx->err_ind);
+
+    Py_XDECREF(result_varlist);
+    return NULL;
+  }
+
+  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+
+  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+
+  return Py_BuildValue("N", result_varlist);
+}
+
+/*
+ * Fetch scalars and the first rows of table columns in a single GETBULK
+ * request: the first non_repeaters OIDs of the varlist are sent as
+ * non-repeaters (each giving the one variable after it, as for GETNEXT)
+ * and the rest as repeaters, up to max_repetitions rows of each.  The
+ * response is split back into a list of scalars and a list of rows for
+ * each column; a column's rows end where its walk would have, and any
+ * further rows are left to be fetched by the caller.
+ */
+static PyObject *netsnmp_getbulk_columns(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  PyObject *scalars = NULL;
+  PyObject *columns = NULL;
+  PyObject *varbind = NULL;
+  PyObject *result = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  netsnmp_variable_list *vars = NULL;
+  snmp_op_data op_data;
+  int *ended = NULL;
+  int nonrepeaters;
+  int maxrepetitions;
+  int num_columns;
+  int status;
+  int column;
+  int i;
+
+  snmp_op_data_reset(&op_data);
+
+  if (!PyArg_ParseTuple(args, "OOii", &session, &op_data.varlist,
+                        &nonrepeaters, &maxrepetitions)) {
+    return NULL;
+  }
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    PyErr_SetString(PyExc_ValueError,
+                    "getbulk_columns: varlist is not a list");
+    return NULL;
+  }
+
+  if (!(session_ctx = get_session_context(session))) {
+    return NULL;
+  }
+
+  op_data.op_name = "getbulk_columns";
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  if (snmp_op_data_load(&op_data, session_ctx->best_guess) ||
+      PyErr_Occurred()) {
+    goto done;
+  }
+
+  if (nonrepeaters < 0 || nonrepeaters > op_data.varlist_len) {
+    PyErr_SetString(PyExc_ValueError,
+                    "getbulk_columns: non_repeaters out of range");
+    goto done;
+  }
+  num_columns = op_data.varlist_len - nonrepeaters;
+
+  if (!(scalars = PyList_New(0)) || !(columns = PyList_New(num_columns))) {
+    goto done;
+  }
+  for (column = 0; column < num_columns; column++) {
+    PyObject *rows = PyList_New(0);
+
+    if (!rows) {
+      goto done;
+    }
+    PyList_SET_ITEM(columns, column, rows);
+  }
+
+  if (!(ended = PyMem_New(int, num_columns + 1))) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  memset(ended, 0, (num_columns + 1) * sizeof(int));
+
+  op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+  op_data.pdu->non_repeaters = nonrepeaters;
+  op_data.pdu->max_repetitions = num_columns ? maxrepetitions : 0;
+  for (i = 0; i < op_data.varlist_len; i++) {
+    snmp_add_null_var(op_data.pdu, op_data.oid_arr[i], op_data.oid_arr_len[i]);
+  }
+
+  py_log_msg(DEBUG, "%s: %d scalars and %d columns of up to %d rows",
+             op_data.op_name, nonrepeaters, num_columns, maxrepetitions);
+
+  status = send_pdu_request(session_ctx, &op_data, NULL);
+  if (status != STAT_SUCCESS || PyErr_Occurred()) {
+    if (!PyErr_Occurred()) {
+      PyErr_SetString(EasySNMPError, session_ctx->err_str[0]
+                                         ? session_ctx->err_str
+                                         : "getbulk_columns: request failed");
+    }
+    goto done;
+  }
+
+  for (vars = op_data.response->variables, i = 0; vars;
+       vars = vars->next_variable, i++) {
+    if (i < nonrepeaters) {
+      /*
+       * every scalar gets its place in the result, an ENDOFMIBVIEW one
+       * included, so that they line up with those requested
+       */
+      op_data.initial_oid = op_data.initial_oid_str_arr[i];
+      varbind = __build_response_varbind(vars, &op_data, session_ctx);
+      if (!varbind || PyList_Append(scalars, varbind) < 0) {
+        Py_XDECREF(varbind);
+        goto done;
+      }
+      Py_DECREF(varbind);
+      continue;
+    }
+
+    if (!num_columns) {
+      break;
+    }
+
+    /* the repeaters come round robin, one row of every column at a time */
+    column = (i - nonrepeaters) % num_columns;
+    if (ended[column]) {
+      continue;
+    }
+
+    op_data.initial_oid = op_data.initial_oid_str_arr[nonrepeaters + column];
+    if (vars->type == SNMP_ENDOFMIBVIEW ||
+        vars->type == SNMP_NOSUCHOBJECT ||
+        vars->type == SNMP_NOSUCHINSTANCE ||
+        vars->name_length < op_data.oid_arr_len[nonrepeaters + column] ||
+        memcmp(op_data.oid_arr[nonrepeaters + column], vars->name,
+               op_data.oid_arr_len[nonrepeaters + column] * sizeof(oid)) !=
+            0) {
+      ended[column] = 1;
+      continue;
+    }
+
+    varbind = read_variable(vars, &op_data, session_ctx);
+    if (!varbind ||
+        PyList_Append(PyList_GET_ITEM(columns, column), varbind) < 0) {
+      Py_XDECREF(varbind);
+      goto done;
+    }
+    Py_DECREF(varbind);
+  }
+
+  /* a response cut short still gives a (NULL) value for every scalar */
+  for (i = (int)PyList_GET_SIZE(scalars); i < nonrepeaters; i++) {
+    __append_elided_var(&op_data, i, scalars);
+  }
+  if (PyErr_Occurred()) {
+    goto done;
+  }
+
+  result = Py_BuildValue("OO", scalars, columns);
+
+done:
+  if (session_ctx) {
+    PyObject *type, *value, *traceback;
+
+    /* keep any exception raised while noting the session's errors */
+    PyErr_Fetch(&type, &value, &traceback);
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+                                       session_ctx->err_num,
+                                       session_ctx->err_ind);
+    PyErr_Restore(type, value, traceback);
+  }
+  PyMem_Free(ended);
+  Py_XDECREF(scalars);
+  Py_XDECREF(columns);
+  snmp_op_data_finish(&op_data);
+
+  return result;
+}
+
+static PyObject *netsnmp_bulkwalk(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  PyObject *result_varlist = NULL;
+  netsnmp_variable_list *vars = NULL;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_bulkwalk";
+  int nonrepeaters;
+  int maxrepetitions;
+  int parallel = 0;
+  int adaptive = 0;
+  int timeout_retried = 0;
+  netsnmp_pdu *retry_pdu = NULL;
+  struct timeval start;
+
+  snmp_op_data_reset(&op_data);
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!args) {
+    const char *err_msg = "%s: missing arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto done;
+  }
+
+  if (!PyArg_ParseTuple(args, "OOii|ii", &session, &op_data.varlist,
+                        &nonrepeaters, &maxrepetitions, &parallel,
+                        &adaptive)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    error = 1;
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Getting session context", op_name);
+  session_ctx = get_session_context(session);
+
+  if (!session_ctx) {
+    error = 1;
+    goto exception;
+  }
+  py_log_msg(DEBUG, "%s: Got session context", op_name);
+
+  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if(PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+
+  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+
+  result_varlist = PyList_New(0);
+  PyObject * varbind = NULL;
+  int notdone = 0;
+  int status = 0;
+  int varlist_ind = 0;
+  int varlist_len = op_data.varlist_len;
+
+  if (adaptive) {
+    maxrepetitions =
+        __adaptive_initial_repetitions(session_ctx, maxrepetitions);
+    py_log_msg(DEBUG, "%s: adaptive, starting with max_repetitions %d",
+               op_name, maxrepetitions);
+  }
+
+  if (parallel) {
+    status = bulkwalk_parallel(session_ctx, &op_data, maxrepetitions,
+                               adaptive, result_varlist);
+
+    if (status != STAT_SUCCESS) {
+      if (PyErr_Occurred()) {
+        Py_DECREF(result_varlist);
+        goto exception;
+      }
+
+      error = 1;
+    }
+
+    /* every subtree has been walked, skip the sequential walk below */
+    varlist_ind = varlist_len;
+  }
+
+  while (varlist_ind < varlist_len) {
+    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+    op_data.pdu->non_repeaters = nonrepeaters;
+    op_data.pdu->max_repetitions = maxrepetitions;
+    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+
+    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
+                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
+                op_data.op_name,
+                op_data.oid_str_arr[varlist_ind],
+                op_data.oid_idx_str_arr[varlist_ind],
+                op_data.oid_arr_len[varlist_ind],
+                session_ctx->best_guess);
+
+    notdone = 1;
+    while (notdone) {
+      py_log_msg(DEBUG, "%s: Sending pdu req",
+        op_data.op_name);
+
+      if (adaptive && op_data.pdu) {
+        /* keep a copy to resend with fewer repetitions if need be */
+        op_data.pdu->max_repetitions = maxrepetitions;
+        retry_pdu = snmp_clone_pdu(op_data.pdu);
+        netsnmp_get_monotonic_clock(&start);
+      }
+
+      status = send_pdu_request(session_ctx, &op_data, NULL);
+
+      if (retry_pdu) {
+        if (__adaptive_retry(session_ctx, &op_data, status,
+                             &maxrepetitions, &timeout_retried)) {
+          op_data.pdu = retry_pdu;
+          retry_pdu = NULL;
+          continue;
+        }
+
+        snmp_free_pdu(retry_pdu);
+        retry_pdu = NULL;
+
+        if ((status == STAT_SUCCESS) && !PyErr_Occurred()) {
+          __adapt_repetitions(session_ctx, &maxrepetitions, op_data.response,
+                              1, __elapsed_usec(&start));
+        }
+      }
+
+      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+
+        if(PyErr_Occurred()) {
+          goto exception;
+        }
+
+        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
+          op_data.op_name, status);
+        error = 1;
+        goto done;
+      }
+
+      if (notdone) {
+        vars = op_data.response->variables;
+        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+
+        while (vars) {
+
+          if (vars->type == SNMP_ENDOFMIBVIEW) {
+            py_log_msg(DEBUG, "%s: encountered end condition "
+                              "(ENDOFMIBVIEW)", op_name);
+            notdone = 0;
+            break;
+          }
+          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
+          (vars->type == SNMP_NOSUCHINSTANCE)) {
+            char val_type_str[MAX_TYPE_NAME_LEN];
+
+            __get_type_str(vars->type, val_type_str, 1);
+            varbind = py_netsnmp_construct_varbind();
+
+            py_netsnmp_varbind_set_string(varbind, VARBIND_ROOT_F, op_data.initial_oid, STRLEN(op_data.initial_oid));
+            py_netsnmp_varbind_set_string(varbind, VARBIND_TAG_F, op_data.initial_oid, STRLEN(op_data.initial_oid));
+            py_netsnmp_varbind_set_string(varbind, VARBIND_TYPE_F, val_type_str,
+                                          strlen(val_type_str));
+
+            PyList_Append(result_varlist, varbind);
+            Py_DECREF(varbind);
+
+            notdone = 0;
+            break;
+          }
+          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
+              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
+                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
+            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
+              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
+              sizeof(op_data.oid_arr[varlist_ind]),
+              sizeof(vars->name)
+            );
+            notdone = 0;
+            break;
+          }
+
+          varbind = read_variable(vars, &op_data, session_ctx);
+
+          if (varbind) {
+            PyList_Append(result_varlist, varbind);
+            Py_DECREF(varbind);
+          } else {
+            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
+          }
+
+          // Create next request if we've reached the end
+          if (vars->next_variable == NULL) {
+            op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+            op_data.pdu->non_repeaters = nonrepeaters;
+            op_data.pdu->max_repetitions = maxrepetitions;
+            snmp_add_null_var(op_data.pdu, vars->name, vars->name_length);
+            py_log_msg(DEBUG,
+              "%s: Creating pdu request for %s",
+              op_name, op_data.initial_oid
+            );
+          }
+
+          // Move on to next
+          vars = vars->next_variable;
+        }
+
+        py_log_msg(DEBUG,
+          "%s: Partially finished reading all variables from request for %s",
+          op_name, op_data.initial_oid
+        );
+      }
+
+      if (op_data.response) {
+        snmp_free_pdu(op_data.response);
+        op_data.response = NULL;
+        py_log_msg(DEBUG,
+          "%s: Finished reading all variables from request for %s",
+          op_name, op_data.initial_oid
+        );
+      }
+    }
+    varlist_ind++;
+  }
+
+  py_log_msg(DEBUG, "%s: Finished reading all variables",op_name);
+  goto done;
+
+exception:
+  snmp_op_data_finish(&op_data);
+  return NULL;
+
+done:
+  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+
+  snmp_op_data_finish(&op_data);
+
+  if(error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+      session_ctx->err_num, session_ctx->err_ind);
+
+    Py_XDECREF(result_varlist);
+    return NULL;
+  }
+
+  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+
+  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+
+  return Py_BuildValue("N", result_varlist);
+}
+
+static PyObject *netsnmp_bulkwalk_table(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  walk_table table;
+  PyObject *result = NULL;
+  PyObject *columns = NULL;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_bulkwalk_table";
+  int maxrepetitions;
+  int status;
+  int i;
+
+  snmp_op_data_reset(&op_data);
+  memset(&table, 0, sizeof(table));
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!PyArg_ParseTuple(args, "OOi", &session, &op_data.varlist,
+                        &maxrepetitions)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    goto exception;
+  }
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    goto exception;
+  }
+
+  session_ctx = get_session_context(session);
+  if (!session_ctx) {
+    goto exception;
+  }
+
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if (PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+
+  table.num_columns = op_data.varlist_len;
+  table.columns = PyMem_New(PyObject *, table.num_columns);
+  if (!table.columns) {
+    PyErr_NoMemory();
+    goto exception;
+  }
+  for (i = 0; i < table.num_columns; i++) {
+    table.columns[i] = NULL;
+  }
+
+  if (!(table.index = PyList_New(0)) || !(table.rows = PyDict_New())) {
+    goto exception;
+  }
+  for (i = 0; i < table.num_columns; i++) {
+    if (!(table.columns[i] = PyList_New(0))) {
+      goto exception;
+    }
+  }
+
+  /* each column is returned under the OID it was requested with */
+  for (i = 1; i < table.num_columns; i++) {
+    int j;
+
+    for (j = 0; j < i; j++) {
+      if (!strcmp(op_data.initial_oid_str_arr[i],
+                  op_data.initial_oid_str_arr[j])) {
+        PyErr_Format(PyExc_ValueError, "%s: column %s requested twice",
+                     op_name, op_data.initial_oid_str_arr[i]);
+        goto exception;
+      }
+    }
+  }
+
+  py_log_msg(DEBUG, "%s: Walking %d columns", op_name, table.num_columns);
+
+  status = walk_table_run(session_ctx, &op_data, maxrepetitions, &table);
+  if (status != STAT_SUCCESS) {
+    if (PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+
+  /*
+   * ([index, ...], {column: [...], ...}) keyed by each requested oid, the
+   * index being kept apart so that no column name can clash with it
+   */
+  if (!(columns = PyDict_New())) {
+    goto exception;
+  }
+  for (i = 0; i < table.num_columns; i++) {
+    if (PyDict_SetItemString(columns, op_data.initial_oid_str_arr[i],
+                             table.columns[i]) < 0) {
+      goto exception;
+    }
+  }
+  if (!(result = PyTuple_Pack(2, table.index, columns))) {
+    goto exception;
+  }
+
+  py_log_msg(DEBUG, "%s: Returning %d rows", op_name,
+             (int)PyList_GET_SIZE(table.index));
+  goto done;
+
+exception:
+  Py_CLEAR(result);
+
+done:
+
+  snmp_op_data_finish(&op_data);
+
+  Py_XDECREF(columns);
+  Py_XDECREF(table.index);
+  Py_XDECREF(table.rows);
+  if (table.columns) {
+    for (i = 0; i < table.num_columns; i++) {
+      Py_XDECREF(table.columns[i]);
+    }
+    PyMem_Free(table.columns);
+  }
+
+  if (error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+                                       session_ctx->err_num,
+                                       session_ctx->err_ind);
+    Py_CLEAR(result);
+  }
+
+  return result;
+}
+
+static PyObject *netsnmp_walk_export(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  snmp_op_data op_data;
+  walk_export export;
+  PyObject *result = NULL;
+  char *format = NULL;
+  char *buf = NULL;
+  int error = 0;
+  int op_data_error = 0;
+  char *op_name = "netsnmp_walk_export";
+  int maxrepetitions;
+  int status;
+  size_t len = 0;
+  int i;
+
+  snmp_op_data_reset(&op_data);
+  memset(&export, 0, sizeof(export));
+
+  py_log_msg(DEBUG, "%s: Starting", op_name);
+
+  if (!PyArg_ParseTuple(args, "OOsi", &session, &op_data.varlist, &format,
+                        &maxrepetitions)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    goto exception;
+  }
+
+  if (!VARLIST_CHECK(op_data.varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    goto exception;
+  }
+
+  if (strcmp(format, "ndjson") == 0) {
+    export.format = EXPORT_NDJSON;
+  } else if (strcmp(format, "msgpack") == 0) {
+    export.format = EXPORT_MSGPACK;
+  } else {
+    PyErr_Format(PyExc_ValueError, "%s: unsupported format %s", op_name,
+                 format);
+    goto exception;
+  }
+
+  session_ctx = get_session_context(session);
+  if (!session_ctx) {
+    goto exception;
+  }
+
+  op_data.op_name = op_name;
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+
+  if (op_data_error || PyErr_Occurred()) {
+    if (PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+
+  export.columns = PyMem_New(export_buf, op_data.varlist_len);
+  if (!export.columns) {
+    PyErr_NoMemory();
+    goto exception;
+  }
+  memset(export.columns, 0, op_data.varlist_len * sizeof(export_buf));
+
+  py_log_msg(DEBUG, "%s: Walking %d subtrees", op_name, op_data.varlist_len);
+
+  status = walk_export_run(session_ctx, &op_data, maxrepetitions, &export);
+  if (status != STAT_SUCCESS) {
+    if (PyErr_Occurred()) {
+      goto exception;
+    }
+
+    error = 1;
+    goto done;
+  }
+
+  /* the records of each subtree in turn, as a walk would return them */
+  for (i = 0; i < op_data.varlist_len; i++) {
+    len += export.columns[i].len;
+  }
+
+  if (!(result = PyBytes_FromStringAndSize(NULL, len))) {
+    goto exception;
+  }
+
+  buf = PyBytes_AS_STRING(result);
+  for (i = 0; i < op_data.varlist_len; i++) {
+    if (export.columns[i].len) {
+      memcpy(buf, export.columns[i].buf, export.columns[i].len);
+      buf += export.columns[i].len;
+    }
+  }
+
+  py_log_msg(DEBUG, "%s: Returning %d bytes", op_name, (int)len);
+  goto done;
+
+exception:
+  Py_CLEAR(result);
+
+done:
+
+  if (export.columns) {
+    for (i = 0; i < op_data.varlist_len; i++) {
+      PyMem_Free(export.columns[i].buf);
+    }
+    PyMem_Free(export.columns);
+  }
+
+  snmp_op_data_finish(&op_data);
+
+  if (error) {
+    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+
+    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+                                       session_ctx->err_num,
+                                       session_ctx->err_ind);
+    Py_CLEAR(result);
+  }
+
+  return result;
+}
+
+/*
+ * Iterator over a bulkwalk, yielding the SNMPVariables of each response
+ * PDU as a list as soon as it has arrived, so that only one response is
+ * held in memory at a time.  The walk state lives in the iterator between
+ * calls to next().
+ */
+typedef struct {
+  PyObject_HEAD
+  PyObject *session;
+  PyObject *varlist;
+  PyObject *batch;
+  snmp_op_data data;
+  walk_columns walk;
+  int walk_inited;
+} walk_iterator;
+
+/* walk_emit_fn collecting SNMPVariables into the current batch */
+static int __emit_batch_varbind(walk_columns *walk, snmp_op_data *data,
+                                int column, netsnmp_variable_list *vars) {
+  walk_iterator *it = walk->emit_arg;
+  PyObject *varbind = __build_response_varbind(vars, data, walk->session_ctx);
+  int ret;
+
+  if (!varbind) {
+    py_log_msg(ERROR, "%s bad varbind (%d)", data->op_name, column);
+    return PyErr_Occurred() ? -1 : 0;
+  }
+
+  ret = PyList_Append(it->batch, varbind);
+  Py_DECREF(varbind);
+  return ret;
+}
+
+static int walk_iterator_traverse(walk_iterator *it, visitproc visit,
+                                  void *arg) {
+  Py_VISIT(it->session);
+  Py_VISIT(it->varlist);
+  Py_VISIT(it->batch);
+  return 0;
+}
+
+static int walk_iterator_clear(walk_iterator *it) {
+  Py_CLEAR(it->session);
+  Py_CLEAR(it->varlist);
+  Py_CLEAR(it->batch);
+  return 0;
+}
+
+static void walk_iterator_dealloc(walk_iterator *it) {
+  PyObject_GC_UnTrack(it);
+
+  if (it->walk_inited) {
+    walk_columns_free(&it->walk);
+  }
+  snmp_op_data_finish(&it->data);
+
+  walk_iterator_clear(it);
+  PyObject_GC_Del(it);
+}
+
+static PyObject *walk_iterator_next(walk_iterator *it) {
+  session_capsule_ctx *session_ctx = NULL;
+  PyObject *batch = NULL;
+  int status;
+
+  while (it->walk_inited && it->walk.num_active > 0) {
+    /* the options of the session may have changed since the last PDU */
+    if (!(session_ctx = get_session_context(it->session))) {
+      return NULL;
+    }
+    it->walk.session_ctx = session_ctx;
+
+    if (!(it->batch = PyList_New(0))) {
+      return NULL;
+    }
+
+    status = walk_columns_step(&it->walk, &it->data);
+    batch = it->batch;
+    it->batch = NULL;
+
+    if (status != STAT_SUCCESS) {
+      Py_DECREF(batch);
+
+      /* a failed walk cannot be resumed */
+      walk_columns_free(&it->walk);
+      it->walk_inited = 0;
+
+      __py_netsnmp_update_session_errors(it->session, session_ctx->err_str,
+                                         session_ctx->err_num,
+                                         session_ctx->err_ind);
+      if (!PyErr_Occurred()) {
+        PyErr_SetString(EasySNMPError, session_ctx->err_str);
+      }
+      return NULL;
+    }
+
+    /* a response may hold nothing but the end of a subtree */
+    if (PyList_GET_SIZE(batch)) {
+      return batch;
+    }
+    Py_DECREF(batch);
+  }
+
+  /* StopIteration */
+  return NULL;
+}
+
+static PyTypeObject walk_iterator_type = {
+    PyVarObject_HEAD_INIT(NULL, 0) "easysnmp.interface.WalkIterator",
+    sizeof(walk_iterator),                    /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)walk_iterator_dealloc,        /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    "iterator over the response PDUs of a bulkwalk", /* tp_doc */
+    (traverseproc)walk_iterator_traverse,     /* tp_traverse */
+    (inquiry)walk_iterator_clear,             /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    PyObject_SelfIter,                        /* tp_iter */
+    (iternextfunc)walk_iterator_next,         /* tp_iternext */
+};
+
+static PyObject *netsnmp_iter_bulkwalk(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  PyObject *varlist = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  walk_iterator *it = NULL;
+  char *op_name = "netsnmp_iter_bulkwalk";
+  int maxrepetitions;
+  int parallel = 0;
+  int adaptive = 0;
+
+  if (!PyArg_ParseTuple(args, "OOi|ii", &session, &varlist, &maxrepetitions,
+                        &parallel, &adaptive)) {
+    const char *err_msg = "%s: Could not parse arguments";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    return NULL;
+  }
+
+  if (!VARLIST_CHECK(varlist)) {
+    const char *err_msg = "%s: varlist is not a list";
+    PyErr_Format(PyExc_ValueError, err_msg, op_name);
+    return NULL;
+  }
+
+  if (!(session_ctx = get_session_context(session))) {
+    return NULL;
+  }
+
+  if (!(it = PyObject_GC_New(walk_iterator, &walk_iterator_type))) {
+    return NULL;
+  }
+
+  Py_INCREF(session);
+  it->session = session;
+  Py_INCREF(varlist);
+  it->varlist = varlist;
+  it->batch = NULL;
+  it->walk_inited = 0;
+  snmp_op_data_reset(&it->data);
+  it->data.varlist = varlist;
+  it->data.op_name = op_name;
+  PyObject_GC_Track(it);
+
+  if (snmp_op_data_load(&it->data, session_ctx->best_guess) ||
+      PyErr_Occurred()) {
+    if (!PyErr_Occurred()) {
+      PyErr_SetString(EasySNMPError, "could not load the varlist");
+    }
+    Py_DECREF(it);
+    return NULL;
+  }
+
+  if (walk_columns_init(&it->walk, &it->data, session_ctx, SNMP_MSG_GETBULK,
+                        adaptive ? __adaptive_initial_repetitions(
+                                       session_ctx, maxrepetitions)
+                                 : maxrepetitions,
+                        __emit_batch_varbind, it) < 0) {
+    Py_DECREF(it);
+    return NULL;
+  }
+  it->walk_inited = 1;
+  it->walk.adaptive = adaptive;
+
+  /* walk one OID after the other unless asked to walk them side by side */
+  if (!parallel) {
+    it->walk.max_columns = 1;
+  }
+
+  py_log_msg(DEBUG, "%s: Walking %d OIDs", op_name, it->data.varlist_len);
+
+  return (PyObject *)it;
+}
+
+/*
+ * Asynchronous polling engine.
+ *
+ * poll_many() issues the requests of many sessions concurrently from the
+ * calling thread using snmp_sess_async_send(), and then waits on all of
+ * the session sockets with poll(2).  Retransmission and the per-request
+ * timeout are left to Net-SNMP (through snmp_sess_timeout()), using the
+ * retries and timeout configured on each session.
+ *
+ * Responses are decoded from within the Net-SNMP callbacks, which only
+ * ever run from snmp_sess_read2() and snmp_sess_timeout() while we hold
+ * the GIL; the GIL is released while waiting in poll(2).
+ */
+enum {
+  ASYNC_OP_GET,
+  ASYNC_OP_GETNEXT,
+  ASYNC_OP_GETBULK,
+  ASYNC_OP_WALK,
+  ASYNC_OP_BULKWALK
+};
+
+typedef struct async_engine async_engine;
+typedef struct async_request async_request;
+
+/*
+ * The callback magic for a request in flight.  If the engine gives up on
+ * a request before Net-SNMP does then the ticket is orphaned (req set to
+ * NULL) and freed by whichever callback eventually fires for it.
+ */
+typedef struct {
+  async_request *req;
+  struct timeval sent;
+} async_ticket;
+
+struct async_request {
+  async_engine *engine;
+  PyObject *session;
+  session_capsule_ctx *session_ctx;
+  int op;
+  int non_repeaters;
+  int max_repetitions;
+  int handle_ind;
+
+  snmp_op_data data;
+  int data_loaded;
+
+  /* get, getnext and getbulk progress through the varlist in chunks */
+  int varlist_ind;
+  int chunk_len;
+  int num_varbinds;
+
+  /* walk and bulkwalk use the shared column walk state */
+  walk_columns walk;
+  int walk_inited;
+  PyObject **column_lists;
+
+  netsnmp_pdu *pending_pdu;
+  async_ticket *ticket;
+
+  PyObject *result;
+  PyObject *error;
+  int done;
+};
+
+struct async_engine {
+  async_request *requests;
+  int num_requests;
+  int next_request;
+  int in_flight;
+  int max_in_flight;
+
+  /* distinct session handles, each with its own socket */
+  void **handles;
+  int *handle_in_flight;
+  int num_handles;
+};
+
+static void __async_fail(async_request *req, PyObject *exc_type,
+                         const char *msg) {
+  if (req->done) {
+    return;
+  }
+
+  req->error = PyObject_CallFunction(exc_type, "s", msg);
+  if (!req->error) {
+    /* keep whichever exception stopped us from building the error */
+    PyObject *type, *value, *traceback;
+
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+    req->error = value;
+    Py_XDECREF(type);
+    Py_XDECREF(traceback);
+  }
+  req->done = 1;
+}
+
+/* fail the request with whatever Python exception is currently set */
+static void __async_fail_pyerr(async_request *req) {
+  PyObject *type, *value, *traceback;
+
+  if (!PyErr_Occurred()) {
+    __async_fail(req, EasySNMPError, "unknown error");
+    return;
+  }
+
+  PyErr_Fetch(&type, &value, &traceback);
+  PyErr_NormalizeException(&type, &value, &traceback);
+  Py_XDECREF(type);
+  Py_XDECREF(traceback);
+
+  if (!req->done) {
+    req->error = value;
+    req->done = 1;
+  } else {
+    Py_XDECREF(value);
+  }
+}
+
+/* build the next request PDU, or mark the request done when complete */
+static void __async_prepare_pdu(async_request *req) {
+  snmp_op_data *data = &req->data;
+  int command;
+  int i;
+
+  if (req->done) {
+    return;
+  }
+
+  if (req->op == ASYNC_OP_WALK || req->op == ASYNC_OP_BULKWALK) {
+    if (req->walk.num_active == 0) {
+      req->done = 1;
+      return;
+    }
+    req->pending_pdu = walk_columns_next_pdu(&req->walk);
+    return;
+  }
+
+  if (req->varlist_ind >= data->varlist_len) {
+    req->done = 1;
+    return;
+  }
+
+  req->num_varbinds = data->varlist_len - req->varlist_ind;
+  if (req->num_varbinds > req->chunk_len) {
+    req->num_varbinds = req->chunk_len;
+  }
+
+  command = (req->op == ASYNC_OP_GET)       ? SNMP_MSG_GET
+            : (req->op == ASYNC_OP_GETNEXT) ? SNMP_MSG_GETNEXT
+                                            : SNMP_MSG_GETBULK;
+
+  req->pending_pdu = snmp_pdu_create(command);
+  if (command == SNMP_MSG_GETBULK) {
+    req->pending_pdu->non_repeaters = req->non_repeaters;
+    req->pending_pdu->max_repetitions = req->max_repetitions;
+  }
+
+  for (i = req->varlist_ind; i < req->varlist_ind + req->num_varbinds; i++) {
+    snmp_add_null_var(req->pending_pdu, data->oid_arr[i],
+                      data->oid_arr_len[i]);
+  }
+}
+
+static void __async_read_response(async_request *req, netsnmp_pdu *response) {
+  snmp_op_data *data = &req->data;
+  netsnmp_variable_list *vars = NULL;
+  PyObject *varbind = NULL;
+  int i;
+
+  switch (response->errstat) {
+  case SNMP_ERR_NOERROR:
+    break;
+
+  case SNMP_ERR_TOOBIG:
+    if (req->num_varbinds > 1 && req->op != ASYNC_OP_WALK &&
+        req->op != ASYNC_OP_BULKWALK) {
+      req->chunk_len = req->num_varbinds / 2;
+      py_log_msg(DEBUG, "%s: response too big, retrying with %d varbinds",
+                 data->op_name, req->chunk_len);
+      __async_prepare_pdu(req);
+      return;
+    }
+    __async_fail(req, EasySNMPError, snmp_errstring(response->errstat));
+    return;
+
+  case SNMP_ERR_NOSUCHNAME:
+    __async_fail(req, EasySNMPNoSuchNameError,
+                 "no such name error encountered");
+    return;
+
+  default:
+    __async_fail(req, EasySNMPError, snmp_errstring(response->errstat));
+    return;
+  }
+
+  switch (req->op) {
+  case ASYNC_OP_GET:
+  case ASYNC_OP_GETNEXT:
+    for (vars = response->variables, i = 0; vars && i < req->num_varbinds;
+         vars = vars->next_variable, i++) {
+      __append_response_var(vars, data, req->varlist_ind + i,
+                            req->session_ctx, req->result);
+    }
+    req->varlist_ind += req->num_varbinds;
+    break;
+
+  case ASYNC_OP_GETBULK:
+    /* one varbind per request, stopping where netsnmp_getbulk() does */
+    data->initial_oid = data->initial_oid_str_arr[req->varlist_ind];
+    for (vars = response->variables; vars; vars = vars->next_variable) {
+      if (vars->type == SNMP_ENDOFMIBVIEW) {
+        break;
+      }
+
+      if ((vars->type != SNMP_NOSUCHOBJECT) &&
+          (vars->type != SNMP_NOSUCHINSTANCE) &&
+          ((vars->name_length < data->oid_arr_len[req->varlist_ind]) ||
+           (memcmp(data->oid_arr[req->varlist_ind], vars->name,
+                   data->oid_arr_len[req->varlist_ind] * sizeof(oid)) !=
+            0))) {
+        break;
+      }
+
+      varbind = __build_response_varbind(vars, data, req->session_ctx);
+      if (varbind) {
+        PyList_Append(req->result, varbind);
+        Py_DECREF(varbind);
+      }
+
+      if ((vars->type == SNMP_NOSUCHOBJECT) ||
+          (vars->type == SNMP_NOSUCHINSTANCE)) {
+        break;
+      }
+    }
+    req->varlist_ind += req->num_varbinds;
+    break;
+
+  case ASYNC_OP_WALK:
+  case ASYNC_OP_BULKWALK:
+    if (walk_columns_read_response(&req->walk, data, response) < 0) {
+      __async_fail_pyerr(req);
+      return;
+    }
+    break;
+  }
+
+  if (PyErr_Occurred()) {
+    __async_fail_pyerr(req);
+    return;
+  }
+
+  __async_prepare_pdu(req);
+}
+
+static int __async_callback(int operation, netsnmp_session *sp, int reqid,
+                            netsnmp_pdu *pdu, void *magic) {
+  async_ticket *ticket = magic;
+  async_request *req = ticket->req;
+  long rtt = __elapsed_usec(&ticket->sent);
+
+  free(ticket);
+
+  if (!req) {
+    /* the engine has already given up on this request */
+    return 1;
+  }
+
+  req->ticket = NULL;
+  req->engine->in_flight--;
+  req->engine->handle_in_flight[req->handle_ind]--;
+
+  switch (operation) {
+  case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+    __stats_response(&req->session_ctx->stats,
+                     req->engine->handles[req->handle_ind], pdu, rtt);
+    __async_read_response(req, pdu);
+    break;
+
+  case NETSNMP_CALLBACK_OP_TIMED_OUT:
+    __stats_timeout(&req->session_ctx->stats,
+                    req->engine->handles[req->handle_ind]);
+    py_log_msg(ERROR, "%s: timed out", req->data.op_name);
+    __async_fail(req, EasySNMPTimeoutError,
+                 "timed out while connecting to remote host");
+    break;
+
+  default:
+    __async_fail(req, EasySNMPError, "failed to send request");
+    break;
+  }
+
+  return 1;
+}
+
+/* hand the pending PDU of a request to Net-SNMP */
+static void __async_send(async_request *req) {
+  async_engine *engine = req->engine;
+  void *handle = engine->handles[req->handle_ind];
+  async_ticket *ticket = NULL;
+  int *err_num = &req->session_ctx->err_num;
+  int *err_ind = &req->session_ctx->err_ind;
+  char *tmp_err_str = NULL;
+
+  if (!req->pending_pdu) {
+    return;
+  }
+
+  if (!(ticket = malloc(sizeof *ticket))) {
+    snmp_free_pdu(req->pending_pdu);
+    req->pending_pdu = NULL;
+    __async_fail(req, PyExc_MemoryError, "could not allocate request");
+    return;
+  }
+  ticket->req = req;
+  netsnmp_get_monotonic_clock(&ticket->sent);
+
+  if (!snmp_sess_async_send(handle, req->pending_pdu, __async_callback,
+                            ticket)) {
+    snmp_sess_error(handle, err_num, err_ind, &tmp_err_str);
+    py_log_msg(ERROR, "%s: send failed: %s", req->data.op_name,
+               tmp_err_str ? tmp_err_str : "unknown error");
+    __async_fail(req, EasySNMPError,
+                 tmp_err_str ? tmp_err_str : "failed to send request");
+    free(tmp_err_str);
+    free(ticket);
+    snmp_free_pdu(req->pending_pdu);
+    req->pending_pdu = NULL;
+    return;
+  }
+
+  req->pending_pdu = NULL;
+  req->ticket = ticket;
+  req->session_ctx->stats.pdus_sent++;
+  engine->in_flight++;
+  engine->handle_in_flight[req->handle_ind]++;
+}
+
+static int __async_op_from_name(const char *op) {
+  if (!strcmp(op, "get")) {
+    return ASYNC_OP_GET;
+  } else if (!strcmp(op, "get_next")) {
+    return ASYNC_OP_GETNEXT;
+  } else if (!strcmp(op, "get_bulk")) {
+    return ASYNC_OP_GETBULK;
+  } else if (!strcmp(op, "walk")) {
+    return ASYNC_OP_WALK;
+  } else if (!strcmp(op, "bulkwalk")) {
+    return ASYNC_OP_BULKWALK;
+  }
+  return -1;
+}
+
+static int __compare_handles(const void *a, const void *b) {
+  const char *x = *(void *const *)a;
+  const char *y = *(void *const *)b;
+  return (x > y) - (x < y);
+}
+
+static int __find_handle(async_engine *engine, void *handle) {
+  int lo = 0;
+  int hi = engine->num_handles - 1;
+  int mid;
+
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    if ((char *)engine->handles[mid] < (char *)handle) {
+      lo = mid + 1;
+    } else if ((char *)engine->handles[mid] > (char *)handle) {
+      hi = mid - 1;
+    } else {
+      return mid;
+    }
+  }
+  return -1;
+}
+
+/* parse and load (session, op, varlist, non_repeaters, max_repetitions) */
+static int __async_request_load(async_request *req, PyObject *item) {
+  char *op = NULL;
+  PyObject *varlist = NULL;
+  int walk_command;
+
+  req->non_repeaters = 0;
+  req->max_repetitions = 10;
+
+  if (!PyArg_ParseTuple(item, "OsO|ii", &req->session, &op, &varlist,
+                        &req->non_repeaters, &req->max_repetitions)) {
+    return -1;
+  }
+  Py_INCREF(req->session);
+
+  if ((req->op = __async_op_from_name(op)) < 0) {
+    PyErr_Format(PyExc_ValueError, "unsupported operation (%s)", op);
+    return -1;
+  }
+
+  if (!VARLIST_CHECK(varlist)) {
+    PyErr_SetString(PyExc_ValueError, "poll_many: varlist is not a list");
+    return -1;
+  }
+
+  if (!(req->session_ctx = get_session_context(req->session))) {
+    return -1;
+  }
+
+  req->data.varlist = varlist;
+  req->data.op_name = "poll_many";
+  req->data_loaded = 1;
+  if (snmp_op_data_load(&req->data, req->session_ctx->best_guess) ||
+      PyErr_Occurred()) {
+    if (!PyErr_Occurred()) {
+      PyErr_SetString(EasySNMPError, "could not load the varlist");
+    }
+    return -1;
+  }
+
+  if (!(req->result = PyList_New(0))) {
+    return -1;
+  }
+
+  req->chunk_len = req->session_ctx->max_varbinds;
+  if (req->chunk_len <= 0) {
+    req->chunk_len = req->data.varlist_len;
+  }
+  if (req->op == ASYNC_OP_GETBULK || req->chunk_len <= 0) {
+    req->chunk_len = 1;
+  }
+
+  if (req->op == ASYNC_OP_WALK || req->op == ASYNC_OP_BULKWALK) {
+    int i;
+
+    req->column_lists = PyMem_New(PyObject *, req->data.varlist_len);
+    if (!req->column_lists) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    for (i = 0; i < req->data.varlist_len; i++) {
+      req->column_lists[i] = NULL;
+    }
+    for (i = 0; i < req->data.varlist_len; i++) {
+      if (!(req->column_lists[i] = PyList_New(0))) {
+        return -1;
+      }
+    }
+
+    walk_command =
+        (req->op == ASYNC_OP_WALK) ? SNMP_MSG_GETNEXT : SNMP_MSG_GETBULK;
+    if (walk_columns_init(&req->walk, &req->data, req->session_ctx,
+                          walk_command, req->max_repetitions,
+                          __emit_column_varbind, req->column_lists) < 0) {
+      return -1;
+    }
+    req->walk_inited = 1;
+
+    /* a GETNEXT walk carries as many columns as a get_next() would */
+    if (req->op == ASYNC_OP_WALK) {
+      req->walk.max_columns = req->session_ctx->max_varbinds;
+    }
+  }
+
+  return 0;
+}
+
+/* collect the final result (or exception) of a request */
+static PyObject *__async_request_result(async_request *req) {
+  int i;
+
+  if (req->error) {
+    Py_INCREF(req->error);
+    return req->error;
+  }
+
+  if (req->column_lists) {
+    for (i = 0; i < req->data.varlist_len; i++) {
+      Py_ssize_t len = PyList_GET_SIZE(req->result);
+
+      if (PyList_SetSlice(req->result, len, len, req->column_lists[i]) < 0) {
+        return NULL;
+      }
+    }
+  }
+
+  Py_INCREF(req->result);
+  return req->result;
+}
+
+static void __async_request_free(async_request *req) {
+  int i;
+
+  if (req->ticket) {
+    /* still in flight with Net-SNMP, let the callback free the ticket */
+    req->ticket->req = NULL;
+  }
+  if (req->pending_pdu) {
+    snmp_free_pdu(req->pending_pdu);
+  }
+  if (req->walk_inited) {
+    walk_columns_free(&req->walk);
+  }
+  if (req->column_lists) {
+    for (i = 0; i < req->data.varlist_len; i++) {
+      Py_XDECREF(req->column_lists[i]);
     }
+    PyMem_Free(req->column_lists);
   }
-  if ((des_enabled == 1) && !strcmp(priv_proto, "DES")) {
-    session.securityPrivProto =
-        snmp_duplicate_objid(usmDESPrivProtocol, USM_PRIV_PROTO_DES_LEN);
-    session.securityPrivProtoLen = USM_PRIV_PROTO_DES_LEN;
-  } else if (!strncmp(priv_proto, "AES", 3)) {
-    session.securityPrivProto =
-        snmp_duplicate_objid(usmAESPrivProtocol, USM_PRIV_PROTO_AES_LEN);
-    session.securityPrivProtoLen = USM_PRIV_PROTO_AES_LEN;
-  } else if (!strcmp(priv_proto, "DEFAULT")) {
-    const oid *p = get_default_privtype(&session.securityPrivProtoLen);
-    session.securityPrivProto =
-        snmp_duplicate_objid(p, session.securityPrivProtoLen);
-  } else {
-    PyErr_Format(PyExc_ValueError, "unsupported privacy protocol (%s)",
-                 priv_proto);
-    goto done;
+  if (req->data_loaded) {
+    snmp_op_data_finish(&req->data);
   }
+  Py_XDECREF(req->result);
+  Py_XDECREF(req->error);
+  Py_XDECREF(req->session);
+}
 
-  if (session.securityLevel >= SNMP_SEC_LEVEL_AUTHPRIV) {
-    session.securityPrivKeyLen = USM_PRIV_KU_LEN;
-    if (generate_Ku(session.securityAuthProto, session.securityAuthProtoLen,
-                    (u_char *)priv_pass, STRLEN(priv_pass),
-                    session.securityPrivKey,
-                    &session.securityPrivKeyLen) != SNMPERR_SUCCESS) {
-      PyErr_SetString(EasySNMPConnectionError,
-                      "couldn't gen Ku from priv pass phrase");
-      goto done;
+static double __monotonic_seconds(void) {
+  struct timeval now;
+
+  netsnmp_get_monotonic_clock(&now);
+  return now.tv_sec + now.tv_usec / 1e6;
+}
+
+/* start queued requests until the in flight limit is reached */
+static void __async_start_requests(async_engine *engine) {
+  async_request *req;
+
+  while (engine->next_request < engine->num_requests &&
+         (engine->max_in_flight <= 0 ||
+          engine->in_flight < engine->max_in_flight)) {
+    req = &engine->requests[engine->next_request++];
+    if (req->done) {
+      continue;
     }
+    __async_prepare_pdu(req);
+    __async_send(req);
   }
+}
 
-  return create_session_capsule(&session);
+/*
+ * Run the requests of the engine to completion, or until deadline (in
+ * seconds since the monotonic epoch, 0 for none) passes.
+ */
+static int __async_run(async_engine *engine, double deadline) {
+  struct pollfd *pfds = NULL;
+  int *pfd_handles = NULL;
+  netsnmp_large_fd_set fdset;
+  struct timeval timeout;
+  double remaining;
+  int num_pfds;
+  int numfds;
+  int block;
+  int ready;
+  int ms;
+  int i;
 
-done:
+  pfds = PyMem_New(struct pollfd, engine->num_handles);
+  pfd_handles = PyMem_New(int, engine->num_handles);
+  if (!pfds || !pfd_handles) {
+    PyMem_Free(pfds);
+    PyMem_Free(pfd_handles);
+    PyErr_NoMemory();
+    return -1;
+  }
 
-  SAFE_FREE(session.securityEngineID);
-  SAFE_FREE(session.contextEngineID);
+  netsnmp_large_fd_set_init(&fdset, FD_SETSIZE);
 
-  return NULL;
+  __async_start_requests(engine);
+
+  while (engine->in_flight > 0) {
+    /* wait no longer than the earliest retransmission of any session */
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    num_pfds = 0;
+
+    for (i = 0; i < engine->num_handles; i++) {
+      netsnmp_transport *transport;
+
+      if (!engine->handle_in_flight[i]) {
+        continue;
+      }
+
+      block = 0;
+      numfds = 0;
+      snmp_sess_select_info2(engine->handles[i], &numfds, &fdset, &timeout,
+                             &block);
+
+      transport = snmp_sess_transport(engine->handles[i]);
+      if (transport && transport->sock >= 0) {
+        pfds[num_pfds].fd = transport->sock;
+        pfds[num_pfds].events = POLLIN;
+        pfds[num_pfds].revents = 0;
+        pfd_handles[num_pfds] = i;
+        num_pfds++;
+      }
+    }
+
+    ms = timeout.tv_sec * 1000 + (timeout.tv_usec + 999) / 1000;
+    if (deadline > 0) {
+      remaining = deadline - __monotonic_seconds();
+      if (remaining <= 0) {
+        break;
+      }
+      if (remaining * 1000 < ms) {
+        ms = (int)(remaining * 1000) + 1;
+      }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ready = poll(pfds, num_pfds, ms);
+    Py_END_ALLOW_THREADS
+
+    if (ready < 0) {
+      if (errno == EINTR) {
+        if (PyErr_CheckSignals() < 0) {
+          break;
+        }
+        continue;
+      }
+      PyErr_SetFromErrno(PyExc_OSError);
+      break;
+    }
+
+    NETSNMP_LARGE_FD_ZERO(&fdset);
+    for (i = 0; i < num_pfds && ready > 0; i++) {
+      if (!pfds[i].revents) {
+        continue;
+      }
+      NETSNMP_LARGE_FD_SET(pfds[i].fd, &fdset);
+      snmp_sess_read2(engine->handles[pfd_handles[i]], &fdset);
+      NETSNMP_LARGE_FD_CLR(pfds[i].fd, &fdset);
+    }
+
+    /* let Net-SNMP retransmit or expire anything which is overdue */
+    for (i = 0; i < engine->num_handles; i++) {
+      if (engine->handle_in_flight[i]) {
+        snmp_sess_timeout(engine->handles[i]);
+      }
+    }
+
+    /* send the follow up requests queued up by the callbacks */
+    for (i = 0; i < engine->next_request; i++) {
+      if (engine->requests[i].pending_pdu) {
+        __async_send(&engine->requests[i]);
+      }
+    }
+
+    __async_start_requests(engine);
+  }
+
+  netsnmp_large_fd_set_cleanup(&fdset);
+  PyMem_Free(pfds);
+  PyMem_Free(pfd_handles);
+
+  return PyErr_Occurred() ? -1 : 0;
 }
 
-static PyObject *netsnmp_create_session_tunneled(PyObject *self,
-                                                 PyObject *args) {
-  int version;
-  char *peer;
-  int lport;
-  int retries;
-  int timeout;
-  char *sec_name;
-  int sec_level;
-  char *context_eng_id;
-  char *context;
-  char *our_identity;
-  char *their_identity;
-  char *their_hostname;
-  char *trust_cert;
-  SnmpSession session = {0};
+static PyObject *netsnmp_poll_many(PyObject *self, PyObject *args) {
+  PyObject *requests = NULL;
+  PyObject *results = NULL;
+  PyObject *item = NULL;
+  async_engine engine;
+  double timeout = 0;
+  double deadline = 0;
+  int num_handles;
+  int i;
 
-  if (!PyArg_ParseTuple(args, "isiiisissssss", &version, &peer, &lport,
-                        &retries, &timeout, &sec_name, &sec_level,
-                        &context_eng_id, &context, &our_identity,
-                        &their_identity, &their_hostname, &trust_cert)) {
+  memset(&engine, 0, sizeof(engine));
+
+  if (!PyArg_ParseTuple(args, "O|di", &requests, &timeout,
+                        &engine.max_in_flight)) {
     return NULL;
   }
 
-  if (version != 3) {
-    PyErr_SetString(PyExc_ValueError,
-                    "you must use SNMP version 3 as it's the only "
-                    "version that supports tunneling");
+  if (!PyList_Check(requests)) {
+    PyErr_SetString(PyExc_ValueError, "poll_many: requests is not a list");
     return NULL;
   }
 
-  snmp_sess_init(&session);
+  engine.num_requests = PyList_GET_SIZE(requests);
+  engine.requests = PyMem_New(async_request, engine.num_requests);
+  engine.handles = PyMem_New(void *, engine.num_requests);
+  engine.handle_in_flight = PyMem_New(int, engine.num_requests);
+  if ((!engine.requests || !engine.handles || !engine.handle_in_flight) &&
+      engine.num_requests) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  memset(engine.requests, 0, engine.num_requests * sizeof(async_request));
 
-  session.peername = peer;
-  session.retries = retries; /* 5 */
-  session.timeout = timeout; /* 1000000L */
-  session.contextNameLen = STRLEN(context);
-  session.contextName = context;
-  session.securityNameLen = STRLEN(sec_name);
-  session.securityName = sec_name;
-  session.securityLevel = sec_level;
-  session.securityModel = NETSNMP_TSM_SECURITY_MODEL;
+  py_log_msg(DEBUG, "poll_many: loading %d requests", engine.num_requests);
 
-  /* create the transport configuration store */
-  if (!session.transport_configuration) {
-    netsnmp_container_init_list();
-    session.transport_configuration =
-        netsnmp_container_find("transport_configuration:fifo");
-    if (!session.transport_configuration) {
-      py_log_msg(ERROR, "failed to initialize the transport "
-                        "configuration container");
+  for (i = 0; i < engine.num_requests; i++) {
+    async_request *req = &engine.requests[i];
+
+    req->engine = &engine;
+    snmp_op_data_reset(&req->data);
+    item = PyList_GET_ITEM(requests, i);
+    if (!PyTuple_Check(item)) {
+      PyErr_SetString(PyExc_ValueError,
+                      "poll_many: each request must be a tuple");
+      goto done;
+    }
+    if (__async_request_load(req, item) < 0) {
       goto done;
     }
+    engine.handles[i] = req->session_ctx->handle;
+  }
 
-    session.transport_configuration->compare =
-        (netsnmp_container_compare *)netsnmp_transport_config_compare;
+  /* group the requests by session handle, sharing a socket */
+  qsort(engine.handles, engine.num_requests, sizeof(void *),
+        __compare_handles);
+  for (i = 0, num_handles = 0; i < engine.num_requests; i++) {
+    if (!num_handles || engine.handles[num_handles - 1] != engine.handles[i]) {
+      engine.handles[num_handles++] = engine.handles[i];
+    }
+  }
+  engine.num_handles = num_handles;
+  for (i = 0; i < engine.num_handles; i++) {
+    engine.handle_in_flight[i] = 0;
+  }
+  for (i = 0; i < engine.num_requests; i++) {
+    engine.requests[i].handle_ind =
+        __find_handle(&engine, engine.requests[i].session_ctx->handle);
   }
 
-  if (our_identity && our_identity[0] != '\0')
-    CONTAINER_INSERT(
-        session.transport_configuration,
-        netsnmp_transport_create_config("localCert", our_identity));
+  if (timeout > 0) {
+    deadline = __monotonic_seconds() + timeout;
+  }
 
-  if (their_identity && their_identity[0] != '\0')
-    CONTAINER_INSERT(
-        session.transport_configuration,
-        netsnmp_transport_create_config("peerCert", their_identity));
+  if (__async_run(&engine, deadline) < 0) {
+    goto done;
+  }
 
-  if (their_hostname && their_hostname[0] != '\0')
-    CONTAINER_INSERT(
-        session.transport_configuration,
-        netsnmp_transport_create_config("their_hostname", their_hostname));
+  if (!(results = PyList_New(engine.num_requests))) {
+    goto done;
+  }
 
-  if (trust_cert && trust_cert[0] != '\0')
-    CONTAINER_INSERT(session.transport_configuration,
-                     netsnmp_transport_create_config("trust_cert", trust_cert));
+  for (i = 0; i < engine.num_requests; i++) {
+    async_request *req = &engine.requests[i];
 
-  return create_session_capsule(&session);
+    if (!req->done) {
+      __async_fail(req, EasySNMPTimeoutError,
+                   "timed out while waiting for the remaining requests");
+    }
+
+    if (!(item = __async_request_result(req))) {
+      Py_CLEAR(results);
+      goto done;
+    }
+    PyList_SET_ITEM(results, i, item);
+  }
+
+  py_log_msg(DEBUG, "poll_many: finished %d requests", engine.num_requests);
 
 done:
 
-  return NULL;
+  for (i = 0; engine.requests && i < engine.num_requests; i++) {
+    __async_request_free(&engine.requests[i]);
+  }
+  PyMem_Free(engine.requests);
+  PyMem_Free(engine.handles);
+  PyMem_Free(engine.handle_in_flight);
+
+  return results;
 }
 
-static PyObject *netsnmp_get(PyObject *self, PyObject *args) {
-  PyObject *session = NULL;
-  session_capsule_ctx *session_ctx = NULL;
-  snmp_op_data op_data;
-  PyObject *result_varlist = NULL;
-  netsnmp_variable_list *vars = NULL;
-  int error = 0;
-  int op_data_error = 0;
-  char *op_name = "netsnmp_get";
+/*
+ * Translate the OID of a varbind to be SET and copy its value into val_buf
+ * (STR_BUF_SIZE bytes), replacing an enumeration label by its value when
+ * use_enums is set.
+ *
+ * returns : 0 on success, -1 with a Python exception set on failure
+ */
+static int __load_set_varbind(PyObject *varbind, int use_enums,
+                              int best_guess, oid *oid_arr, int *oid_arr_len,
+                              int *type, u_char *val_buf, int *val_len) {
+  struct tree *tp = NULL;
+  struct enum_list *ep = NULL;
+  char *tag = NULL;
+  char *iid = NULL;
+  char *val = NULL;
+  char *type_str = NULL;
+  Py_ssize_t tmplen;
 
-  snmp_op_data_reset(&op_data);
+  *oid_arr_len = MAX_OID_LEN;
+  if (py_netsnmp_attr_string(varbind, "oid", &tag, NULL) < 0 ||
+      py_netsnmp_attr_string(varbind, "oid_index", &iid, NULL) < 0) {
+    return -1;
+  }
 
-  py_log_msg(DEBUG, "%s: Starting", op_name);
+  tp = __tag2oid_cached(tag, iid, oid_arr, oid_arr_len, type, best_guess);
+  if (*oid_arr_len == 0) {
+    PyErr_Format(EasySNMPUnknownObjectIDError, "unknown object id (%s)",
+                 (tag ? tag : "<null>"));
+    return -1;
+  }
 
-  if (!args) {
-    const char *err_msg = "%s: missing arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  if (*type == TYPE_UNKNOWN) {
+    if (py_netsnmp_attr_string(varbind, "snmp_type", &type_str, NULL) < 0) {
+      return -1;
+    }
+    *type = __translate_appl_type(type_str);
+    if (*type == TYPE_UNKNOWN) {
+      PyErr_SetString(EasySNMPUndeterminedTypeError,
+                      "a type could not be determine for "
+                      "the object");
+      return -1;
+    }
   }
 
-  if (!PyArg_ParseTuple(args, "OO", &session, &op_data.varlist)) {
-    const char *err_msg = "%s: Could not parse arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  if (py_netsnmp_attr_string(varbind, "value", &val, &tmplen) < 0) {
+    return -1;
   }
 
-  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+  memset(val_buf, 0, STR_BUF_SIZE);
+  if (tmplen >= STR_BUF_SIZE) {
+    tmplen = STR_BUF_SIZE - 1;
+  }
 
-  if (!PyList_Check(op_data.varlist)) {
-    const char *err_msg = "%s: varlist is not a list";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  memcpy(val_buf, val, tmplen);
+  if (*type == TYPE_INTEGER && use_enums && tp && tp->enums) {
+    for (ep = tp->enums; ep; ep = ep->next) {
+      if (val && !strcmp(ep->label, val)) {
+        snprintf((char *)val_buf, STR_BUF_SIZE, "%d", ep->value);
+        break;
+      }
+    }
   }
+  *val_len = (int)tmplen;
 
-  py_log_msg(DEBUG, "%s: Getting session context", op_name);
-  session_ctx = get_session_context(session);
+  return 0;
+}
 
-  if (!session_ctx) {
-    error = 1;
-    goto done;
-  }
-  py_log_msg(DEBUG, "%s: Got session context", op_name);
+static PyObject *netsnmp_set(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  PyObject *varlist = NULL;
+  PyObject *varbind = NULL;
+  PyObject *ret = NULL;
 
-  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
-  op_data.op_name = op_name;
-  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+  session_capsule_ctx *session_ctx = NULL;
+  netsnmp_session *ss = NULL;
+  netsnmp_pdu *pdu = NULL;
+  netsnmp_pdu *response = NULL;
 
-  if (op_data_error || PyErr_Occurred()) {
-    if(PyErr_Occurred()) {
-      goto exception;
+  int len;
+  oid *oid_arr = calloc(MAX_OID_LEN, sizeof(oid));
+  int oid_arr_len = MAX_OID_LEN;
+  int type;
+  u_char tmp_val_str[STR_BUF_SIZE];
+  int use_enums;
+  int best_guess;
+  int status;
+  int err_ind;
+  int err_num;
+  char err_str[STR_BUF_SIZE];
+  char *tmpstr = NULL;
+  Py_ssize_t tmplen;
+  int error = 0;
+
+  if (oid_arr && args) {
+    if (!PyArg_ParseTuple(args, "OO", &session, &varlist)) {
+      goto done;
+    }
+
+    session_ctx = get_session_context(session);
+
+    if (!session_ctx) {
+      goto done;
     }
-    error = 1;
-    goto done;
-  }
-  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
 
-  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+    ss = session_ctx->handle;
 
-  result_varlist = PyList_New(0);
-  PyObject * varbind = NULL;
-  int notdone = 0;
-  int status = 0;
-  int varlist_ind = 0;
-  int varlist_len = op_data.varlist_len;
+    if (py_netsnmp_attr_string(session, "error_string", &tmpstr, &tmplen) < 0) {
+      goto done;
+    }
 
-  while (varlist_ind < varlist_len) {
-    op_data.pdu = snmp_pdu_create(SNMP_MSG_GET);
-    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+    use_enums = py_netsnmp_attr_long(session, "use_enums");
+    best_guess = py_netsnmp_attr_long(session, "best_guess");
 
-    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
-                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
-                op_data.op_name,
-                op_data.oid_str_arr[varlist_ind],
-                op_data.oid_idx_str_arr[varlist_ind],
-                op_data.oid_arr_len[varlist_ind],
-                session_ctx->best_guess);
+    pdu = snmp_pdu_create(SNMP_MSG_SET);
 
-    notdone = 1;
-    while (notdone) {
-      py_log_msg(DEBUG, "%s: Sending pdu req",
-        op_data.op_name);
+    if (varlist) {
+      PyObject *varlist_iter = PyObject_GetIter(varlist);
 
-      status = send_pdu_request(session_ctx, &op_data);
-      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+      while (varlist_iter && (varbind = PyIter_Next(varlist_iter))) {
+        if (__load_set_varbind(varbind, use_enums, best_guess, oid_arr,
+                               &oid_arr_len, &type, tmp_val_str, &len) < 0) {
+          error = 1;
+          snmp_free_pdu(pdu);
+          Py_DECREF(varbind);
+          Py_DECREF(varlist_iter);
+          goto done;
+        }
 
-        if(PyErr_Occurred()) {
-          goto exception;
+        status = __add_var_val_str(pdu, oid_arr, oid_arr_len,
+                                   (char *)tmp_val_str, len, type);
+
+        if (status == FAILURE) {
+          py_log_msg(ERROR, "set: adding variable/value to PDU");
         }
 
-        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
-          op_data.op_name, status);
-        error = 1;
-        goto done;
+        /* release reference when done */
+        Py_DECREF(varbind);
       }
 
-      if (notdone) {
-        vars = op_data.response->variables;
-        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+      Py_XDECREF(varlist_iter);
 
-        while (vars) {
+      if (PyErr_Occurred()) {
+        error = 1;
+        snmp_free_pdu(pdu);
+        goto done;
+      }
+    }
 
-          if (vars->type == SNMP_ENDOFMIBVIEW) {
-            py_log_msg(DEBUG, "%s: encountered end condition "
-                              "(ENDOFMIBVIEW)", op_name);
-            notdone = 0;
-            break;
-          }
-          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
-          (vars->type == SNMP_NOSUCHINSTANCE)) {
-            char val_type_str[MAX_TYPE_NAME_LEN];
+    status = __send_sync_pdu(ss, pdu, &response, NO_RETRY_NOSUCH, err_str,
+                             &err_num, &err_ind, NULL, &session_ctx->stats);
+    __py_netsnmp_update_session_errors(session, err_str, err_num, err_ind);
+    if (status != 0) {
+      error = 1;
+      goto done;
+    }
 
-            __get_type_str(vars->type, val_type_str, 1);
-            varbind = py_netsnmp_construct_varbind();
+    if (response) {
+      snmp_free_pdu(response);
+    }
 
-            py_netsnmp_attr_set_string(varbind, "root_oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "snmp_type", val_type_str,
-                                       strlen(val_type_str));
+    if (status == STAT_SUCCESS) {
+      ret = Py_BuildValue("i", 1); /* success, return True */
+    } else {
+      ret = Py_BuildValue("i", 0); /* fail, return False */
+    }
+  }
 
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
+done:
 
-            notdone = 0;
-            break;
-          }
-          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
-              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
-                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
-            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
-              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
-              sizeof(op_data.oid_arr[varlist_ind]),
-              sizeof(vars->name)
-            );
-            notdone = 0;
-            break;
-          }
+  SAFE_FREE(oid_arr);
+  if (error) {
+    return NULL;
+  } else {
+    return (ret ? ret : Py_BuildValue(""));
+  }
+}
 
-          varbind = read_variable(vars, &op_data, session_ctx->getlabel_flag, session_ctx->sprintval_flag);
+/*
+ * Batched SET.
+ *
+ * set_batch() packs the varbinds to be set into as few SET PDUs as the
+ * agent allows and keeps several of those PDUs in flight at once.  Each
+ * PDU is applied by the agent as a whole, so when one fails its checks
+ * the varbind it blames is given the error and the rest of that PDU is
+ * sent again without it (a PDU failing while being applied, with
+ * commitFailed, undoFailed or genErr, gives every varbind in it that
+ * error, as some may have been set); PDUs which are too big are split in
+ * two (and later PDUs are made no bigger).  This gives every varbind a
+ * status of its own: the SNMP error status of the PDU it was finally
+ * applied in, or SET_BATCH_UNKNOWN when no response came back for it.
+ */
+#define SET_BATCH_PENDING (-2)
+#define SET_BATCH_UNKNOWN (-1)
 
-          if (varbind) {
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
-          } else {
-            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
-          }
+typedef struct {
+  oid *name;
+  int name_len;
+  int type;
+  char *val;
+  int val_len;
+  int status;
+} set_batch_item;
 
-          vars = vars->next_variable;
-        }
+typedef struct set_batch set_batch;
 
-        py_log_msg(DEBUG,
-          "%s: Finished reading all variables from request",
-          op_name
-        );
-        notdone = 0;
-      }
+/*
+ * The varbinds sent together in one PDU, also the callback magic of that
+ * PDU; chunks in flight are orphaned (batch set to NULL) rather than freed
+ * if set_batch() gives up on them.
+ */
+typedef struct {
+  set_batch *batch;
+  int *items;
+  int num_items;
+  struct timeval sent;
+} set_batch_chunk;
+
+struct set_batch {
+  session_capsule_ctx *ctx;
+  set_batch_item *items;
+  int num_items;
+
+  /* chunks waiting to be sent */
+  set_batch_chunk **queue;
+  int queue_len;
+  int queue_size;
+
+  /* chunks sent and not yet answered, at most max_in_flight */
+  set_batch_chunk **in_flight;
+  int num_in_flight;
+
+  int chunk_len;
+};
 
-      if (op_data.response) {
-        snmp_free_pdu(op_data.response);
-        op_data.response = NULL;
-      }
-    }
-    varlist_ind++;
+static void __set_batch_chunk_free(set_batch_chunk *chunk) {
+  if (chunk) {
+    free(chunk->items);
+    free(chunk);
   }
-  goto done;
+}
 
-exception:
-  snmp_op_data_finish(&op_data);
-  return NULL;
+static void __set_batch_mark(set_batch *batch, int *items, int num_items,
+                             int status) {
+  int i;
 
-done:
-  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+  for (i = 0; i < num_items; i++) {
+    batch->items[items[i]].status = status;
+  }
+}
 
-  snmp_op_data_finish(&op_data);
+/* queue a new chunk holding a copy of items */
+static void __set_batch_queue(set_batch *batch, int *items, int num_items) {
+  set_batch_chunk *chunk = NULL;
+  set_batch_chunk **queue = NULL;
 
-  if(error) {
-    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+  if (num_items <= 0) {
+    return;
+  }
 
-    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
-      session_ctx->err_num, session_ctx->err_ind);
+  if (batch->queue_len == batch->queue_size) {
+    queue = realloc(batch->queue,
+                    (batch->queue_size * 2 + 4) * sizeof(*batch->queue));
+    if (!queue) {
+      goto fail;
+    }
+    batch->queue = queue;
+    batch->queue_size = batch->queue_size * 2 + 4;
+  }
 
-    Py_XDECREF(result_varlist);
-    return NULL;
+  if (!(chunk = malloc(sizeof(*chunk))) ||
+      !(chunk->items = malloc(num_items * sizeof(int)))) {
+    free(chunk);
+    goto fail;
   }
+  memcpy(chunk->items, items, num_items * sizeof(int));
+  chunk->num_items = num_items;
+  chunk->batch = batch;
+  batch->queue[batch->queue_len++] = chunk;
+  return;
 
-  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+fail:
+  py_log_msg(ERROR, "set_batch: could not allocate chunk");
+  __set_batch_mark(batch, items, num_items, SET_BATCH_UNKNOWN);
+}
 
-  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+static void __set_batch_read_response(set_batch *batch,
+                                      set_batch_chunk *chunk,
+                                      netsnmp_pdu *response) {
+  int half;
+  int errindex;
 
-  return Py_BuildValue("N", result_varlist);
-}
+  switch (response->errstat) {
+  case SNMP_ERR_NOERROR:
+    __set_batch_mark(batch, chunk->items, chunk->num_items,
+                     SNMP_ERR_NOERROR);
+    break;
 
-static PyObject *netsnmp_getnext(PyObject *self, PyObject *args) {
-  PyObject *session = NULL;
-  session_capsule_ctx *session_ctx = NULL;
-  snmp_op_data op_data;
-  PyObject *result_varlist = NULL;
-  netsnmp_variable_list *vars = NULL;
-  int error = 0;
-  int op_data_error = 0;
-  char *op_name = "netsnmp_getnext";
-  snmp_op_data_reset(&op_data);
+  case SNMP_ERR_TOOBIG:
+    if (chunk->num_items > 1) {
+      half = chunk->num_items / 2;
+      if (batch->chunk_len > half) {
+        batch->chunk_len = half;
+      }
+      py_log_msg(DEBUG, "set_batch: too big, splitting %d varbinds",
+                 chunk->num_items);
+      __set_batch_queue(batch, chunk->items, half);
+      __set_batch_queue(batch, chunk->items + half, chunk->num_items - half);
+      break;
+    }
+    __set_batch_mark(batch, chunk->items, chunk->num_items,
+                     SNMP_ERR_TOOBIG);
+    break;
 
-  py_log_msg(DEBUG, "%s: Starting", op_name);
+  /* errors of the checks made before anything is set (RFC 3416 4.2.5) */
+  case SNMP_ERR_NOSUCHNAME:
+  case SNMP_ERR_BADVALUE:
+  case SNMP_ERR_READONLY:
+  case SNMP_ERR_NOACCESS:
+  case SNMP_ERR_WRONGTYPE:
+  case SNMP_ERR_WRONGLENGTH:
+  case SNMP_ERR_WRONGENCODING:
+  case SNMP_ERR_WRONGVALUE:
+  case SNMP_ERR_NOCREATION:
+  case SNMP_ERR_INCONSISTENTVALUE:
+  case SNMP_ERR_RESOURCEUNAVAILABLE:
+  case SNMP_ERR_NOTWRITABLE:
+  case SNMP_ERR_INCONSISTENTNAME:
+    errindex = response->errindex;
+    if (errindex < 1 || errindex > chunk->num_items ||
+        chunk->num_items == 1) {
+      /* the agent blames the PDU as a whole */
+      __set_batch_mark(batch, chunk->items, chunk->num_items,
+                       response->errstat);
+      break;
+    }
 
-  if (!args) {
-    const char *err_msg = "%s: missing arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
-  }
+    /* nothing in the PDU was set; try again without the culprit */
+    __set_batch_mark(batch, chunk->items + errindex - 1, 1,
+                     response->errstat);
+    __set_batch_queue(batch, chunk->items, errindex - 1);
+    __set_batch_queue(batch, chunk->items + errindex,
+                      chunk->num_items - errindex);
+    break;
 
-  if (!PyArg_ParseTuple(args, "OO", &session, &op_data.varlist)) {
-    const char *err_msg = "%s: Could not parse arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  default:
+    /*
+     * commitFailed, undoFailed, genErr and the like: some of the PDU may
+     * have been applied already, so it is not sent again
+     */
+    __set_batch_mark(batch, chunk->items, chunk->num_items,
+                     response->errstat);
+    break;
   }
+}
 
-  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+static int __set_batch_callback(int operation, netsnmp_session *sp, int reqid,
+                                netsnmp_pdu *pdu, void *magic) {
+  set_batch_chunk *chunk = magic;
+  set_batch *batch = chunk->batch;
+  int i;
 
-  if (!PyList_Check(op_data.varlist)) {
-    const char *err_msg = "%s: varlist is not a list";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  if (batch) {
+    for (i = 0; i < batch->num_in_flight; i++) {
+      if (batch->in_flight[i] == chunk) {
+        batch->in_flight[i] = batch->in_flight[--batch->num_in_flight];
+        break;
+      }
+    }
+
+    if (operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+      __stats_response(&batch->ctx->stats, batch->ctx->handle, pdu,
+                       __elapsed_usec(&chunk->sent));
+      __set_batch_read_response(batch, chunk, pdu);
+    } else {
+      if (operation == NETSNMP_CALLBACK_OP_TIMED_OUT) {
+        __stats_timeout(&batch->ctx->stats, batch->ctx->handle);
+      }
+      py_log_msg(ERROR, "set_batch: no response for %d varbinds",
+                 chunk->num_items);
+      __set_batch_mark(batch, chunk->items, chunk->num_items,
+                       SET_BATCH_UNKNOWN);
+    }
   }
 
-  py_log_msg(DEBUG, "%s: Getting session context", op_name);
-  session_ctx = get_session_context(session);
+  __set_batch_chunk_free(chunk);
+  return 1;
+}
 
-  if (!session_ctx) {
-    error = 1;
-    goto done;
-  }
-  py_log_msg(DEBUG, "%s: Got session context", op_name);
+/* send queued chunks until max_in_flight PDUs are outstanding */
+static void __set_batch_send(set_batch *batch, session_capsule_ctx *ctx,
+                             int max_in_flight) {
+  set_batch_chunk *chunk = NULL;
+  set_batch_item *item = NULL;
+  netsnmp_pdu *pdu = NULL;
+  char *tmp_err_str = NULL;
+  int i;
 
-  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
-  op_data.op_name = op_name;
-  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+  while (batch->queue_len > 0 && batch->num_in_flight < max_in_flight) {
+    chunk = batch->queue[--batch->queue_len];
 
-  if (op_data_error || PyErr_Occurred()) {
-    if(PyErr_Occurred()) {
-      goto exception;
+    /* no bigger than the agent has shown it will accept */
+    if (chunk->num_items > batch->chunk_len) {
+      __set_batch_queue(batch, chunk->items + batch->chunk_len,
+                        chunk->num_items - batch->chunk_len);
+      chunk->num_items = batch->chunk_len;
     }
 
-    error = 1;
-    goto done;
+    pdu = snmp_pdu_create(SNMP_MSG_SET);
+    for (i = 0; i < chunk->num_items; i++) {
+      item = &batch->items[chunk->items[i]];
+      if (__add_var_val_str(pdu, item->name, item->name_len, item->val,
+                            item->val_len, item->type) == FAILURE) {
+        py_log_msg(ERROR, "set_batch: adding variable/value to PDU");
+      }
+    }
+
+    netsnmp_get_monotonic_clock(&chunk->sent);
+    if (!snmp_sess_async_send(ctx->handle, pdu, __set_batch_callback,
+                              chunk)) {
+      snmp_sess_error(ctx->handle, &ctx->err_num, &ctx->err_ind,
+                      &tmp_err_str);
+      py_log_msg(ERROR, "set_batch: send failed: %s",
+                 tmp_err_str ? tmp_err_str : "unknown error");
+      if (tmp_err_str) {
+        strlcpy(ctx->err_str, tmp_err_str, sizeof(ctx->err_str));
+      }
+      SAFE_FREE(tmp_err_str);
+      snmp_free_pdu(pdu);
+      __set_batch_mark(batch, chunk->items, chunk->num_items,
+                       SET_BATCH_UNKNOWN);
+      __set_batch_chunk_free(chunk);
+      continue;
+    }
+
+    batch->in_flight[batch->num_in_flight++] = chunk;
+    ctx->stats.pdus_sent++;
   }
-  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+}
 
-  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+/*
+ * Wait for responses on the session, letting Net-SNMP run the callbacks
+ * of whatever arrives and retransmit or expire whatever is overdue.
+ *
+ * returns : 0, or -1 with a Python exception set
+ */
+static int __async_session_wait(session_capsule_ctx *ctx,
+                            netsnmp_large_fd_set *fdset) {
+  netsnmp_transport *transport = snmp_sess_transport(ctx->handle);
+  struct pollfd pfd;
+  struct timeval timeout;
+  int numfds = 0;
+  int block = 0;
+  int ready;
+  int ms;
+
+  timeout.tv_sec = 1;
+  timeout.tv_usec = 0;
+  snmp_sess_select_info2(ctx->handle, &numfds, fdset, &timeout, &block);
+  ms = timeout.tv_sec * 1000 + (timeout.tv_usec + 999) / 1000;
+
+  pfd.fd = transport ? transport->sock : -1;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
 
-  result_varlist = PyList_New(0);
-  PyObject * varbind = NULL;
-  int notdone = 0;
-  int status = 0;
-  int varlist_ind = 0;
-  int varlist_len = op_data.varlist_len;
+  Py_BEGIN_ALLOW_THREADS
+  ready = poll(&pfd, 1, ms);
+  Py_END_ALLOW_THREADS
+
+  if (ready < 0) {
+    if (errno == EINTR) {
+      return PyErr_CheckSignals();
+    }
+    PyErr_SetFromErrno(PyExc_OSError);
+    return -1;
+  }
+
+  if (ready > 0 && pfd.revents) {
+    NETSNMP_LARGE_FD_ZERO(fdset);
+    NETSNMP_LARGE_FD_SET(pfd.fd, fdset);
+    snmp_sess_read2(ctx->handle, fdset);
+  }
 
-  while (varlist_ind < varlist_len) {
-    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
-    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+  snmp_sess_timeout(ctx->handle);
+  return 0;
+}
 
-    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
-                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
-                op_data.op_name,
-                op_data.oid_str_arr[varlist_ind],
-                op_data.oid_idx_str_arr[varlist_ind],
-                op_data.oid_arr_len[varlist_ind],
-                session_ctx->best_guess);
+static PyObject *netsnmp_set_batch(PyObject *self, PyObject *args) {
+  PyObject *session = NULL;
+  PyObject *varlist = NULL;
+  PyObject *varbind = NULL;
+  PyObject *result = NULL;
+  PyObject *status = NULL;
+  session_capsule_ctx *session_ctx = NULL;
+  netsnmp_large_fd_set fdset;
+  set_batch batch;
+  set_batch_item *item = NULL;
+  oid oid_arr[MAX_OID_LEN];
+  u_char val_buf[STR_BUF_SIZE];
+  int *all_items = NULL;
+  int max_in_flight = 4;
+  int max_varbinds = 0;
+  int use_enums;
+  int best_guess;
+  int i;
 
-    notdone = 1;
-    while (notdone) {
-      py_log_msg(DEBUG, "%s: Sending pdu req",
-        op_data.op_name);
+  memset(&batch, 0, sizeof(batch));
 
-      status = send_pdu_request(session_ctx, &op_data);
-      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+  if (!PyArg_ParseTuple(args, "OO|ii", &session, &varlist, &max_in_flight,
+                        &max_varbinds)) {
+    return NULL;
+  }
 
-        if(PyErr_Occurred()) {
-          goto exception;
-        }
+  if (!PyList_Check(varlist)) {
+    PyErr_SetString(PyExc_ValueError, "set_batch: varlist is not a list");
+    return NULL;
+  }
 
-        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
-          op_data.op_name, status);
-        error = 1;
-        goto done;
-      }
+  if (!(session_ctx = get_session_context(session))) {
+    return NULL;
+  }
 
-      if (notdone) {
-        vars = op_data.response->variables;
-        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+  if (max_in_flight <= 0) {
+    max_in_flight = 1;
+  }
 
-        while (vars) {
+  batch.ctx = session_ctx;
+  use_enums = py_netsnmp_attr_long(session, "use_enums");
+  best_guess = session_ctx->best_guess;
 
-          if (vars->type == SNMP_ENDOFMIBVIEW) {
-            py_log_msg(DEBUG, "%s: encountered end condition "
-                              "(ENDOFMIBVIEW)", op_name);
-            notdone = 0;
-            break;
-          }
-          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
-          (vars->type == SNMP_NOSUCHINSTANCE)) {
-            char val_type_str[MAX_TYPE_NAME_LEN];
+  batch.num_items = PyList_GET_SIZE(varlist);
+  batch.items = PyMem_New(set_batch_item, batch.num_items);
+  all_items = PyMem_New(int, batch.num_items);
+  batch.in_flight = PyMem_New(set_batch_chunk *, max_in_flight);
+  if (!batch.items || !all_items || !batch.in_flight) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  memset(batch.items, 0, batch.num_items * sizeof(set_batch_item));
 
-            __get_type_str(vars->type, val_type_str, 1);
-            varbind = py_netsnmp_construct_varbind();
+  /* translate and encode every varbind up front */
+  for (i = 0; i < batch.num_items; i++) {
+    varbind = PyList_GET_ITEM(varlist, i);
+    item = &batch.items[i];
+    if (__load_set_varbind(varbind, use_enums, best_guess, oid_arr,
+                           &item->name_len, &item->type, val_buf,
+                           &item->val_len) < 0) {
+      goto done;
+    }
 
-            py_netsnmp_attr_set_string(varbind, "root_oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "snmp_type", val_type_str,
-                                       strlen(val_type_str));
+    item->name = PyMem_New(oid, item->name_len);
+    item->val = PyMem_New(char, item->val_len + 1);
+    if (!item->name || !item->val) {
+      PyErr_NoMemory();
+      goto done;
+    }
+    memcpy(item->name, oid_arr, item->name_len * sizeof(oid));
+    memcpy(item->val, val_buf, item->val_len + 1);
+    item->status = SET_BATCH_PENDING;
+    all_items[i] = i;
+  }
 
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
+  /*
+   * every varbind goes in the first PDU unless limited, tooBig responses
+   * then finding what the agent accepts
+   */
+  batch.chunk_len = max_varbinds;
+  if (batch.chunk_len <= 0 || batch.chunk_len > batch.num_items) {
+    batch.chunk_len = batch.num_items > 0 ? batch.num_items : 1;
+  }
 
-            notdone = 0;
-            break;
-          }
-          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
-              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
-                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
-            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
-              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
-              sizeof(op_data.oid_arr[varlist_ind]),
-              sizeof(vars->name)
-            );
-            notdone = 0;
-            break;
-          }
+  py_log_msg(DEBUG, "set_batch: setting %d varbinds, %d per PDU",
+             batch.num_items, batch.chunk_len);
 
-          varbind = read_variable(vars, &op_data, session_ctx->getlabel_flag, session_ctx->sprintval_flag);
+  __set_batch_queue(&batch, all_items, batch.num_items);
 
-          if (varbind) {
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
-          } else {
-            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
-          }
+  netsnmp_large_fd_set_init(&fdset, FD_SETSIZE);
+  while (!PyErr_Occurred()) {
+    __set_batch_send(&batch, session_ctx, max_in_flight);
+    if (batch.num_in_flight == 0) {
+      break;
+    }
+    if (__async_session_wait(session_ctx, &fdset) < 0) {
+      break;
+    }
+  }
+  netsnmp_large_fd_set_cleanup(&fdset);
 
-          vars = vars->next_variable;
-        }
+  if (PyErr_Occurred()) {
+    goto done;
+  }
 
-        py_log_msg(DEBUG,
-          "%s: Finished reading all variables from request",
-          op_name
-        );
-        notdone = 0;
-      }
+  __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+                                     session_ctx->err_num,
+                                     session_ctx->err_ind);
 
-      if (op_data.response) {
-        snmp_free_pdu(op_data.response);
-        op_data.response = NULL;
-      }
+  if (!(result = PyList_New(batch.num_items))) {
+    goto done;
+  }
+  for (i = 0; i < batch.num_items; i++) {
+    if (batch.items[i].status < 0) {
+      Py_INCREF(Py_None);
+      status = Py_None;
+    } else if (!(status = PyLong_FromLong(batch.items[i].status))) {
+      Py_CLEAR(result);
+      goto done;
     }
-    varlist_ind++;
+    PyList_SET_ITEM(result, i, status);
   }
-  goto done;
-
-exception:
-  snmp_op_data_finish(&op_data);
-  return NULL;
 
 done:
-  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+  /* anything still in flight will be freed by its callback */
+  for (i = 0; i < batch.queue_len; i++) {
+    __set_batch_chunk_free(batch.queue[i]);
+  }
+  free(batch.queue);
+  for (i = 0; i < batch.num_in_flight; i++) {
+    batch.in_flight[i]->batch = NULL;
+  }
+  PyMem_Free(batch.in_flight);
+  for (i = 0; batch.items && i < batch.num_items; i++) {
+    PyMem_Free(batch.items[i].name);
+    PyMem_Free(batch.items[i].val);
+  }
+  PyMem_Free(batch.items);
+  PyMem_Free(all_items);
 
-  snmp_op_data_finish(&op_data);
+  return result;
+}
 
-  if(error) {
-    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+/*
+ * Pipelined walk.
+ *
+ * walk_pipelined() splits the subtree under an OID into ranges at a set of
+ * bounds and walks every range with a GETNEXT chain of its own, keeping
+ * up to max_in_flight of those chains in flight at once, so that a walk
+ * of an SNMPv1 agent (which has no GETBULK) over a slow link takes a
+ * fraction of the round trips.  Chain i walks from bound i (exclusive)
+ * up to and including bound i + 1; the last chain walks to the end of the
+ * subtree.  As the ranges are in order, so are the chains' results once
+ * joined together.
+ *
+ * The bounds are given by the caller (e.g. learned from the results of an
+ * earlier walk), or else taken from the MIB: the columns of a table, or
+ * the children of any other node, further split at integer indexes when
+ * the number of rows is hinted.
+ */
+#define WALK_CHAIN_READY (0)
+#define WALK_CHAIN_SENT (1)
+#define WALK_CHAIN_DONE (2)
 
-    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
-      session_ctx->err_num, session_ctx->err_ind);
+typedef struct {
+  oid name[MAX_OID_LEN];
+  size_t name_len;
+} walk_bound;
 
-    Py_XDECREF(result_varlist);
-    return NULL;
-  }
+typedef struct pipelined_walk pipelined_walk;
 
-  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+/*
+ * The callback magic of the request of a chain in flight; orphaned (walk
+ * set to NULL) rather than freed if walk_pipelined() gives up on it.
+ */
+typedef struct {
+  pipelined_walk *walk;
+  int chain;
+  struct timeval sent;
+} walk_chain_ticket;
 
-  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+typedef struct {
+  oid name[MAX_OID_LEN]; /* the last OID walked */
+  size_t name_len;
+  walk_bound *end; /* NULL for the last chain */
+  PyObject *result;
+  walk_chain_ticket *ticket;
+  int state;
+} walk_chain;
+
+struct pipelined_walk {
+  session_capsule_ctx *ctx;
+  snmp_op_data *data;
+  oid *root;
+  size_t root_len;
+
+  walk_bound *bounds;
+  int num_bounds;
+  int bounds_size;
+
+  walk_chain *chains;
+  int num_chains;
+  int num_in_flight;
+
+  /* why the walk failed, if it did */
+  PyObject *error_type;
+  const char *error_msg;
+};
 
-  return Py_BuildValue("N", result_varlist);
+static int __compare_walk_bounds(const void *a, const void *b) {
+  const walk_bound *x = a;
+  const walk_bound *y = b;
+  return snmp_oid_compare(x->name, x->name_len, y->name, y->name_len);
 }
 
-static PyObject *netsnmp_walk(PyObject *self, PyObject *args) {
-  PyObject *session = NULL;
-  session_capsule_ctx *session_ctx = NULL;
-  snmp_op_data op_data;
-  PyObject *result_varlist = NULL;
-  netsnmp_variable_list *vars = NULL;
-  int error = 0;
-  int op_data_error = 0;
-  char *op_name = "netsnmp_walk";
-  snmp_op_data_reset(&op_data);
+/* add a bound of prefix followed by arc (if not negative) */
+static int __walk_add_bound(pipelined_walk *walk, oid *prefix,
+                            size_t prefix_len, long arc) {
+  walk_bound *bound = NULL;
+  walk_bound *bounds = NULL;
 
-  py_log_msg(DEBUG, "%s: Starting", op_name);
+  if (prefix_len + (arc >= 0) > MAX_OID_LEN) {
+    return 0;
+  }
 
-  if (!args) {
-    const char *err_msg = "%s: missing arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  if (walk->num_bounds == walk->bounds_size) {
+    bounds = PyMem_Resize(walk->bounds, walk_bound,
+                          walk->bounds_size * 2 + 8);
+    if (!bounds) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    walk->bounds = bounds;
+    walk->bounds_size = walk->bounds_size * 2 + 8;
   }
 
-  if (!PyArg_ParseTuple(args, "OO", &session, &op_data.varlist)) {
-    const char *err_msg = "%s: Could not parse arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  bound = &walk->bounds[walk->num_bounds++];
+  memcpy(bound->name, prefix, prefix_len * sizeof(oid));
+  bound->name_len = prefix_len;
+  if (arc >= 0) {
+    bound->name[bound->name_len++] = (oid)arc;
   }
 
-  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+  return 0;
+}
 
-  if (!PyList_Check(op_data.varlist)) {
-    const char *err_msg = "%s: varlist is not a list";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
-  }
+/* the MIB node of exactly name, if there is one */
+static struct tree *__mib_node(oid *name, size_t name_len) {
+  struct tree *tp = NULL;
+  struct tree *parent = NULL;
+  size_t depth = 0;
 
-  py_log_msg(DEBUG, "%s: Getting session context", op_name);
-  session_ctx = get_session_context(session);
+  if (!name_len || !(tp = get_tree(name, name_len, get_tree_head()))) {
+    return NULL;
+  }
 
-  if (!session_ctx) {
-    error = 1;
-    goto done;
+  for (parent = tp; parent; parent = parent->parent) {
+    depth++;
   }
-  py_log_msg(DEBUG, "%s: Got session context", op_name);
 
-  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
-  op_data.op_name = op_name;
-  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+  return (depth == name_len && tp->subid == name[name_len - 1]) ? tp : NULL;
+}
 
-  if (op_data_error || PyErr_Occurred()) {
-    if(PyErr_Occurred()) {
-      goto exception;
-    }
+/* split the rows under prefix (a column) into pieces at integer indexes */
+static int __walk_add_row_bounds(pipelined_walk *walk, oid *prefix,
+                                 size_t prefix_len, long rows, int pieces) {
+  int i;
 
-    error = 1;
-    goto done;
+  for (i = 1; i < pieces; i++) {
+    if (__walk_add_bound(walk, prefix, prefix_len,
+                         (long)((double)rows * i / pieces)) < 0) {
+      return -1;
+    }
   }
-  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
 
-  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+  return 0;
+}
 
-  result_varlist = PyList_New(0);
-  PyObject * varbind = NULL;
-  int notdone = 0;
-  int status = 0;
-  int varlist_ind = 0;
-  int varlist_len = op_data.varlist_len;
+/*
+ * Bound the ranges at the columns of the table (or children of the node)
+ * at the root of the walk, as long as the MIB knows of it.  No bound is
+ * put at the first child, as the range from the root up to it would hold
+ * nothing and cost a request for no variables.
+ */
+static int __walk_mib_bounds(pipelined_walk *walk, long rows,
+                             int max_in_flight) {
+  oid prefix[MAX_OID_LEN];
+  size_t prefix_len = walk->root_len;
+  struct tree *tp = __mib_node(walk->root, walk->root_len);
+  struct tree *child = NULL;
+  u_long first_subid = 0;
+  int num_children = 0;
+  int pieces;
+
+  if (!tp) {
+    return 0;
+  }
 
-  while (varlist_ind < varlist_len) {
-    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
-    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+  memcpy(prefix, walk->root, prefix_len * sizeof(oid));
 
-    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
-                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
-                op_data.op_name,
-                op_data.oid_str_arr[varlist_ind],
-                op_data.oid_idx_str_arr[varlist_ind],
-                op_data.oid_arr_len[varlist_ind],
-                session_ctx->best_guess);
+  /* look through the entry of a table to its columns */
+  if (tp->child_list && !tp->child_list->next_peer &&
+      tp->child_list->child_list && prefix_len < MAX_OID_LEN) {
+    tp = tp->child_list;
+    prefix[prefix_len++] = tp->subid;
+  }
 
-    notdone = 1;
-    while (notdone) {
-      py_log_msg(DEBUG, "%s: Sending pdu req",
-        op_data.op_name);
+  for (child = tp->child_list; child; child = child->next_peer) {
+    if (!num_children || child->subid < first_subid) {
+      first_subid = child->subid;
+    }
+    num_children++;
+  }
 
-      status = send_pdu_request(session_ctx, &op_data);
-      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+  if (!num_children) {
+    /* a column of its own */
+    return rows > 0 ? __walk_add_row_bounds(walk, prefix, prefix_len, rows,
+                                            max_in_flight)
+                    : 0;
+  }
 
-        if(PyErr_Occurred()) {
-          goto exception;
-        }
+  pieces = (max_in_flight + num_children - 1) / num_children;
 
-        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
-          op_data.op_name, status);
-        error = 1;
-        goto done;
+  for (child = tp->child_list; child; child = child->next_peer) {
+    if (child->subid != first_subid &&
+        __walk_add_bound(walk, prefix, prefix_len, (long)child->subid) < 0) {
+      return -1;
+    }
+
+    if (rows > 0 && pieces > 1 && prefix_len + 1 < MAX_OID_LEN) {
+      prefix[prefix_len] = child->subid;
+      if (__walk_add_row_bounds(walk, prefix, prefix_len + 1, rows,
+                                pieces) < 0) {
+        return -1;
       }
+    }
+  }
 
-      if (notdone) {
-        vars = op_data.response->variables;
-        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+  return 0;
+}
 
-        while (vars) {
+/* sort the bounds, dropping duplicates and any outside the subtree */
+static void __walk_sort_bounds(pipelined_walk *walk) {
+  walk_bound *bound = NULL;
+  int num_bounds = 0;
+  int i;
 
-          if (vars->type == SNMP_ENDOFMIBVIEW) {
-            py_log_msg(DEBUG, "%s: encountered end condition "
-                              "(ENDOFMIBVIEW)", op_name);
-            notdone = 0;
-            break;
-          }
-          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
-          (vars->type == SNMP_NOSUCHINSTANCE)) {
-            char val_type_str[MAX_TYPE_NAME_LEN];
+  qsort(walk->bounds, walk->num_bounds, sizeof(walk_bound),
+        __compare_walk_bounds);
+
+  for (i = 0; i < walk->num_bounds; i++) {
+    bound = &walk->bounds[i];
+    if (bound->name_len <= walk->root_len ||
+        memcmp(bound->name, walk->root, walk->root_len * sizeof(oid)) != 0) {
+      continue;
+    }
+    if (num_bounds > 0 &&
+        __compare_walk_bounds(&walk->bounds[num_bounds - 1], bound) == 0) {
+      continue;
+    }
+    walk->bounds[num_bounds++] = *bound;
+  }
+  walk->num_bounds = num_bounds;
+}
 
-            __get_type_str(vars->type, val_type_str, 1);
-            varbind = py_netsnmp_construct_varbind();
+static void __walk_fail(pipelined_walk *walk, PyObject *error_type,
+                        const char *msg) {
+  int i;
 
-            py_netsnmp_attr_set_string(varbind, "root_oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "snmp_type", val_type_str,
-                                       strlen(val_type_str));
+  if (!walk->error_type) {
+    walk->error_type = error_type;
+    walk->error_msg = msg;
+  }
 
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
+  for (i = 0; i < walk->num_chains; i++) {
+    if (walk->chains[i].state == WALK_CHAIN_READY) {
+      walk->chains[i].state = WALK_CHAIN_DONE;
+    }
+  }
+}
 
-            notdone = 0;
-            break;
-          }
-          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
-              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
-                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
-            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
-              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
-              sizeof(op_data.oid_arr[varlist_ind]),
-              sizeof(vars->name)
-            );
-            notdone = 0;
-            break;
-          }
+static void __walk_read_response(pipelined_walk *walk, walk_chain *chain,
+                                 netsnmp_pdu *response) {
+  netsnmp_variable_list *vars = response->variables;
+  PyObject *varbind = NULL;
 
-          varbind = read_variable(vars, &op_data, session_ctx->getlabel_flag, session_ctx->sprintval_flag);
+  chain->state = WALK_CHAIN_DONE;
 
-          if (varbind) {
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
-          } else {
-            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
-          }
+  if (response->errstat == SNMP_ERR_NOSUCHNAME) {
+    /* how an SNMPv1 agent tells us we walked off the end of its MIB */
+    return;
+  } else if (response->errstat != SNMP_ERR_NOERROR) {
+    __walk_fail(walk, EasySNMPError, snmp_errstring(response->errstat));
+    return;
+  }
 
-          // Create next request if we've reached the end
-          if (vars->next_variable == NULL) {
-            op_data.pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
-            snmp_add_null_var(op_data.pdu, vars->name, vars->name_length);
-            py_log_msg(DEBUG,
-              "%s: Creating pdu request for %s",
-              op_name, op_data.initial_oid
-            );
-          }
+  if (!vars || vars->type == SNMP_ENDOFMIBVIEW ||
+      vars->type == SNMP_NOSUCHOBJECT || vars->type == SNMP_NOSUCHINSTANCE) {
+    return;
+  }
 
-          // Move on to next
-          vars = vars->next_variable;
-        }
+  if (vars->name_length < walk->root_len ||
+      memcmp(walk->root, vars->name, walk->root_len * sizeof(oid)) != 0) {
+    return;
+  }
 
-        py_log_msg(DEBUG,
-          "%s: Partially finished reading all variables from request for %s",
-          op_name, op_data.initial_oid
-        );
-      }
+  if (chain->end && snmp_oid_compare(vars->name, vars->name_length,
+                                     chain->end->name,
+                                     chain->end->name_len) > 0) {
+    /* the next chain's range */
+    return;
+  }
 
-      if (op_data.response) {
-        snmp_free_pdu(op_data.response);
-        op_data.response = NULL;
-        py_log_msg(DEBUG,
-          "%s: Finished reading all variables from request for %s",
-          op_name, op_data.initial_oid
-        );
-      }
-    }
-    varlist_ind++;
+  if (snmp_oid_compare(vars->name, vars->name_length, chain->name,
+                       chain->name_len) <= 0) {
+    py_log_msg(ERROR, "%s: OID not increasing, ending its chain",
+               walk->data->op_name);
+    return;
   }
 
-  py_log_msg(DEBUG, "%s: Finished reading all variables",op_name);
-  goto done;
+  memcpy(chain->name, vars->name, vars->name_length * sizeof(oid));
+  chain->name_len = vars->name_length;
 
-exception:
-  snmp_op_data_finish(&op_data);
-  return NULL;
+  varbind = read_variable(vars, walk->data, walk->ctx);
+  if (!varbind || PyList_Append(chain->result, varbind) < 0) {
+    Py_XDECREF(varbind);
+    return;
+  }
+  Py_DECREF(varbind);
 
-done:
-  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+  chain->state = WALK_CHAIN_READY;
+}
 
-  snmp_op_data_finish(&op_data);
+static int __walk_callback(int operation, netsnmp_session *sp, int reqid,
+                           netsnmp_pdu *pdu, void *magic) {
+  walk_chain_ticket *ticket = magic;
+  pipelined_walk *walk = ticket->walk;
+  walk_chain *chain = NULL;
+
+  if (walk) {
+    chain = &walk->chains[ticket->chain];
+    chain->ticket = NULL;
+    walk->num_in_flight--;
+
+    if (operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+      __stats_response(&walk->ctx->stats, walk->ctx->handle, pdu,
+                       __elapsed_usec(&ticket->sent));
+      __walk_read_response(walk, chain, pdu);
+    } else {
+      chain->state = WALK_CHAIN_DONE;
+      if (operation == NETSNMP_CALLBACK_OP_TIMED_OUT) {
+        __stats_timeout(&walk->ctx->stats, walk->ctx->handle);
+        py_log_msg(ERROR, "%s: timed out", walk->data->op_name);
+        __walk_fail(walk, EasySNMPTimeoutError,
+                    "timed out while connecting to remote host");
+      } else {
+        __walk_fail(walk, EasySNMPError, "failed to send request");
+      }
+    }
+  }
 
-  if(error) {
-    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+  free(ticket);
+  return 1;
+}
 
-    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
-      session_ctx->err_num, session_ctx->err_ind);
+/* send the next GETNEXT of ready chains until max_in_flight are out */
+static void __walk_send(pipelined_walk *walk, int max_in_flight) {
+  session_capsule_ctx *ctx = walk->ctx;
+  walk_chain_ticket *ticket = NULL;
+  walk_chain *chain = NULL;
+  netsnmp_pdu *pdu = NULL;
+  char *tmp_err_str = NULL;
+  int i;
 
-    Py_XDECREF(result_varlist);
-    return NULL;
+  /* let whatever is in flight come back, but send nothing more */
+  if (walk->error_type) {
+    return;
   }
 
-  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+  for (i = 0; i < walk->num_chains && walk->num_in_flight < max_in_flight;
+       i++) {
+    chain = &walk->chains[i];
+    if (chain->state != WALK_CHAIN_READY) {
+      continue;
+    }
 
-  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+    if (!(ticket = malloc(sizeof(*ticket)))) {
+      __walk_fail(walk, PyExc_MemoryError, "could not allocate request");
+      return;
+    }
+    ticket->walk = walk;
+    ticket->chain = i;
+
+    pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
+    snmp_add_null_var(pdu, chain->name, chain->name_len);
+
+    netsnmp_get_monotonic_clock(&ticket->sent);
+    if (!snmp_sess_async_send(ctx->handle, pdu, __walk_callback, ticket)) {
+      snmp_sess_error(ctx->handle, &ctx->err_num, &ctx->err_ind,
+                      &tmp_err_str);
+      py_log_msg(ERROR, "%s: send failed: %s", walk->data->op_name,
+                 tmp_err_str ? tmp_err_str : "unknown error");
+      if (tmp_err_str) {
+        strlcpy(ctx->err_str, tmp_err_str, sizeof(ctx->err_str));
+      }
+      SAFE_FREE(tmp_err_str);
+      snmp_free_pdu(pdu);
+      free(ticket);
+      __walk_fail(walk, EasySNMPError, "failed to send request");
+      return;
+    }
 
-  return Py_BuildValue("N", result_varlist);
+    chain->ticket = ticket;
+    chain->state = WALK_CHAIN_SENT;
+    walk->num_in_flight++;
+    ctx->stats.pdus_sent++;
+  }
 }
 
-static PyObject *netsnmp_getbulk(PyObject *self, PyObject *args) {
+static PyObject *netsnmp_walk_pipelined(PyObject *self, PyObject *args) {
   PyObject *session = NULL;
+  PyObject *result = NULL;
   session_capsule_ctx *session_ctx = NULL;
+  netsnmp_large_fd_set fdset;
   snmp_op_data op_data;
-  PyObject *result_varlist = NULL;
-  netsnmp_variable_list *vars = NULL;
-  int error = 0;
-  int op_data_error = 0;
-  char *op_name = "netsnmp_getbulk";
-  int nonrepeaters;
-  int maxrepetitions;
+  pipelined_walk walk;
+  walk_chain *chain = NULL;
+  int max_in_flight = 4;
+  long rows = 0;
+  int i;
 
   snmp_op_data_reset(&op_data);
+  memset(&walk, 0, sizeof(walk));
 
-  py_log_msg(DEBUG, "%s: Starting", op_name);
+  if (!PyArg_ParseTuple(args, "OO|il", &session, &op_data.varlist,
+                        &max_in_flight, &rows)) {
+    return NULL;
+  }
 
-  if (!args) {
-    const char *err_msg = "%s: missing arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  if (!PyList_Check(op_data.varlist) ||
+      PyList_GET_SIZE(op_data.varlist) < 1) {
+    PyErr_SetString(PyExc_ValueError,
+                    "walk_pipelined: varlist is not a non-empty list");
+    return NULL;
   }
 
-  if (!PyArg_ParseTuple(args, "OOii", &session, &op_data.varlist, &nonrepeaters,
-                        &maxrepetitions)) {
-    const char *err_msg = "%s: Could not parse arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  if (!(session_ctx = get_session_context(session))) {
+    return NULL;
   }
 
-  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+  if (max_in_flight <= 0) {
+    max_in_flight = 1;
+  }
 
-  if (!PyList_Check(op_data.varlist)) {
-    const char *err_msg = "%s: varlist is not a list";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  op_data.op_name = "walk_pipelined";
+  snmp_op_data_use_arena(&op_data, session_ctx);
+  if (snmp_op_data_load(&op_data, session_ctx->best_guess) ||
+      PyErr_Occurred()) {
+    goto done;
   }
+  op_data.initial_oid = op_data.initial_oid_str_arr[0];
 
-  py_log_msg(DEBUG, "%s: Getting session context", op_name);
-  session_ctx = get_session_context(session);
+  walk.ctx = session_ctx;
+  walk.data = &op_data;
+  walk.root = op_data.oid_arr[0];
+  walk.root_len = op_data.oid_arr_len[0];
 
-  if (!session_ctx) {
-    error = 1;
+  /* the rest of the varlist bounds the ranges */
+  for (i = 1; i < op_data.varlist_len; i++) {
+    if (__walk_add_bound(&walk, op_data.oid_arr[i], op_data.oid_arr_len[i],
+                         -1) < 0) {
+      goto done;
+    }
+  }
+  if (op_data.varlist_len == 1 &&
+      __walk_mib_bounds(&walk, rows, max_in_flight) < 0) {
     goto done;
   }
-  py_log_msg(DEBUG, "%s: Got session context", op_name);
+  __walk_sort_bounds(&walk);
 
-  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
-  op_data.op_name = op_name;
-  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+  walk.num_chains = walk.num_bounds + 1;
+  if (!(walk.chains = PyMem_New(walk_chain, walk.num_chains))) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  memset(walk.chains, 0, walk.num_chains * sizeof(walk_chain));
 
-  if (op_data_error || PyErr_Occurred()) {
-    if(PyErr_Occurred()) {
-      goto exception;
+  for (i = 0; i < walk.num_chains; i++) {
+    chain = &walk.chains[i];
+    if (i == 0) {
+      memcpy(chain->name, walk.root, walk.root_len * sizeof(oid));
+      chain->name_len = walk.root_len;
+    } else {
+      memcpy(chain->name, walk.bounds[i - 1].name,
+             walk.bounds[i - 1].name_len * sizeof(oid));
+      chain->name_len = walk.bounds[i - 1].name_len;
+    }
+    chain->end = (i < walk.num_bounds) ? &walk.bounds[i] : NULL;
+    chain->state = WALK_CHAIN_READY;
+    if (!(chain->result = PyList_New(0))) {
+      goto done;
     }
+  }
 
-    error = 1;
+  py_log_msg(DEBUG, "%s: walking %s in %d chains, %d at a time",
+             op_data.op_name, op_data.initial_oid, walk.num_chains,
+             max_in_flight);
+
+  netsnmp_large_fd_set_init(&fdset, FD_SETSIZE);
+  while (!PyErr_Occurred()) {
+    __walk_send(&walk, max_in_flight);
+    if (walk.num_in_flight == 0) {
+      break;
+    }
+    if (__async_session_wait(session_ctx, &fdset) < 0) {
+      break;
+    }
+  }
+  netsnmp_large_fd_set_cleanup(&fdset);
+
+  if (PyErr_Occurred()) {
     goto done;
   }
-  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
 
-  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+  __py_netsnmp_update_session_errors(session, session_ctx->err_str,
+                                     session_ctx->err_num,
+                                     session_ctx->err_ind);
 
-  result_varlist = PyList_New(0);
-  PyObject * varbind = NULL;
-  int notdone = 0;
-  int status = 0;
-  int varlist_ind = 0;
-  int varlist_len = op_data.varlist_len;
+  if (walk.error_type) {
+    PyErr_SetString(walk.error_type, walk.error_msg);
+    goto done;
+  }
 
-  while (varlist_ind < varlist_len) {
-    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
-    op_data.pdu->non_repeaters = nonrepeaters;
-    op_data.pdu->max_repetitions = maxrepetitions;
-    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+  if (!(result = PyList_New(0))) {
+    goto done;
+  }
+  for (i = 0; i < walk.num_chains; i++) {
+    chain = &walk.chains[i];
+    if (PyList_SetSlice(result, PyList_GET_SIZE(result),
+                        PyList_GET_SIZE(result), chain->result) < 0) {
+      Py_CLEAR(result);
+      goto done;
+    }
+  }
 
-    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
-                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
-                op_data.op_name,
-                op_data.oid_str_arr[varlist_ind],
-                op_data.oid_idx_str_arr[varlist_ind],
-                op_data.oid_arr_len[varlist_ind],
-                session_ctx->best_guess);
+done:
+  /* anything still in flight will be freed by its callback */
+  for (i = 0; walk.chains && i < walk.num_chains; i++) {
+    if (walk.chains[i].ticket) {
+      walk.chains[i].ticket->walk = NULL;
+    }
+    Py_XDECREF(walk.chains[i].result);
+  }
+  PyMem_Free(walk.chains);
+  PyMem_Free(walk.bounds);
+  snmp_op_data_finish(&op_data);
 
-    notdone = 1;
-    while (notdone) {
-      py_log_msg(DEBUG, "%s: Sending pdu req",
-        op_data.op_name);
+  return result;
+}
 
-      status = send_pdu_request(session_ctx, &op_data);
-      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+/*
+ * Counter rates.
+ *
+ * A CounterTable remembers the last raw value, type and time of every
+ * COUNTER and COUNTER64 it is given, keyed by agent and OID, so that each
+ * poll of the same counters can be turned straight into deltas and rates.
+ * A Counter32 which went backwards is taken to have wrapped once, unless
+ * the wrapped delta would be at least half its range, which (like a
+ * Counter64 going backwards or a change of type) is taken to be a
+ * discontinuity such as the agent restarting.
+ */
+#define COUNTER_MAX_KEY (1024)
+#define COUNTER32_RANGE (4294967296ULL)
 
-        if(PyErr_Occurred()) {
-          goto exception;
-        }
+typedef struct {
+  unsigned long long value;
+  double timestamp;
+  int type; /* TYPE_COUNTER or TYPE_COUNTER64, 0 after a discontinuity */
+} counter_state;
 
-        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
-          op_data.op_name, status);
-        error = 1;
-        goto done;
-      }
+typedef struct {
+  PyObject_HEAD
+  simple_hashtable counters;
+} counter_table;
 
-      if (notdone) {
-        vars = op_data.response->variables;
-        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+static PyTypeObject counter_table_type;
 
-        while (vars) {
+static void counter_table_dealloc(counter_table *table) {
+  simple_hashtable_free(&table->counters);
+  PyObject_Del(table);
+}
 
-          if (vars->type == SNMP_ENDOFMIBVIEW) {
-            py_log_msg(DEBUG, "%s: encountered end condition "
-                              "(ENDOFMIBVIEW)", op_name);
-            notdone = 0;
-            break;
-          }
-          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
-          (vars->type == SNMP_NOSUCHINSTANCE)) {
-            char val_type_str[MAX_TYPE_NAME_LEN];
+static Py_ssize_t counter_table_length(counter_table *table) {
+  return (Py_ssize_t)table->counters.count;
+}
+
+static PySequenceMethods counter_table_as_sequence = {
+    (lenfunc)counter_table_length, /* sq_length */
+};
+
+static PyTypeObject counter_table_type = {
+    PyVarObject_HEAD_INIT(NULL, 0) "easysnmp.interface.CounterTable",
+    sizeof(counter_table),                    /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)counter_table_dealloc,        /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &counter_table_as_sequence,               /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    "last values of polled counters by agent and OID", /* tp_doc */
+};
+
+/* a new reference to field field_ind of an SNMPVariable */
+static PyObject *__varbind_field(PyObject *varbind, int field_ind) {
+  PyObject *field = NULL;
+
+  if (PyObject_TypeCheck(varbind, &varbind_base_type)) {
+    field = ((varbind_object *)varbind)->fields[field_ind];
+    Py_XINCREF(field);
+    return field;
+  }
+
+  return PyObject_GetAttrString(varbind, varbind_field_names[field_ind]);
+}
+
+/*
+ * Append the text of obj (a str, bytes or None) and a separating NUL to
+ * the counter key of key_len bytes so far.
+ *
+ * returns : 0, or -1 if it does not fit (or is not text)
+ */
+static int __counter_key_append(char *key, size_t *key_len, PyObject *obj) {
+  PyObject *encoded = NULL;
+  char *text = "";
+  Py_ssize_t len = 0;
+  int ret = -1;
+
+  if (obj && obj != Py_None) {
+#if PY_MAJOR_VERSION >= 3
+    if (PyUnicode_Check(obj)) {
+      if (!(text = (char *)PyUnicode_AsUTF8AndSize(obj, &len))) {
+        PyErr_Clear();
+        return -1;
+      }
+    } else if (PyBytes_Check(obj)) {
+      text = PyBytes_AS_STRING(obj);
+      len = PyBytes_GET_SIZE(obj);
+    } else {
+      return -1;
+    }
+#else
+    if (PyUnicode_Check(obj)) {
+      if (!(obj = encoded = PyUnicode_AsUTF8String(obj))) {
+        PyErr_Clear();
+        return -1;
+      }
+    }
+    if (!PyString_Check(obj)) {
+      return -1;
+    }
+    text = PyString_AS_STRING(obj);
+    len = PyString_GET_SIZE(obj);
+#endif
+  }
 
-            __get_type_str(vars->type, val_type_str, 1);
-            varbind = py_netsnmp_construct_varbind();
+  if (*key_len + len + 1 <= COUNTER_MAX_KEY) {
+    memcpy(key + *key_len, text, len);
+    *key_len += len;
+    key[(*key_len)++] = '\0';
+    ret = 0;
+  }
 
-            py_netsnmp_attr_set_string(varbind, "root_oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "snmp_type", val_type_str,
-                                       strlen(val_type_str));
+  Py_XDECREF(encoded);
+  return ret;
+}
 
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
+/*
+ * Work out the delta and rate of one polled variable, updating its state.
+ *
+ * returns : a new reference to a (variable, delta, rate) tuple, or NULL
+ *           with a Python exception set
+ */
+static PyObject *__counter_update(counter_table *table, const char *agent,
+                                  Py_ssize_t agent_len, PyObject *varbind,
+                                  double now) {
+  PyObject *oid = NULL;
+  PyObject *oid_index = NULL;
+  PyObject *value = NULL;
+  PyObject *number = NULL;
+  PyObject *ret = NULL;
+  counter_state *state = NULL;
+  char key[COUNTER_MAX_KEY];
+  size_t key_len = 0;
+  char *type_str = NULL;
+  unsigned long long raw;
+  unsigned long long delta;
+  int type = TYPE_UNKNOWN;
+  int created = 0;
+  int continuous;
+
+  if (!(oid = __varbind_field(varbind, VARBIND_TAG_F)) ||
+      !(oid_index = __varbind_field(varbind, VARBIND_IID_F)) ||
+      !(value = __varbind_field(varbind, VARBIND_VAL_F))) {
+    goto done;
+  }
 
-            notdone = 0;
-            break;
-          }
-          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
-              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
-                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
-            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
-              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
-              sizeof(op_data.oid_arr[varlist_ind]),
-              sizeof(vars->name)
-            );
-            notdone = 0;
-            break;
-          }
+  if (agent_len + 1 > COUNTER_MAX_KEY) {
+    goto none;
+  }
+  memcpy(key, agent, agent_len);
+  key[agent_len] = '\0';
+  key_len = agent_len + 1;
+  if (__counter_key_append(key, &key_len, oid) < 0 ||
+      __counter_key_append(key, &key_len, oid_index) < 0) {
+    goto none;
+  }
 
-          varbind = read_variable(vars, &op_data, session_ctx->getlabel_flag, session_ctx->sprintval_flag);
+  if (py_netsnmp_attr_string(varbind, "snmp_type", &type_str, NULL) < 0) {
+    goto done;
+  }
+  type = __translate_appl_type(type_str);
 
-          if (varbind) {
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
-          } else {
-            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
-          }
+  if (type != TYPE_COUNTER && type != TYPE_COUNTER64) {
+    /* e.g. NOSUCHINSTANCE; whatever comes back next starts afresh */
+    state = simple_hashtable_lookup(&table->counters, key, key_len, NULL);
+    if (state) {
+      state->type = 0;
+    }
+    goto none;
+  }
 
-          // Move on to next
-          vars = vars->next_variable;
-        }
+  if (!(number = PyNumber_Long(value))) {
+    PyErr_Clear();
+    goto none;
+  }
+  raw = PyLong_AsUnsignedLongLong(number);
+  if (PyErr_Occurred()) {
+    PyErr_Clear();
+    goto none;
+  }
 
-        py_log_msg(DEBUG,
-          "%s: Partially finished reading all variables from request for %s",
-          op_name, op_data.initial_oid
-        );
-      }
+  state = simple_hashtable_lookup(&table->counters, key, key_len, &created);
+  if (!state) {
+    PyErr_NoMemory();
+    goto done;
+  }
 
-      if (op_data.response) {
-        snmp_free_pdu(op_data.response);
-        op_data.response = NULL;
-        py_log_msg(DEBUG,
-          "%s: Finished reading all variables from request for %s",
-          op_name, op_data.initial_oid
-        );
-        notdone = 0;
-      }
+  continuous = !created && state->type == type && now > state->timestamp;
+  if (continuous) {
+    if (raw >= state->value) {
+      delta = raw - state->value;
+    } else if (type == TYPE_COUNTER && state->value < COUNTER32_RANGE &&
+               raw + COUNTER32_RANGE - state->value < COUNTER32_RANGE / 2) {
+      delta = raw + COUNTER32_RANGE - state->value;
+    } else {
+      py_log_msg(DEBUG, "counter: discontinuity for %s", key + agent_len + 1);
+      continuous = 0;
     }
-    varlist_ind++;
   }
 
-  py_log_msg(DEBUG, "%s: Finished reading all variables",op_name);
-  goto done;
+  if (continuous) {
+    ret = Py_BuildValue("(OKd)", varbind, delta,
+                        (double)delta / (now - state->timestamp));
+  }
 
-exception:
-  snmp_op_data_finish(&op_data);
-  return NULL;
+  state->value = raw;
+  state->timestamp = now;
+  state->type = type;
 
-done:
-  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
+  if (continuous) {
+    goto done;
+  }
 
-  snmp_op_data_finish(&op_data);
+none:
+  ret = Py_BuildValue("(OOO)", varbind, Py_None, Py_None);
 
-  if(error) {
-    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+done:
+  Py_XDECREF(oid);
+  Py_XDECREF(oid_index);
+  Py_XDECREF(value);
+  Py_XDECREF(number);
 
-    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
-      session_ctx->err_num, session_ctx->err_ind);
+  return ret;
+}
 
-    Py_XDECREF(result_varlist);
+static PyObject *netsnmp_counter_table(PyObject *self, PyObject *args) {
+  counter_table *table = NULL;
+  Py_ssize_t size_hint = 0;
+
+  if (!PyArg_ParseTuple(args, "|n", &size_hint)) {
     return NULL;
   }
 
-  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+  if (!(table = PyObject_New(counter_table, &counter_table_type))) {
+    return NULL;
+  }
 
-  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+  if (simple_hashtable_init(&table->counters, sizeof(counter_state),
+                            size_hint > 0 ? (size_t)size_hint : 0) < 0) {
+    table->counters.slots = NULL;
+    Py_DECREF(table);
+    return PyErr_NoMemory();
+  }
 
-  return Py_BuildValue("N", result_varlist);
+  return (PyObject *)table;
 }
 
-static PyObject *netsnmp_bulkwalk(PyObject *self, PyObject *args) {
-  PyObject *session = NULL;
-  session_capsule_ctx *session_ctx = NULL;
-  snmp_op_data op_data;
-  PyObject *result_varlist = NULL;
-  netsnmp_variable_list *vars = NULL;
-  int error = 0;
-  int op_data_error = 0;
-  char *op_name = "netsnmp_bulkwalk";
-  int nonrepeaters;
-  int maxrepetitions;
+/*
+ * counter_update(table, agent, varlist[, timestamp]) returns a list of
+ * (variable, delta, rate) tuples for a varlist polled from agent (any
+ * string which identifies it), delta and rate being None where there is no
+ * earlier value to compare with or the variable is not a counter.
+ */
+static PyObject *netsnmp_counter_update(PyObject *self, PyObject *args) {
+  PyObject *varlist = NULL;
+  PyObject *result = NULL;
+  PyObject *item = NULL;
+  counter_table *table = NULL;
+  const char *agent = NULL;
+  Py_ssize_t agent_len = 0;
+  Py_ssize_t varlist_len;
+  Py_ssize_t i;
+  double now = 0;
+
+  if (!PyArg_ParseTuple(args, "O!sO|d", &counter_table_type, &table, &agent,
+                        &varlist, &now)) {
+    return NULL;
+  }
+  agent_len = strlen(agent);
 
-  snmp_op_data_reset(&op_data);
+  if (!PyList_Check(varlist)) {
+    PyErr_SetString(PyExc_TypeError, "counter_update: varlist is not a list");
+    return NULL;
+  }
 
-  py_log_msg(DEBUG, "%s: Starting", op_name);
+  if (now <= 0) {
+    now = __monotonic_seconds();
+  }
 
-  if (!args) {
-    const char *err_msg = "%s: missing arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto done;
+  varlist_len = PyList_GET_SIZE(varlist);
+  if (!(result = PyList_New(varlist_len))) {
+    return NULL;
   }
 
-  if (!PyArg_ParseTuple(args, "OOii", &session, &op_data.varlist, &nonrepeaters,
-                        &maxrepetitions)) {
-    const char *err_msg = "%s: Could not parse arguments";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+  for (i = 0; i < varlist_len; i++) {
+    item = __counter_update(table, agent, agent_len,
+                            PyList_GET_ITEM(varlist, i), now);
+    if (!item) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyList_SET_ITEM(result, i, item);
   }
 
-  py_log_msg(DEBUG, "%s: Arguments parsed", op_name);
+  return result;
+}
 
-  if (!PyList_Check(op_data.varlist)) {
-    const char *err_msg = "%s: varlist is not a list";
-    PyErr_Format(PyExc_ValueError, err_msg, op_name);
-    error = 1;
-    goto exception;
+static PyObject *netsnmp_counter_clear(PyObject *self, PyObject *args) {
+  counter_table *table = NULL;
+
+  if (!PyArg_ParseTuple(args, "O!", &counter_table_type, &table)) {
+    return NULL;
   }
 
-  py_log_msg(DEBUG, "%s: Getting session context", op_name);
-  session_ctx = get_session_context(session);
+  simple_hashtable_clear(&table->counters);
 
-  if (!session_ctx) {
-    error = 1;
-    goto exception;
-  }
-  py_log_msg(DEBUG, "%s: Got session context", op_name);
+  Py_RETURN_NONE;
+}
 
-  py_log_msg(DEBUG, "%s: Loading operation data", op_name);
-  op_data.op_name = op_name;
-  op_data_error = snmp_op_data_load(&op_data, session_ctx->best_guess);
+/*
+ * Trap reception.
+ *
+ * A TrapSocket is a UDP socket bound to receive SNMPv1 traps and SNMPv2c
+ * notifications.  trap_receive() waits for datagrams, takes as many as are
+ * queued at once (with recvmmsg where available), parses them into PDUs
+ * and acknowledges informs, all without the GIL; the variables of every
+ * notification are then decoded with read_variable() under the options of
+ * the TrapListener, as those of a response would be for a session.
+ * SNMPv3 notifications, which need USM to be verified, are dropped.
+ *
+ * Every socket keeps a buffer of TRAP_PACKET_SIZE bytes for each datagram
+ * of a batch.  Notifications are rarely more than a few hundred bytes
+ * (agents need only send up to 484), so anything bigger than that is
+ * taken to be truncated and dropped rather than pinning 64 KiB per slot.
+ */
+#define TRAP_PACKET_SIZE (8192)
+#define TRAP_MAX_COMMUNITY (256)
+#define TRAP_MAX_BATCH (256)
 
-  if (op_data_error || PyErr_Occurred()) {
-    if(PyErr_Occurred()) {
-      goto exception;
-    }
+/* snmpTraps, under which the generic traps of SNMPv1 are defined */
+static oid snmp_traps_oid[] = {1, 3, 6, 1, 6, 3, 1, 1, 5};
 
-    error = 1;
-    goto done;
+typedef struct {
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  size_t len;
+  int truncated; /* longer than TRAP_PACKET_SIZE, and so dropped */
+  long version;
+  u_char community[TRAP_MAX_COMMUNITY];
+  size_t community_len;
+  netsnmp_pdu *pdu; /* NULL for a datagram which was dropped */
+} trap_packet;
+
+typedef struct {
+  PyObject_HEAD
+  int fd;
+  int port;
+  int batch_size;
+  int busy; /* a receive is in progress, in another thread */
+  unsigned long long received;
+  unsigned long long dropped;
+
+  /* the decoding options and statistics, there being no handle */
+  session_capsule_ctx ctx;
+
+  u_char *bufs; /* batch_size buffers of TRAP_PACKET_SIZE bytes */
+  trap_packet *packets;
+#ifdef MSG_WAITFORONE
+  struct mmsghdr *msgs;
+  struct iovec *iovs;
+#endif
+} trap_socket;
+
+static PyTypeObject trap_socket_type;
+
+static void trap_socket_dealloc(trap_socket *sock) {
+  if (sock->fd >= 0) {
+    close(sock->fd);
   }
-  py_log_msg(DEBUG, "%s: Finished loading operation data", op_name);
+  PyMem_Free(sock->bufs);
+  PyMem_Free(sock->packets);
+#ifdef MSG_WAITFORONE
+  PyMem_Free(sock->msgs);
+  PyMem_Free(sock->iovs);
+#endif
+  PyObject_Del(sock);
+}
 
-  py_log_msg(DEBUG, "%s: Starting snmp request", op_name);
+static PyMemberDef trap_socket_members[] = {
+    {"port", T_INT, offsetof(trap_socket, port), READONLY,
+     "the UDP port the socket is bound to"},
+    {"received", T_ULONGLONG, offsetof(trap_socket, received), READONLY,
+     "the number of datagrams received"},
+    {"dropped", T_ULONGLONG, offsetof(trap_socket, dropped), READONLY,
+     "the number of datagrams which were not SNMPv1 or SNMPv2c "
+     "notifications"},
+    {NULL} /* Sentinel */
+};
 
-  result_varlist = PyList_New(0);
-  PyObject * varbind = NULL;
-  int notdone = 0;
-  int status = 0;
-  int varlist_ind = 0;
-  int varlist_len = op_data.varlist_len;
+static PyTypeObject trap_socket_type = {
+    PyVarObject_HEAD_INIT(NULL, 0) "easysnmp.interface.TrapSocket",
+    sizeof(trap_socket),                      /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)trap_socket_dealloc,          /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    "a UDP socket receiving SNMP notifications", /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    0,                                        /* tp_methods */
+    trap_socket_members,                      /* tp_members */
+};
 
-  while (varlist_ind < varlist_len) {
-    op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
-    op_data.pdu->non_repeaters = nonrepeaters;
-    op_data.pdu->max_repetitions = maxrepetitions;
-    snmp_add_null_var(op_data.pdu, op_data.oid_arr[varlist_ind], op_data.oid_arr_len[varlist_ind]);
+/*
+ * Wait up to timeout_ms (-1 for ever) for datagrams and read as many as
+ * are queued, up to the batch size; called without the GIL.
+ *
+ * returns : the number of datagrams read, or -1 with errno set
+ */
+static int __trap_recv_batch(trap_socket *sock, int timeout_ms) {
+  struct pollfd pfd;
+  trap_packet *packet = NULL;
+  int ready;
+  int num = 0;
 
-    py_log_msg(DEBUG, "%s: filling request: oid(%s) "
-                      "oid_idx(%s) oid_arr_len(%d) best_guess(%d)",
-                op_data.op_name,
-                op_data.oid_str_arr[varlist_ind],
-                op_data.oid_idx_str_arr[varlist_ind],
-                op_data.oid_arr_len[varlist_ind],
-                session_ctx->best_guess);
+  pfd.fd = sock->fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
 
-    notdone = 1;
-    while (notdone) {
-      py_log_msg(DEBUG, "%s: Sending pdu req",
-        op_data.op_name);
+  ready = poll(&pfd, 1, timeout_ms);
+  if (ready <= 0) {
+    return ready;
+  }
 
-      status = send_pdu_request(session_ctx, &op_data);
-      if((status != STAT_SUCCESS) || PyErr_Occurred()) {
+#ifdef MSG_WAITFORONE
+  for (num = 0; num < sock->batch_size; num++) {
+    sock->msgs[num].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+  }
 
-        if(PyErr_Occurred()) {
-          goto exception;
-        }
+  num = recvmmsg(sock->fd, sock->msgs, sock->batch_size, MSG_DONTWAIT, NULL);
+  if (num < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+  }
 
-        py_log_msg(ERROR, "%s: PDU req resulted in error Request Status(%d)",
-          op_data.op_name, status);
-        error = 1;
-        goto done;
+  for (ready = 0; ready < num; ready++) {
+    packet = &sock->packets[ready];
+    packet->len = sock->msgs[ready].msg_len;
+    packet->addr_len = sock->msgs[ready].msg_hdr.msg_namelen;
+    packet->truncated = (sock->msgs[ready].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+  }
+#else
+  for (num = 0; num < sock->batch_size; num++) {
+    struct msghdr msg;
+    struct iovec iov;
+    ssize_t len;
+
+    packet = &sock->packets[num];
+
+    iov.iov_base = sock->bufs + (size_t)num * TRAP_PACKET_SIZE;
+    iov.iov_len = TRAP_PACKET_SIZE;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &packet->addr;
+    msg.msg_namelen = sizeof(packet->addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    len = recvmsg(sock->fd, &msg, MSG_DONTWAIT);
+    if (len < 0) {
+      if (num == 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        return -1;
       }
+      break;
+    }
+    packet->len = (size_t)len;
+    packet->addr_len = msg.msg_namelen;
+    packet->truncated = (msg.msg_flags & MSG_TRUNC) != 0;
+  }
+#endif
 
-      if (notdone) {
-        vars = op_data.response->variables;
-        op_data.initial_oid = op_data.initial_oid_str_arr[varlist_ind];
+  return num;
+}
 
-        while (vars) {
+/*
+ * Parse a datagram into packet->pdu, answering an inform with the same
+ * datagram as a response (which, per RFC 3416, carries the request-id and
+ * variables of the inform and no error); called without the GIL.
+ *
+ * returns : 0, or -1 if the datagram is not a notification to deliver
+ */
+static int __trap_parse(trap_socket *sock, trap_packet *packet, u_char *buf) {
+  netsnmp_pdu *pdu = NULL;
+  u_char *data = NULL;
+  size_t length = packet->len;
 
-          if (vars->type == SNMP_ENDOFMIBVIEW) {
-            py_log_msg(DEBUG, "%s: encountered end condition "
-                              "(ENDOFMIBVIEW)", op_name);
-            notdone = 0;
-            break;
-          }
-          else if ((vars->type == SNMP_NOSUCHOBJECT) ||
-          (vars->type == SNMP_NOSUCHINSTANCE)) {
-            char val_type_str[MAX_TYPE_NAME_LEN];
+  packet->pdu = NULL;
+  packet->community_len = sizeof(packet->community) - 1;
 
-            __get_type_str(vars->type, val_type_str, 1);
-            varbind = py_netsnmp_construct_varbind();
+  if (packet->truncated) {
+    return -1;
+  }
 
-            py_netsnmp_attr_set_string(varbind, "root_oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "oid", op_data.initial_oid, STRLEN(op_data.initial_oid));
-            py_netsnmp_attr_set_string(varbind, "snmp_type", val_type_str,
-                                       strlen(val_type_str));
+  data = snmp_comstr_parse(buf, &length, packet->community,
+                           &packet->community_len, &packet->version);
+  if (!data || (packet->version != SNMP_VERSION_1 &&
+                packet->version != SNMP_VERSION_2c)) {
+    return -1;
+  }
 
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
+  /* snmp_pdu_create() would draw a request id, which is not needed */
+  if (!(pdu = (netsnmp_pdu *)calloc(1, sizeof(netsnmp_pdu)))) {
+    return -1;
+  }
+  pdu->version = packet->version;
 
-            notdone = 0;
-            break;
-          }
-          else if ((vars->name_length < op_data.oid_arr_len[varlist_ind]) ||
-              (memcmp(op_data.oid_arr[varlist_ind], vars->name,
-                      op_data.oid_arr_len[varlist_ind] * sizeof(oid)) != 0)) {
-            py_log_msg(DEBUG, "%s: encountered end condition (next subtree iteration out of scope) var_len: %d/op_var_len: %d var_name_size: %d/op_name_size: %d",
-              op_name, vars->name_length, op_data.oid_arr_len[varlist_ind],
-              sizeof(op_data.oid_arr[varlist_ind]),
-              sizeof(vars->name)
-            );
-            notdone = 0;
-            break;
-          }
+  if (snmp_pdu_parse(pdu, data, &length) != SNMP_ERR_NOERROR ||
+      !((pdu->command == SNMP_MSG_TRAP &&
+         packet->version == SNMP_VERSION_1) ||
+        ((pdu->command == SNMP_MSG_TRAP2 ||
+          pdu->command == SNMP_MSG_INFORM) &&
+         packet->version == SNMP_VERSION_2c))) {
+    snmp_free_pdu(pdu);
+    return -1;
+  }
 
-          varbind = read_variable(vars, &op_data, session_ctx->getlabel_flag, session_ctx->sprintval_flag);
+  if (pdu->command == SNMP_MSG_INFORM) {
+    *data = SNMP_MSG_RESPONSE;
+    sendto(sock->fd, buf, packet->len, MSG_DONTWAIT,
+           (struct sockaddr *)&packet->addr, packet->addr_len);
+  }
 
-          if (varbind) {
-            PyList_Append(result_varlist, varbind);
-            Py_DECREF(varbind);
-          } else {
-            py_log_msg(ERROR, "%s bad varbind (%d)", op_name, varlist_ind);
-          }
+  packet->pdu = pdu;
+  return 0;
+}
 
-          // Create next request if we've reached the end
-          if (vars->next_variable == NULL) {
-            op_data.pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
-            op_data.pdu->non_repeaters = nonrepeaters;
-            op_data.pdu->max_repetitions = maxrepetitions;
-            snmp_add_null_var(op_data.pdu, vars->name, vars->name_length);
-            py_log_msg(DEBUG,
-              "%s: Creating pdu request for %s",
-              op_name, op_data.initial_oid
-            );
-          }
+/* a new reference to the OID formatted under the listener's options */
+static PyObject *__trap_oid_string(trap_socket *sock, snmp_op_data *data,
+                                   oid *name, size_t name_len) {
+  __sprint_objid((char *)data->str_buf, sizeof(data->str_buf), name, name_len,
+                 sock->ctx.oid_output_format);
 
-          // Move on to next
-          vars = vars->next_variable;
-        }
+  return PyUnicode_Decode((char *)data->str_buf,
+                          strlen((char *)data->str_buf), "latin-1",
+                          "surrogateescape");
+}
 
-        py_log_msg(DEBUG,
-          "%s: Partially finished reading all variables from request for %s",
-          op_name, op_data.initial_oid
-        );
+/*
+ * Build the notification tuple handed to the TrapListener:
+ *
+ *   (host, port, version, community, command, varlist,
+ *    enterprise, agent_address, generic_trap, specific_trap, uptime,
+ *    trap_oid)
+ *
+ * The SNMPv1 fields are None (or 0) for SNMPv2c notifications, and the
+ * trap_oid of an SNMPv1 trap is worked out as in RFC 3584 (the trap_oid of
+ * an SNMPv2c notification is the value of its snmpTrapOID.0 variable).
+ */
+static PyObject *__trap_notification(trap_socket *sock, trap_packet *packet,
+                                     snmp_op_data *data) {
+  netsnmp_pdu *pdu = packet->pdu;
+  netsnmp_variable_list *vars = NULL;
+  PyObject *varlist = NULL;
+  PyObject *varbind = NULL;
+  PyObject *community = NULL;
+  PyObject *enterprise = NULL;
+  PyObject *agent_address = NULL;
+  PyObject *trap_oid = NULL;
+  PyObject *result = NULL;
+  char host[NI_MAXHOST];
+  char serv[NI_MAXSERV];
+  char addr_str[INET_ADDRSTRLEN];
+  oid v1_trap_oid[MAX_OID_LEN];
+  size_t v1_trap_oid_len = 0;
+
+  if (getnameinfo((struct sockaddr *)&packet->addr, packet->addr_len, host,
+                  sizeof(host), serv, sizeof(serv),
+                  NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+    strcpy(host, "");
+    strcpy(serv, "0");
+  }
+
+  if (!(varlist = PyList_New(0))) {
+    goto done;
+  }
+
+  for (vars = pdu->variables; vars; vars = vars->next_variable) {
+    if (!(varbind = __build_response_varbind(vars, data, &sock->ctx))) {
+      goto done;
+    }
+    if (PyList_Append(varlist, varbind) < 0) {
+      Py_DECREF(varbind);
+      goto done;
+    }
+    Py_DECREF(varbind);
+  }
+
+  community = PyUnicode_Decode((char *)packet->community,
+                               packet->community_len, "latin-1",
+                               "surrogateescape");
+  if (!community) {
+    goto done;
+  }
+
+  if (pdu->command == SNMP_MSG_TRAP) {
+    if (pdu->trap_type == SNMP_TRAP_ENTERPRISESPECIFIC) {
+      if (pdu->enterprise_length + 2 <= MAX_OID_LEN) {
+        memcpy(v1_trap_oid, pdu->enterprise,
+               pdu->enterprise_length * sizeof(oid));
+        v1_trap_oid_len = pdu->enterprise_length;
+        v1_trap_oid[v1_trap_oid_len++] = 0;
+        v1_trap_oid[v1_trap_oid_len++] = pdu->specific_type;
       }
+    } else {
+      memcpy(v1_trap_oid, snmp_traps_oid, sizeof(snmp_traps_oid));
+      v1_trap_oid_len = sizeof(snmp_traps_oid) / sizeof(oid);
+      v1_trap_oid[v1_trap_oid_len++] = pdu->trap_type + 1;
+    }
 
-      if (op_data.response) {
-        snmp_free_pdu(op_data.response);
-        op_data.response = NULL;
-        py_log_msg(DEBUG,
-          "%s: Finished reading all variables from request for %s",
-          op_name, op_data.initial_oid
-        );
+    inet_ntop(AF_INET, pdu->agent_addr, addr_str, sizeof(addr_str));
+    if (!(enterprise = __trap_oid_string(sock, data, pdu->enterprise,
+                                         pdu->enterprise_length)) ||
+        !(agent_address = PyUnicode_FromString(addr_str)) ||
+        !(trap_oid = __trap_oid_string(sock, data, v1_trap_oid,
+                                       v1_trap_oid_len))) {
+      goto done;
+    }
+  } else {
+    /* sysUpTime.0 comes first, then snmpTrapOID.0 */
+    if (PyList_GET_SIZE(varlist) >= 2) {
+      trap_oid = __varbind_field(PyList_GET_ITEM(varlist, 1), VARBIND_VAL_F);
+      if (!trap_oid) {
+        goto done;
       }
     }
-    varlist_ind++;
   }
 
-  py_log_msg(DEBUG, "%s: Finished reading all variables",op_name);
-  goto done;
-
-exception:
-  snmp_op_data_finish(&op_data);
-  return NULL;
+  result = Py_BuildValue(
+      "(siiOiOOOllkO)", host, atoi(serv), (int)packet->version, community,
+      pdu->command, varlist, enterprise ? enterprise : Py_None,
+      agent_address ? agent_address : Py_None,
+      (pdu->command == SNMP_MSG_TRAP) ? pdu->trap_type : 0L,
+      (pdu->command == SNMP_MSG_TRAP) ? pdu->specific_type : 0L,
+      (unsigned long)pdu->time, trap_oid ? trap_oid : Py_None);
 
 done:
-  py_log_msg(DEBUG, "%s: Starting cleanup", op_name);
 
-  snmp_op_data_finish(&op_data);
+  Py_XDECREF(varlist);
+  Py_XDECREF(community);
+  Py_XDECREF(enterprise);
+  Py_XDECREF(agent_address);
+  Py_XDECREF(trap_oid);
 
-  if(error) {
-    py_log_msg(ERROR, "%s: Exiting due to error %d", op_name, error);
+  return result;
+}
 
-    __py_netsnmp_update_session_errors(session, session_ctx->err_str,
-      session_ctx->err_num, session_ctx->err_ind);
+/*
+ * trap_socket(listener, bind_address, port, batch_size, recv_buffer)
+ * binds a TrapSocket decoding variables with the options of listener;
+ * recv_buffer sets SO_RCVBUF when positive.
+ */
+static PyObject *netsnmp_trap_socket(PyObject *self, PyObject *args) {
+  PyObject *listener = NULL;
+  trap_socket *sock = NULL;
+  struct addrinfo hints;
+  struct addrinfo *res = NULL;
+  struct addrinfo *ai = NULL;
+  struct sockaddr_storage bound;
+  socklen_t bound_len = sizeof(bound);
+  char *bind_address = NULL;
+  char port_str[16];
+  int port;
+  int batch_size;
+  int recv_buffer;
+  int err;
+#ifdef MSG_WAITFORONE
+  int i;
+#endif
 
-    Py_XDECREF(result_varlist);
+  if (!PyArg_ParseTuple(args, "Osiii", &listener, &bind_address, &port,
+                        &batch_size, &recv_buffer)) {
     return NULL;
   }
 
-  py_log_msg(DEBUG, "%s: End cleanup", op_name);
+  if (batch_size < 1) {
+    batch_size = 1;
+  } else if (batch_size > TRAP_MAX_BATCH) {
+    batch_size = TRAP_MAX_BATCH;
+  }
 
-  py_log_msg(DEBUG, "%s: Returning %d objects", op_name, PySequence_Length(result_varlist));
+  if (!(sock = PyObject_New(trap_socket, &trap_socket_type))) {
+    return NULL;
+  }
 
-  return Py_BuildValue("N", result_varlist);
-}
+  __py_log_refresh_level();
+
+  sock->fd = -1;
+  sock->port = 0;
+  sock->batch_size = batch_size;
+  sock->busy = 0;
+  sock->received = 0;
+  sock->dropped = 0;
+  memset(&sock->ctx, 0, sizeof(sock->ctx));
+  sock->bufs = NULL;
+  sock->packets = NULL;
+#ifdef MSG_WAITFORONE
+  sock->msgs = NULL;
+  sock->iovs = NULL;
+#endif
 
-static PyObject *netsnmp_set(PyObject *self, PyObject *args) {
-  PyObject *session = NULL;
-  PyObject *varlist = NULL;
-  PyObject *varbind = NULL;
-  PyObject *ret = NULL;
+  if (__load_decode_options(&sock->ctx, listener) < 0) {
+    goto exception;
+  }
 
-  session_capsule_ctx *session_ctx = NULL;
-  netsnmp_session *ss = NULL;
-  netsnmp_pdu *pdu = NULL;
-  netsnmp_pdu *response = NULL;
+  sock->bufs = PyMem_Malloc((size_t)batch_size * TRAP_PACKET_SIZE);
+  sock->packets = PyMem_New(trap_packet, batch_size);
+#ifdef MSG_WAITFORONE
+  sock->msgs = PyMem_New(struct mmsghdr, batch_size);
+  sock->iovs = PyMem_New(struct iovec, batch_size);
+  if (!sock->msgs || !sock->iovs) {
+    PyErr_NoMemory();
+    goto exception;
+  }
+#endif
+  if (!sock->bufs || !sock->packets) {
+    PyErr_NoMemory();
+    goto exception;
+  }
 
-  struct tree *tp = NULL;
-  char *tag = NULL;
-  char *iid = NULL;
-  char *val = NULL;
-  char *type_str = NULL;
-  int len;
-  oid *oid_arr = calloc(MAX_OID_LEN, sizeof(oid));
-  int oid_arr_len = MAX_OID_LEN;
-  int type;
-  u_char tmp_val_str[STR_BUF_SIZE];
-  int use_enums;
-  struct enum_list *ep = NULL;
-  int best_guess;
-  int status;
-  int err_ind;
-  int err_num;
-  char err_str[STR_BUF_SIZE];
-  char *tmpstr = NULL;
-  Py_ssize_t tmplen;
-  int error = 0;
+#ifdef MSG_WAITFORONE
+  memset(sock->msgs, 0, batch_size * sizeof(struct mmsghdr));
+  for (i = 0; i < batch_size; i++) {
+    sock->iovs[i].iov_base = sock->bufs + (size_t)i * TRAP_PACKET_SIZE;
+    sock->iovs[i].iov_len = TRAP_PACKET_SIZE;
+    sock->msgs[i].msg_hdr.msg_iov = &sock->iovs[i];
+    sock->msgs[i].msg_hdr.msg_iovlen = 1;
+    sock->msgs[i].msg_hdr.msg_name = &sock->packets[i].addr;
+  }
+#endif
 
-  if (oid_arr && args) {
-    if (!PyArg_ParseTuple(args, "OO", &session, &varlist)) {
-      goto done;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = AI_PASSIVE;
+  snprintf(port_str, sizeof(port_str), "%d", port);
+
+  err = getaddrinfo(*bind_address ? bind_address : NULL, port_str, &hints,
+                    &res);
+  if (err != 0) {
+    PyErr_Format(EasySNMPConnectionError, "trap_socket: %s: %s",
+                 bind_address, gai_strerror(err));
+    goto exception;
+  }
+
+  errno = 0;
+  for (ai = res; ai; ai = ai->ai_next) {
+    sock->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (sock->fd < 0) {
+      continue;
     }
 
-    session_ctx = get_session_context(session);
+    /*
+     * no SO_REUSEADDR: with it a second listener (or snmptrapd) could
+     * bind the same port and take some of the traps
+     */
+    if (recv_buffer > 0) {
+      setsockopt(sock->fd, SOL_SOCKET, SO_RCVBUF, &recv_buffer,
+                 sizeof(recv_buffer));
+    }
 
-    if (!session_ctx) {
-      goto done;
+    if (bind(sock->fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
     }
 
-    ss = session_ctx->handle;
+    err = errno;
+    close(sock->fd);
+    sock->fd = -1;
+    errno = err;
+  }
+  freeaddrinfo(res);
 
-    if (py_netsnmp_attr_string(session, "error_string", &tmpstr, &tmplen) < 0) {
-      goto done;
+  if (sock->fd < 0) {
+    PyErr_SetFromErrno(PyExc_OSError);
+    goto exception;
+  }
+
+  fcntl(sock->fd, F_SETFL, fcntl(sock->fd, F_GETFL) | O_NONBLOCK);
+
+  if (getsockname(sock->fd, (struct sockaddr *)&bound, &bound_len) == 0) {
+    if (bound.ss_family == AF_INET6) {
+      sock->port = ntohs(((struct sockaddr_in6 *)&bound)->sin6_port);
+    } else {
+      sock->port = ntohs(((struct sockaddr_in *)&bound)->sin_port);
     }
+  }
 
-    use_enums = py_netsnmp_attr_long(session, "use_enums");
-    best_guess = py_netsnmp_attr_long(session, "best_guess");
+  py_log_msg(DEBUG, "trap_socket: listening on %s:%d", bind_address,
+             sock->port);
 
-    pdu = snmp_pdu_create(SNMP_MSG_SET);
+  return (PyObject *)sock;
 
-    if (varlist) {
-      PyObject *varlist_iter = PyObject_GetIter(varlist);
+exception:
 
-      while (varlist_iter && (varbind = PyIter_Next(varlist_iter))) {
-        if (py_netsnmp_attr_string(varbind, "oid", &tag, NULL) < 0 ||
-            py_netsnmp_attr_string(varbind, "oid_index", &iid, NULL) < 0) {
-          oid_arr_len = 0;
-        } else {
-          tp = __tag2oid(tag, iid, oid_arr, &oid_arr_len, &type, best_guess);
-        }
+  Py_DECREF(sock);
+  return NULL;
+}
 
-        if (oid_arr_len == 0) {
-          PyErr_Format(EasySNMPUnknownObjectIDError, "unknown object id (%s)",
-                       (tag ? tag : "<null>"));
-          error = 1;
-          snmp_free_pdu(pdu);
-          Py_DECREF(varbind);
-          Py_DECREF(varlist_iter);
-          goto done;
-        }
+/*
+ * trap_receive(sock, timeout) waits up to timeout seconds (for ever when
+ * negative) for notifications and returns a list of those received, which
+ * is empty if none arrived in time.
+ */
+static PyObject *netsnmp_trap_receive(PyObject *self, PyObject *args) {
+  trap_socket *sock = NULL;
+  snmp_op_data op_data;
+  PyObject *result = NULL;
+  PyObject *notification = NULL;
+  double timeout;
+  int timeout_ms;
+  int num;
+  int sys_errno = 0;
+  unsigned long long dropped = 0;
+  int i;
 
-        if (type == TYPE_UNKNOWN) {
-          if (py_netsnmp_attr_string(varbind, "snmp_type", &type_str, NULL) <
-              0) {
-            snmp_free_pdu(pdu);
-            Py_DECREF(varbind);
-            Py_DECREF(varlist_iter);
-            goto done;
-          }
-          type = __translate_appl_type(type_str);
-          if (type == TYPE_UNKNOWN) {
-            PyErr_SetString(EasySNMPUndeterminedTypeError,
-                            "a type could not be determine for "
-                            "the object");
-            error = 1;
-            snmp_free_pdu(pdu);
-            Py_DECREF(varbind);
-            Py_DECREF(varlist_iter);
-            goto done;
-          }
-        }
+  if (!PyArg_ParseTuple(args, "O!d", &trap_socket_type, &sock, &timeout)) {
+    return NULL;
+  }
 
-        if (py_netsnmp_attr_string(varbind, "value", &val, &tmplen) < 0) {
-          snmp_free_pdu(pdu);
-          Py_DECREF(varbind);
-          Py_DECREF(varlist_iter);
-          goto done;
-        }
+  if (sock->fd < 0) {
+    PyErr_SetString(EasySNMPError, "trap_receive: the socket is closed");
+    return NULL;
+  }
 
-        memset(tmp_val_str, 0, sizeof(tmp_val_str));
-        if (tmplen >= sizeof(tmp_val_str)) {
-          tmplen = sizeof(tmp_val_str) - 1;
-        }
+  if (sock->busy) {
+    PyErr_SetString(EasySNMPError, "trap_receive: the socket is already "
+                                   "receiving in another thread");
+    return NULL;
+  }
 
-        memcpy(tmp_val_str, val, tmplen);
-        if (type == TYPE_INTEGER && use_enums && tp && tp->enums) {
-          for (ep = tp->enums; ep; ep = ep->next) {
-            if (val && !strcmp(ep->label, val)) {
-              snprintf((char *)tmp_val_str, sizeof(tmp_val_str), "%d",
-                       ep->value);
-              break;
-            }
-          }
-        }
-        len = (int)tmplen;
-        status = __add_var_val_str(pdu, oid_arr, oid_arr_len,
-                                   (char *)tmp_val_str, len, type);
+  /* OIDs are only printed without the MIBs with use_numeric */
+  if (sock->ctx.oid_output_format != NETSNMP_OID_OUTPUT_NUMERIC) {
+    __load_mibs_on_demand();
+  }
 
-        if (status == FAILURE) {
-          py_log_msg(ERROR, "set: adding variable/value to PDU");
-        }
+  timeout_ms = (timeout < 0) ? -1 : (int)(timeout * 1000);
+  sock->busy = 1;
 
-        /* release reference when done */
-        Py_DECREF(varbind);
-      }
+  Py_BEGIN_ALLOW_THREADS
+  num = __trap_recv_batch(sock, timeout_ms);
+  sys_errno = errno;
+  for (i = 0; i < num; i++) {
+    if (__trap_parse(sock, &sock->packets[i],
+                     sock->bufs + (size_t)i * TRAP_PACKET_SIZE) < 0) {
+      dropped++;
+    }
+  }
+  Py_END_ALLOW_THREADS
 
-      Py_DECREF(varlist_iter);
+  sock->busy = 0;
 
-      if (PyErr_Occurred()) {
-        error = 1;
-        snmp_free_pdu(pdu);
-        goto done;
+  if (num < 0) {
+    if (sys_errno == EINTR) {
+      if (PyErr_CheckSignals() < 0) {
+        return NULL;
       }
+      return PyList_New(0);
     }
+    errno = sys_errno;
+    return PyErr_SetFromErrno(PyExc_OSError);
+  }
 
-    status = __send_sync_pdu(ss, pdu, &response, NO_RETRY_NOSUCH, err_str,
-                             &err_num, &err_ind, NULL);
-    __py_netsnmp_update_session_errors(session, err_str, err_num, err_ind);
-    if (status != 0) {
-      error = 1;
-      goto done;
-    }
+  sock->received += num;
+  sock->dropped += dropped;
 
-    if (response) {
-      snmp_free_pdu(response);
+  snmp_op_data_reset(&op_data);
+  op_data.op_name = "trap_receive";
+
+  result = PyList_New(0);
+  for (i = 0; i < num; i++) {
+    trap_packet *packet = &sock->packets[i];
+
+    if (!packet->pdu) {
+      continue;
     }
 
-    if (status == STAT_SUCCESS) {
-      ret = Py_BuildValue("i", 1); /* success, return True */
-    } else {
-      ret = Py_BuildValue("i", 0); /* fail, return False */
+    if (result) {
+      notification = __trap_notification(sock, packet, &op_data);
+      if (!notification || PyList_Append(result, notification) < 0) {
+        Py_CLEAR(result);
+      }
+      Py_XDECREF(notification);
     }
+
+    snmp_free_pdu(packet->pdu);
+    packet->pdu = NULL;
   }
 
-done:
+  py_log_msg(DEBUG, "trap_receive: %d datagrams, %d dropped", num,
+             (int)dropped);
 
-  Py_XDECREF(varbind);
-  SAFE_FREE(oid_arr);
-  if (error) {
+  return result;
+}
+
+static PyObject *netsnmp_trap_close(PyObject *self, PyObject *args) {
+  trap_socket *sock = NULL;
+
+  if (!PyArg_ParseTuple(args, "O!", &trap_socket_type, &sock)) {
     return NULL;
-  } else {
-    return (ret ? ret : Py_BuildValue(""));
   }
+
+  if (sock->busy) {
+    PyErr_SetString(EasySNMPError, "trap_close: the socket is receiving in "
+                                   "another thread");
+    return NULL;
+  }
+
+  if (sock->fd >= 0) {
+    close(sock->fd);
+    sock->fd = -1;
+  }
+
+  Py_RETURN_NONE;
 }
 
 /**
@@ -3132,8 +9307,36 @@ done:
   return NULL;
 }
 
-static void py_log_msg(int log_level, char *printf_fmt, ...) {
+static void __py_log_refresh_level(void) {
+#ifndef EASYSNMP_NO_DEBUG_LOG
+  static PyObject *debug_level = NULL;
+  static PyObject *is_enabled_for = NULL;
+  PyObject *enabled = NULL;
+
+  if (!debug_level) {
+    debug_level = PyObject_GetAttrString(logging_import, "DEBUG");
+  }
+  if (!is_enabled_for && PyLogger) {
+    is_enabled_for = PyObject_GetAttrString(PyLogger, "isEnabledFor");
+  }
+
+  if (!debug_level || !is_enabled_for ||
+      !(enabled = PyObject_CallFunctionObjArgs(is_enabled_for, debug_level,
+                                               NULL))) {
+    /* fall back to logging everything, as we always used to */
+    PyErr_Clear();
+    py_log_debug_enabled = 1;
+    return;
+  }
+
+  py_log_debug_enabled = PyObject_IsTrue(enabled) > 0;
+  Py_DECREF(enabled);
+#endif
+}
+
+static void __py_log_msg(int log_level, char *printf_fmt, ...) {
   PyObject *log_msg = NULL;
+  PyObject *ret = NULL;
   va_list fmt_args;
 
   va_start(fmt_args, printf_fmt);
@@ -3148,29 +9351,30 @@ static void py_log_msg(int log_level, char *printf_fmt, ...) {
   /* call function depending on loglevel */
   switch (log_level) {
   case INFO:
-    PyObject_CallMethod(PyLogger, "info", "O", log_msg);
+    ret = PyObject_CallMethod(PyLogger, "info", "O", log_msg);
     break;
 
   case WARNING:
-    PyObject_CallMethod(PyLogger, "warn", "O", log_msg);
+    ret = PyObject_CallMethod(PyLogger, "warn", "O", log_msg);
     break;
 
   case ERROR:
-    PyObject_CallMethod(PyLogger, "error", "O", log_msg);
+    ret = PyObject_CallMethod(PyLogger, "error", "O", log_msg);
     break;
 
   case DEBUG:
-    PyObject_CallMethod(PyLogger, "debug", "O", log_msg);
+    ret = PyObject_CallMethod(PyLogger, "debug", "O", log_msg);
     break;
 
   case EXCEPTION:
-    PyObject_CallMethod(PyLogger, "exception", "O", log_msg);
+    ret = PyObject_CallMethod(PyLogger, "exception", "O", log_msg);
     break;
 
   default:
     break;
   }
 
+  Py_XDECREF(ret);
   Py_DECREF(log_msg);
 }
 
@@ -3193,15 +9397,53 @@ static PyMethodDef interface_methods[] = {
      "create a netsnmp session."},
     {"session_tunneled", netsnmp_create_session_tunneled, METH_VARARGS,
      "create a tunneled netsnmp session over tls, dtls or ssh."},
+    {"update_session", netsnmp_update_session, METH_VARARGS,
+     "reload the cached options of a session."},
+    {"load_mib", netsnmp_load_mib, METH_VARARGS,
+     "load a further MIB module or file."},
+    {"clear_oid_cache", netsnmp_clear_oid_cache, METH_NOARGS,
+     "forget all cached OID translations."},
+    {"refresh_log_level", netsnmp_refresh_log_level, METH_NOARGS,
+     "look up the level of the easysnmp.interface logger again."},
+    {"session_stats", netsnmp_session_stats, METH_VARARGS,
+     "return (and optionally reset) the statistics of a session."},
+    {"prepare", netsnmp_prepare, METH_VARARGS,
+     "parse and translate the OIDs of a varlist ahead of time."},
     {"get", netsnmp_get, METH_VARARGS, "perform an SNMP GET operation."},
     {"getnext", netsnmp_getnext, METH_VARARGS,
      "perform an SNMP GETNEXT operation."},
     {"getbulk", netsnmp_getbulk, METH_VARARGS,
      "perform an SNMP GETBULK operation."},
+    {"getbulk_columns", netsnmp_getbulk_columns, METH_VARARGS,
+     "fetch scalars and the first rows of columns in one GETBULK."},
     {"set", netsnmp_set, METH_VARARGS, "perform an SNMP SET operation."},
+    {"set_batch", netsnmp_set_batch, METH_VARARGS,
+     "perform SNMP SET operations in pipelined batches."},
     {"walk", netsnmp_walk, METH_VARARGS, "perform an SNMP WALK operation."},
+    {"walk_pipelined", netsnmp_walk_pipelined, METH_VARARGS,
+     "perform an SNMP WALK operation with several GETNEXT chains at once."},
     {"bulkwalk", netsnmp_bulkwalk, METH_VARARGS,
      "perform an SNMP BULKWALK operation."},
+    {"bulkwalk_table", netsnmp_bulkwalk_table, METH_VARARGS,
+     "walk the columns of a table into a columnar result."},
+    {"walk_export", netsnmp_walk_export, METH_VARARGS,
+     "walk subtrees into a buffer of serialized records."},
+    {"iter_bulkwalk", netsnmp_iter_bulkwalk, METH_VARARGS,
+     "iterate over the response PDUs of an SNMP BULKWALK operation."},
+    {"poll_many", netsnmp_poll_many, METH_VARARGS,
+     "perform SNMP operations against many sessions concurrently."},
+    {"counter_table", netsnmp_counter_table, METH_VARARGS,
+     "create a table of the last values of polled counters."},
+    {"counter_update", netsnmp_counter_update, METH_VARARGS,
+     "turn polled counters into deltas and rates."},
+    {"counter_clear", netsnmp_counter_clear, METH_VARARGS,
+     "forget every counter in a counter table."},
+    {"trap_socket", netsnmp_trap_socket, METH_VARARGS,
+     "bind a socket receiving SNMP notifications."},
+    {"trap_receive", netsnmp_trap_receive, METH_VARARGS,
+     "receive a batch of SNMP notifications."},
+    {"trap_close", netsnmp_trap_close, METH_VARARGS,
+     "close a socket receiving SNMP notifications."},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -3226,6 +9468,30 @@ PyMODINIT_FUNC initinterface(void) {
     goto done;
   }
 
+  /* native storage for SNMPVariable, subclassed by easysnmp.variables */
+  if (PyType_Ready(&varbind_base_type) < 0) {
+    goto done;
+  }
+  Py_INCREF(&varbind_base_type);
+  PyModule_AddObject(interface_module, "SNMPVariableBase",
+                     (PyObject *)&varbind_base_type);
+
+  if (PyType_Ready(&walk_iterator_type) < 0) {
+    goto done;
+  }
+
+  if (PyType_Ready(&prepared_varlist_type) < 0) {
+    goto done;
+  }
+
+  if (PyType_Ready(&counter_table_type) < 0) {
+    goto done;
+  }
+
+  if (PyType_Ready(&trap_socket_type) < 0) {
+    goto done;
+  }
+
   /*
    * Perform global imports:
    *
@@ -3286,10 +9552,16 @@ PyMODINIT_FUNC initinterface(void) {
   if (PyLogger == NULL) {
     goto done;
   }
+  __py_log_refresh_level();
 
   /* initialise the netsnmp library */
   __libraries_init("python");
 
+  /* without the OID caches every lookup simply goes to the MIB tree */
+  if (__oid_cache_init() < 0) {
+    py_log_msg(WARNING, "unable to allocate the OID translation caches");
+  }
+
   py_log_msg(DEBUG, "initialised easysnmp.interface");
 
 #if PY_MAJOR_VERSION >= 3
@@ -0,0 +1,35 @@
+from __future__ import unicode_literals
+
+import logging
+import os
+
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from . import interface
+
+
+def set_log_level(level):
+    """
+    Sets the level of the easysnmp.interface logger, to which the C
+    interface logs
+
+    The C interface only checks whether DEBUG messages are wanted when
+    easysnmp is imported and when a session is created, so that it need
+    not ask the logger on every request; setting the level here takes
+    effect straight away for existing sessions too.
+
+    :param level: a logging level such as logging.DEBUG
+    """
+
+    logging.getLogger('easysnmp.interface').setLevel(level)
+    refresh_log_level()
+
+
+def refresh_log_level():
+    """
+    Has the C interface check again whether DEBUG messages are wanted,
+    after the levels of the easysnmp loggers (or their parents) were
+    changed other than with set_log_level
+    """
+
+    interface.refresh_log_level()
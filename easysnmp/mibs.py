@@ -0,0 +1,36 @@
+from __future__ import unicode_literals
+
+import os
+
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from . import interface
+
+
+def load_mibs(*modules):
+    """
+    Loads further MIB modules, in addition to those already loaded
+
+    Which MIBs are loaded when easysnmp is imported may be chosen with the
+    EASYSNMP_MIBS environment variable, to save parsing every MIB on the
+    search path in processes which only need a few:
+
+    * ``lazy`` loads no MIBs until they are first needed, by a session
+      without use_numeric or to translate a symbolic OID, and then loads
+      them all; unless some were loaded with load_mibs before then, in
+      which case only those are ever loaded
+    * ``numeric`` never loads any MIBs, so that only numeric OIDs may be
+      used (along with use_numeric)
+    * a list of modules such as ``SNMPv2-MIB:IF-MIB`` loads just those, as
+      Net-SNMP's own MIBS variable does
+
+    Left unset (or empty), every MIB Net-SNMP is configured to load is
+    loaded.  Neither MIBS nor MIBDIRS is changed for programs the process
+    runs later.
+
+    :param modules: the names of MIB modules (e.g. 'IF-MIB') or paths of
+                    MIB files to load
+    """
+
+    for module in modules:
+        interface.load_mib(module)
@@ -0,0 +1,118 @@
+from __future__ import unicode_literals
+
+import os
+
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from . import interface
+
+from .exceptions import EasySNMPError, EasySNMPNoSuchNameError
+from .session import build_varlist, validate_results
+
+# Operations which may be requested through poll_many
+OPERATIONS = ('get', 'get_next', 'get_bulk', 'walk', 'bulkwalk')
+
+
+def finish_result(session, is_list, responsevars):
+    """
+    Turns the result of a request performed by interface.poll_many into
+    what the equivalent Session method would have returned (or raised)
+    """
+
+    if not isinstance(responsevars, Exception):
+        # Validate the variable list returned
+        if session.abort_on_nonexistent:
+            try:
+                validate_results(responsevars)
+            except EasySNMPError as e:
+                responsevars = e
+
+    if isinstance(responsevars, Exception) or is_list:
+        return responsevars
+    else:
+        return responsevars[0]
+
+
+def poll_many(requests, timeout=None, max_in_flight=0):
+    """
+    Perform SNMP operations against many sessions concurrently, sending
+    every request up front and processing the responses as they arrive
+    rather than waiting on each agent in turn
+
+    :param requests: a list of (session, operation, oids) tuples, where
+                     operation is one of 'get', 'get_next', 'get_bulk',
+                     'walk' or 'bulkwalk' and oids is passed as to the
+                     Session method of the same name; get_bulk and
+                     bulkwalk requests may append non_repeaters and
+                     max_repetitions to the tuple
+    :param timeout: the overall time in seconds to wait for all responses;
+                    requests still outstanding after this time will fail
+                    with EasySNMPTimeoutError (each session still applies
+                    its own timeout and retries to its requests)
+    :param max_in_flight: limit on the number of requests outstanding at
+                          any one time, 0 for no limit
+    :return: a list with one item for each request in the same order,
+             holding the result for that request as the equivalent Session
+             method would have returned it, or the exception which would
+             have been raised
+
+    The NOSUCHNAME errors of SNMP v1 get and get_next requests are not
+    repaired by retry_no_such while polling, as that takes a further
+    request for each missing OID; instead the requests which failed with
+    one are performed again by the Session method once the others have
+    completed, so that they return what that method would have (though
+    without regard for timeout).
+    """
+
+    results = [None] * len(requests)
+    pending = []
+    pending_ind = []
+
+    for ind, request in enumerate(requests):
+        session, operation, oids = request[:3]
+        args = tuple(request[3:])
+
+        if operation not in OPERATIONS:
+            raise ValueError(
+                'unsupported operation {0}'.format(operation)
+            )
+
+        if operation in ('get_bulk', 'bulkwalk') and session.version == 1:
+            results[ind] = EasySNMPError(
+                'you cannot perform a {0} operation for SNMP '
+                'version 1'.format(operation.replace('_', ' '))
+            )
+            continue
+
+        # Build our variable bindings for the C interface
+        varlist, is_list = build_varlist(oids)
+
+        # get and get_next return a single item when passed one
+        if operation not in ('get', 'get_next'):
+            is_list = True
+
+        pending.append((session, operation, varlist) + args)
+        pending_ind.append((ind, is_list, oids))
+
+    # Perform all the SNMP operations at once
+    responses = interface.poll_many(
+        pending, float(timeout or 0), int(max_in_flight)
+    )
+
+    for (ind, is_list, oids), request, responsevars in zip(
+        pending_ind, pending, responses
+    ):
+        session, operation = request[:2]
+        results[ind] = finish_result(session, is_list, responsevars)
+
+        # Let the Session method elide the missing OIDs with retry_no_such
+        if (
+            isinstance(results[ind], EasySNMPNoSuchNameError) and
+            session.retry_no_such and operation in ('get', 'get_next')
+        ):
+            try:
+                results[ind] = getattr(session, operation)(oids)
+            except EasySNMPError as e:
+                results[ind] = e
+
+    return results
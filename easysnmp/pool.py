@@ -0,0 +1,176 @@
+from __future__ import unicode_literals
+
+import threading
+from collections import defaultdict
+from contextlib import contextmanager
+
+from .exceptions import EasySNMPError
+from .session import Session
+
+
+class SessionPool(object):
+    """
+    A thread-safe pool of sessions which may be shared by many worker
+    threads.  Sessions are sharded by agent: every distinct hostname (and
+    set of session arguments) has sessions of its own, and a session is
+    only ever used by the one thread which has checked it out, so that
+    threads never share a Net-SNMP handle.
+
+    :param max_sessions_per_host: the most sessions which are opened to any
+                                  one agent; a thread checking out another
+                                  waits until one is returned
+    :param session_kwargs: the arguments of every Session created by the
+                           pool (e.g. version=2, community='public') which
+                           may be overridden when checking one out
+    """
+
+    def __init__(self, max_sessions_per_host=4, **session_kwargs):
+        self.max_sessions_per_host = max_sessions_per_host
+        self.session_kwargs = session_kwargs
+
+        self._cond = threading.Condition()
+        self._idle = defaultdict(list)
+        self._num_open = defaultdict(int)
+        self._checked_out = {}
+        self._closed = False
+
+    def acquire(self, hostname='localhost', **kwargs):
+        """
+        Checks out a session to an agent for the exclusive use of the
+        calling thread, reusing an idle one where possible; it must be
+        returned with release once the thread is done with it
+
+        :param hostname: hostname or IP address of SNMP agent
+        :param kwargs: any Session arguments which differ from those the
+                       pool was created with
+        :return: a Session object
+        """
+
+        session_kwargs = dict(self.session_kwargs)
+        session_kwargs.update(kwargs)
+        session_kwargs['hostname'] = hostname
+        key = tuple(sorted(session_kwargs.items()))
+
+        with self._cond:
+            while True:
+                if self._closed:
+                    raise EasySNMPError('the session pool has been closed')
+
+                if self._idle[key]:
+                    session = self._idle[key].pop()
+                    self._checked_out[id(session)] = (key, session)
+                    return session
+
+                if self._num_open[key] < self.max_sessions_per_host:
+                    self._num_open[key] += 1
+                    break
+
+                self._cond.wait()
+
+        # Opening a session may take a while (e.g. SNMPv3 discovery) so
+        # don't hold up other threads while doing so
+        try:
+            session = Session(**session_kwargs)
+        except Exception:
+            with self._cond:
+                self._num_open[key] -= 1
+                self._cond.notify_all()
+            raise
+
+        with self._cond:
+            self._checked_out[id(session)] = (key, session)
+
+        return session
+
+    def release(self, session, discard=False):
+        """
+        Returns a session checked out with acquire to the pool
+
+        :param session: the Session object to return
+        :param discard: close the session rather than keeping it for reuse
+                        (e.g. when the agent has stopped responding)
+        """
+
+        with self._cond:
+            key, _ = self._checked_out.pop(id(session))
+
+            if discard or self._closed:
+                self._num_open[key] -= 1
+            else:
+                self._idle[key].append(session)
+
+            self._cond.notify_all()
+
+    @contextmanager
+    def session(self, hostname='localhost', **kwargs):
+        """
+        Checks out a session for the duration of a with statement
+        (e.g. with pool.session('router1') as session: ...), as for acquire
+        """
+
+        session = self.acquire(hostname, **kwargs)
+        try:
+            yield session
+        finally:
+            self.release(session)
+
+    def map(self, func, hostnames, max_workers=4, **kwargs):
+        """
+        Calls func with a session to each of the agents given, using up to
+        max_workers threads at a time
+
+        :param func: a function taking a Session object
+                     (e.g. lambda session: session.get('sysUpTime.0'))
+        :param hostnames: a list of the hostnames or IP addresses of the
+                          agents
+        :param max_workers: the number of worker threads to use
+        :param kwargs: any Session arguments which differ from those the
+                       pool was created with
+        :return: a list of the results of func in the same order as
+                 hostnames; the exception is given in place of the result
+                 where func raised one
+        """
+
+        hostnames = list(hostnames)
+        results = [None] * len(hostnames)
+        tasks = iter(enumerate(hostnames))
+        tasks_lock = threading.Lock()
+
+        def worker():
+            while True:
+                with tasks_lock:
+                    try:
+                        index, hostname = next(tasks)
+                    except StopIteration:
+                        return
+
+                try:
+                    with self.session(hostname, **kwargs) as session:
+                        results[index] = func(session)
+                except Exception as e:
+                    results[index] = e
+
+        workers = [
+            threading.Thread(target=worker)
+            for _ in range(max(1, min(max_workers, len(hostnames))))
+        ]
+        for thread in workers:
+            thread.daemon = True
+            thread.start()
+        for thread in workers:
+            thread.join()
+
+        return results
+
+    def close(self):
+        """
+        Closes every idle session and any session returned from now on;
+        sessions may no longer be checked out
+        """
+
+        with self._cond:
+            self._closed = True
+            for key, sessions in self._idle.items():
+                self._num_open[key] -= len(sessions)
+            self._idle.clear()
+            self._cond.notify_all()
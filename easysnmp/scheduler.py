@@ -0,0 +1,346 @@
+from __future__ import unicode_literals
+
+import heapq
+import itertools
+import os
+import threading
+import time
+from collections import defaultdict
+
+try:
+    import queue
+except ImportError:  # Python 2
+    import Queue as queue
+
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from . import interface
+
+from .exceptions import EasySNMPError
+from .poll import OPERATIONS, finish_result
+
+try:
+    monotonic = time.monotonic
+except AttributeError:  # Python 2
+    monotonic = time.time
+
+# The arguments of get_bulk and bulkwalk which poll_many takes, in order
+BULK_ARGUMENTS = (('non_repeaters', 0), ('max_repetitions', 10))
+
+
+class PollJob(object):
+    """
+    A prepared request which a PollScheduler performs every interval
+    seconds, as returned by PollScheduler.add
+    """
+
+    def __init__(self, request, interval, next_run):
+        #: the PreparedRequest performed
+        self.request = request
+
+        #: the number of seconds between polls
+        self.interval = interval
+
+        #: when the job is next due, in seconds on the scheduler's clock
+        self.next_run = next_run
+
+        #: the number of polls skipped as they could not be started in time
+        self.missed = 0
+
+        #: the number of packets each poll is estimated to send
+        self.packets = 1
+
+        self.cancelled = False
+
+    @property
+    def deadline(self):
+        """
+        The time by which the poll due should be done: when the next one
+        is due
+        """
+
+        return self.next_run + self.interval
+
+
+class PollScheduler(object):
+    """
+    Polls prepared requests on many sessions at regular intervals, with a
+    pool of worker threads each performing a batch of the jobs due at a
+    time concurrently through poll_many (which waits on the network without
+    holding the GIL).  The jobs due are started in order of deadline, that
+    is the time by which each must be done as its next poll is then due,
+    within limits on the number of requests in flight to any one agent and
+    on the number of packets sent per second overall.  Each result is put
+    on the results queue as a (job, result, timestamp) tuple.
+
+    :param workers: the number of worker threads
+    :param max_per_agent: the most requests in flight to any one agent
+                          (hostname and port) at once
+    :param max_pps: the most packets sent per second overall, 0 for no
+                    limit; the packets of each poll are estimated from the
+                    number of OIDs it requests (and for walks, from the size
+                    of the previous result)
+    :param timeout: the overall time in seconds each batch may take, as for
+                    poll_many
+    :param results: the queue to put results on; defaults to a new
+                    queue.Queue
+    """
+
+    def __init__(self, workers=1, max_per_agent=1, max_pps=0, timeout=None,
+                 results=None):
+        self.workers = max(1, int(workers))
+        self.max_per_agent = max(1, int(max_per_agent))
+        self.max_pps = float(max_pps)
+        self.timeout = timeout
+
+        #: the queue of (job, result, timestamp) tuples, where result is
+        #: what the Session method would have returned, or the exception
+        #: it would have raised, and timestamp is the time.time() at which
+        #: the poll was done
+        self.results = queue.Queue() if results is None else results
+
+        self._cond = threading.Condition()
+        self._due = []
+        self._seq = itertools.count()
+        self._agent_in_flight = defaultdict(int)
+        self._busy_sessions = set()
+        self._tokens = self.max_pps
+        self._refilled = monotonic()
+        self._threads = []
+        self._running = False
+
+    @staticmethod
+    def _agent(session):
+        return session.hostname, session.remote_port
+
+    def add(self, request, interval, delay=0):
+        """
+        Adds a job polling a prepared request every interval seconds
+
+        :param request: a PreparedRequest (see Session.prepare) of a get,
+                        get_next, get_bulk, walk or bulkwalk
+        :param interval: the number of seconds between polls
+        :param delay: the number of seconds before the first poll is due
+        :return: the PollJob, which may be passed to remove
+        """
+
+        if request.op not in OPERATIONS:
+            raise ValueError('unsupported operation {0}'.format(request.op))
+
+        if request.op in ('get_bulk', 'bulkwalk') and \
+                request.session.version == 1:
+            raise EasySNMPError(
+                'you cannot perform a {0} operation for SNMP '
+                'version 1'.format(request.op.replace('_', ' '))
+            )
+
+        unsupported = set(request.kwargs) - set(
+            name for name, _ in BULK_ARGUMENTS
+        )
+        if unsupported:
+            raise ValueError('unsupported arguments {0}'.format(
+                ', '.join(sorted(unsupported))
+            ))
+
+        if interval <= 0:
+            raise ValueError('the interval must be positive')
+
+        job = PollJob(request, float(interval), monotonic() + delay)
+        job.packets = self._estimate_packets(job, None)
+
+        with self._cond:
+            self._push(job)
+            self._cond.notify_all()
+
+        return job
+
+    def remove(self, job):
+        """
+        Stops polling a job; a poll already in progress still puts its
+        result on the queue
+
+        :param job: a PollJob returned by add
+        """
+
+        with self._cond:
+            job.cancelled = True
+
+    def start(self):
+        """
+        Starts the worker threads
+        """
+
+        with self._cond:
+            if self._running:
+                return
+            self._running = True
+
+            self._threads = [
+                threading.Thread(target=self._work)
+                for _ in range(self.workers)
+            ]
+            for thread in self._threads:
+                thread.daemon = True
+                thread.start()
+
+    def stop(self):
+        """
+        Stops the worker threads, waiting for any batch in progress to be
+        done
+        """
+
+        with self._cond:
+            self._running = False
+            self._cond.notify_all()
+
+        for thread in self._threads:
+            thread.join()
+        self._threads = []
+
+    def _push(self, job):
+        heapq.heappush(self._due, (job.next_run, next(self._seq), job))
+
+    @staticmethod
+    def _estimate_packets(job, result):
+        request = job.request
+        num_oids = len(request.varlist)
+
+        if request.op in ('get', 'get_next'):
+            per_pdu = request.session.max_varbinds_per_pdu or num_oids
+            return max(1, -(-num_oids // max(1, per_pdu)))
+        elif request.op == 'get_bulk':
+            return max(1, num_oids)
+        elif isinstance(result, list):
+            # A walk sends a request for each response, which for GETNEXT
+            # holds a single variable
+            per_pdu = 1
+            if request.op == 'bulkwalk':
+                per_pdu = max(1, dict(BULK_ARGUMENTS, **request.kwargs)[
+                    'max_repetitions'
+                ])
+            return max(1, len(result) // per_pdu + num_oids)
+        else:
+            return job.packets
+
+    def _take_batch(self):
+        """
+        Takes the due jobs which may be started now, most urgent first,
+        reserving their agents, sessions and packets; returns them and how
+        long to wait before trying again when there are none (None when
+        only a batch in progress can free what is needed)
+        """
+
+        now = monotonic()
+        if self.max_pps > 0:
+            self._tokens = min(
+                self.max_pps,
+                self._tokens + (now - self._refilled) * self.max_pps
+            )
+        self._refilled = now
+
+        due = []
+        while self._due and self._due[0][0] <= now:
+            job = heapq.heappop(self._due)[2]
+            if not job.cancelled:
+                due.append(job)
+        due.sort(key=lambda job: job.deadline)
+
+        wait = self._due[0][0] - now if self._due else None
+
+        batch = []
+        batch_sessions = set()
+        out_of_packets = False
+        for job in due:
+            session = job.request.session
+            agent = self._agent(session)
+            packets = min(job.packets, self.max_pps)
+
+            if out_of_packets or (
+                id(session) in self._busy_sessions and
+                id(session) not in batch_sessions
+            ) or self._agent_in_flight[agent] >= self.max_per_agent:
+                self._push(job)
+                continue
+
+            if self.max_pps > 0 and packets > self._tokens:
+                # Later jobs must not overtake this one
+                out_of_packets = True
+                refill = (packets - self._tokens) / self.max_pps
+                wait = refill if wait is None else min(wait, refill)
+                self._push(job)
+                continue
+
+            if self.max_pps > 0:
+                self._tokens -= packets
+            self._agent_in_flight[agent] += 1
+            batch_sessions.add(id(session))
+            batch.append(job)
+
+        self._busy_sessions.update(batch_sessions)
+
+        return batch, wait
+
+    def _poll(self, batch):
+        pending = []
+        for job in batch:
+            request = job.request
+            args = ()
+            if request.op in ('get_bulk', 'bulkwalk'):
+                args = tuple(
+                    int(request.kwargs.get(name, default))
+                    for name, default in BULK_ARGUMENTS
+                )
+            pending.append(
+                (request.session, request.op, request.varlist) + args
+            )
+
+        try:
+            responses = interface.poll_many(
+                pending, float(self.timeout or 0), 0
+            )
+        except Exception as e:
+            responses = [e] * len(batch)
+
+        finished = monotonic()
+        timestamp = time.time()
+
+        with self._cond:
+            for job, responsevars in zip(batch, responses):
+                session = job.request.session
+                self._agent_in_flight[self._agent(session)] -= 1
+                self._busy_sessions.discard(id(session))
+
+                job.packets = self._estimate_packets(job, responsevars)
+
+                # Skip any polls which could no longer be done in time
+                job.next_run += job.interval
+                while job.deadline < finished:
+                    job.next_run += job.interval
+                    job.missed += 1
+
+                if not job.cancelled:
+                    self._push(job)
+
+            self._cond.notify_all()
+
+        for job, responsevars in zip(batch, responses):
+            request = job.request
+            is_list = request.is_list or request.op not in ('get', 'get_next')
+            self.results.put((
+                job, finish_result(request.session, is_list, responsevars),
+                timestamp
+            ))
+
+    def _work(self):
+        while True:
+            with self._cond:
+                while True:
+                    if not self._running:
+                        return
+
+                    batch, wait = self._take_batch()
+                    if batch:
+                        break
+                    self._cond.wait(wait)
+
+            self._poll(batch)
@@ -2,6 +2,7 @@ from __future__ import unicode_literals
 
 import os
 import re
+from collections import OrderedDict
 
 # Don't attempt to import the C interface if building docs on RTD
 if not os.environ.get('READTHEDOCS', False):  # noqa
@@ -37,6 +38,10 @@ def build_varlist(oids):
              whether or not the first tuple item is a list or single item
     """
 
+    # Prepared requests were already built and translated
+    if isinstance(oids, PreparedRequest):
+        return oids.varlist, oids.is_list
+
     if isinstance(oids, list):
         is_list = True
     else:
@@ -59,6 +64,38 @@ def build_varlist(oids):
     return varlist, is_list
 
 
+def build_set_varlist(oid_values):
+    """
+    Prepare the variable binding list of values to be set which will be
+    used by the C interface
+
+    :param oid_values: a list of tuples whereby each tuple contains a
+                       (oid, value) or an (oid, value, snmp_type)
+    :return: a list of SNMPVariable objects
+    """
+
+    varlist = SNMPVariableList()
+    for oid_value in oid_values:
+        if len(oid_value) == 2:
+            oid, value = oid_value
+            snmp_type = None
+        # TODO: Determine the best way to test this
+        else:
+            oid, value, snmp_type = oid_value
+
+        # OIDs specified as a tuple (e.g. ('sysContact', 0))
+        if isinstance(oid, tuple):
+            oid, oid_index = oid
+            varlist.append(SNMPVariable(oid, oid_index, value, snmp_type))
+        # OIDs specefied as a string (e.g. 'sysContact.0')
+        else:
+            varlist.append(
+                SNMPVariable(oid, value=value, snmp_type=snmp_type)
+            )
+
+    return varlist
+
+
 def validate_results(varlist):
     """
     Validates a list of SNMPVariable objects and raises any appropriate
@@ -84,6 +121,25 @@ def validate_results(varlist):
             )
 
 
+# Session operations which may be prepared ahead of time with Session.prepare
+PREPARED_OPERATIONS = frozenset([
+    'get', 'get_next', 'get_bulk', 'walk', 'bulkwalk', 'iter_bulkwalk',
+    'bulkwalk_table'
+])
+
+# Session options which the C interface caches for each session; they are
+# reloaded whenever one of them is assigned to
+CACHED_OPTIONS = frozenset([
+    'version', 'use_long_names', 'use_numeric', 'use_sprint_value',
+    'use_enums', 'best_guess', 'retry_no_such', 'max_varbinds_per_pdu',
+    'use_native_types', 'missing_oid_ttl', 'use_bytes'
+])
+
+# The most OIDs for which a session remembers where pipelined_walk split
+# their last walk; the split of the least recently walked is forgotten
+MAX_WALK_SPLITS = 64
+
+
 class Session(object):
     """
     A Net-SNMP session which may be setup once and then used to query and
@@ -155,10 +211,42 @@ class Session(object):
                           resent; undef will be returned for all NOSUCH
                           SNMP variables, when set to False this feature is
                           disabled and the entire get request will fail on
-                          any NOSUCH error (applies to v1 only)
+                          any NOSUCH error (applies to v1 only); with
+                          missing_oid_ttl set, the OIDs found missing are
+                          remembered for that long and left out of later
+                          get requests on the session.  Only get and
+                          get_next are repaired: walk, get_bulk and
+                          bulkwalk requests are never resent, and fail on
+                          a NOSUCH error as when this is disabled
     :param abort_on_nonexistent: raise an exception if no object or no
                                  instance is found for the given oid and
                                  oid index
+    :param max_varbinds_per_pdu: the maximum number of OIDs packed into a
+                                 single request PDU by get and get_next;
+                                 the default of 1 sends one request per
+                                 OID, while 0 packs every OID into one
+                                 request; requests which the agent rejects
+                                 as too big are split and retried
+    :param use_native_types: set to True to have values returned as native
+                             Python types by SNMP type rather than as
+                             strings; integer types (including counters,
+                             gauges and timeticks) as ints, OCTET STR and
+                             Opaque as bytes, OBJECT IDENTIFIERs as tuples
+                             of ints and NULL as None, while other types
+                             are still returned as strings (use_enums
+                             takes precedence for enumerated INTEGERs and
+                             use_sprint_value disables this option)
+    :param missing_oid_ttl: the number of seconds for which OIDs that the
+                            agent answered NOSUCHOBJECT or NOSUCHINSTANCE
+                            to are remembered, and answered the same way
+                            by get without asking the agent again, as are
+                            those found missing by retry_no_such; 0 (the
+                            default) disables this
+    :param use_bytes: set to True to have OCTET STR and Opaque values
+                      returned as bytes, exactly as received, without
+                      otherwise changing how values are returned as
+                      use_native_types does (use_sprint_value disables
+                      this option)
     """
 
     def __init__(
@@ -171,7 +259,9 @@ class Session(object):
         our_identity='', their_identity='', their_hostname='',
         trust_cert='', use_long_names=False, use_numeric=False,
         use_sprint_value=False, use_enums=False, best_guess=0,
-        retry_no_such=False, abort_on_nonexistent=False
+        retry_no_such=False, abort_on_nonexistent=False,
+        max_varbinds_per_pdu=1, use_native_types=False, missing_oid_ttl=0,
+        use_bytes=False
     ):
         # Validate and extract the remote port
         if ':' in hostname:
@@ -213,6 +303,10 @@ class Session(object):
         self.best_guess = best_guess
         self.retry_no_such = retry_no_such
         self.abort_on_nonexistent = abort_on_nonexistent
+        self.max_varbinds_per_pdu = int(max_varbinds_per_pdu)
+        self.use_native_types = use_native_types
+        self.missing_oid_ttl = int(missing_oid_ttl)
+        self.use_bytes = use_bytes
 
         # The following variables are required for internal use as they are
         # passed to the C interface
@@ -220,6 +314,9 @@ class Session(object):
         #: internal field used to cache a created session structure
         self.sess_ptr = None
 
+        #: internal field holding where to split each pipelined walk
+        self._walk_splits = OrderedDict()
+
         #: read-only, holds the error message assoc. w/ last request
         self.error_string = ''
 
@@ -286,6 +383,13 @@ class Session(object):
                 timeout_microseconds
             )
 
+    def __setattr__(self, name, value):
+        super(Session, self).__setattr__(name, value)
+
+        # Let the C interface pick up the new value of a cached option
+        if name in CACHED_OPTIONS and self.__dict__.get('sess_ptr'):
+            interface.update_session(self)
+
     @property
     def connect_hostname(self):
         if self.remote_port:
@@ -359,29 +463,45 @@ class Session(object):
                  were retrieved via SNMP
         """
 
-        varlist = SNMPVariableList()
-        for oid_value in oid_values:
-            if len(oid_value) == 2:
-                oid, value = oid_value
-                snmp_type = None
-            # TODO: Determine the best way to test this
-            else:
-                oid, value, snmp_type = oid_value
-
-            # OIDs specified as a tuple (e.g. ('sysContact', 0))
-            if isinstance(oid, tuple):
-                oid, oid_index = oid
-                varlist.append(SNMPVariable(oid, oid_index, value, snmp_type))
-            # OIDs specefied as a string (e.g. 'sysContact.0')
-            else:
-                varlist.append(
-                    SNMPVariable(oid, value=value, snmp_type=snmp_type)
-                )
+        varlist = build_set_varlist(oid_values)
 
         # Perform the set operation and return whether or not it worked
         success = interface.set(self, varlist)
         return bool(success)
 
+    def set_batch(self, oid_values, max_in_flight=4, max_varbinds_per_pdu=0):
+        """
+        Perform SNMP SET operations on many OIDs at once, packing as many
+        values into each request as the agent accepts and keeping several
+        requests in flight.
+        Unlike set_multiple, a value the agent refuses does not stop the
+        others being set: each request is resent without the value it
+        was refused for, and requests which are too big are split.  A
+        request which fails while the agent applies it (commitFailed,
+        undoFailed or genErr) is not resent, as some of its values may
+        have been set, and every value in it gets that status.
+
+        :param oid_values: a list of tuples whereby each tuple contains a
+                           (oid, value) or an (oid, value, snmp_type)
+        :param max_in_flight: the number of requests to send before waiting
+                              for a response
+        :param max_varbinds_per_pdu: the most values sent in each request,
+                                     0 to start with every value in one
+                                     request and split it for as long as
+                                     the agent replies tooBig (the
+                                     session's option of the same name is
+                                     not used here)
+        :return: a list with the status of each SET in the same order as
+                 oid_values; 0 (noError) where the value was set, the SNMP
+                 error status (e.g. 17 for notWritable) where it was not,
+                 or None if the agent never responded
+        """
+
+        varlist = build_set_varlist(oid_values)
+        return interface.set_batch(
+            self, varlist, max_in_flight, max_varbinds_per_pdu
+        )
+
     def get_next(self, oids):
         """
         Uses an SNMP GETNEXT operation using the prepared session to
@@ -446,6 +566,48 @@ class Session(object):
         # Return a list of variables
         return responsevars
 
+    def get_bulk_columns(self, scalars, columns, max_repetitions=10):
+        """
+        Retrieves scalars and the first rows of table columns in a single
+        SNMP GETBULK request, the scalars being sent as non-repeaters and
+        the columns as repeaters, and splits the response back into the
+        scalars and the rows of each column (e.g. sysUpTime along with a
+        few interface columns in one round trip)
+
+        :param scalars: a list of OIDs each of which returns the one
+                        variable after it, as for get_next
+                        (e.g. ['sysUpTime']); may be empty
+        :param columns: a list of the column OIDs to retrieve rows of
+                        (e.g. ['ifDescr', 'ifOperStatus'])
+        :param max_repetitions: the most rows to retrieve of each column;
+                                a column with more rows than the agent
+                                returns must be walked for the rest
+        :return: a tuple of the list of SNMPVariable objects of the scalars,
+                 one for each OID in scalars in the same order (with an
+                 snmp_type of ENDOFMIBVIEW for one past the end of the
+                 agent's MIB), and a list holding the list of SNMPVariable
+                 objects of each column, in the same order as the columns
+        """
+
+        if self.version == 1:
+            raise EasySNMPError(
+                'you cannot perform a bulk GET operation for SNMP version 1'
+            )
+
+        scalar_varlist, _ = build_varlist(scalars)
+        column_varlist, _ = build_varlist(columns)
+
+        scalarvars, columnvars = interface.getbulk_columns(
+            self, list(scalar_varlist) + list(column_varlist),
+            len(scalar_varlist), max_repetitions
+        )
+
+        # Validate the variable list returned
+        if self.abort_on_nonexistent:
+            validate_results(scalarvars)
+
+        return scalarvars, columnvars
+
     def walk(self, oids='.1.3.6.1.2.1'):
         """
         Uses SNMP GETNEXT operation using the prepared session to
@@ -473,8 +635,83 @@ class Session(object):
         # Return a list of variables
         return responsevars
 
+    def pipelined_walk(self, oids='.1.3.6.1.2.1', max_in_flight=4, rows=0,
+                       split_oids=None):
+        """
+        Uses SNMP GETNEXT operations like walk, but splits the subtree under
+        each OID into ranges which are walked side by side, keeping up to
+        max_in_flight requests in flight at once; this is for agents which
+        only speak SNMP version 1 and so have no GETBULK, where a walk over
+        a slow link would otherwise wait out one round trip per variable
+
+        The ranges are split at the columns of the table (or the children
+        of the MIB node) being walked, and at the variables which split the
+        results of the previous pipelined walk of the same OID into equal
+        parts, much as a first walk of a table learns where later walks of
+        it should be split (for up to MAX_WALK_SPLITS OIDs, forgetting those
+        least recently walked).
+
+        :param oids: you may pass in a single item
+                     * string representing the
+                     entire OID (e.g. 'ifTable')
+                     * tuple (name, index) (e.g. ('ifDescr', None))
+                     * list of OIDs, which are walked one after the other
+        :param max_in_flight: the most GETNEXT requests sent at once
+        :param rows: the number of rows expected (e.g. the value of
+                     ifNumber) so that the columns of a table walked for the
+                     first time may be split into ranges of rows too
+        :param split_oids: a list of OIDs to split the ranges at, instead
+                           of those learned or taken from the MIB
+        :return: a list of SNMPVariable objects containing the values that
+                 were retrieved via SNMP, in the same order as walk
+        """
+
+        max_in_flight = max(1, int(max_in_flight))
+
+        # Build our variable bindings for the C interface
+        varlist, _ = build_varlist(oids)
+
+        if split_oids is not None:
+            split_varlist, _ = build_varlist(split_oids)
+            split_varlist = list(split_varlist)
+
+        responsevars = SNMPVariableList()
+        for varbind in varlist:
+            key = (varbind.oid, varbind.oid_index)
+            if split_oids is None:
+                split_varlist = self._walk_splits.pop(key, [])
+
+            walked = interface.walk_pipelined(
+                self, [varbind] + split_varlist, max_in_flight, int(rows)
+            )
+
+            # Remember where to split this walk for the next time
+            if split_oids is None and len(walked) > max_in_flight:
+                self._walk_splits[key] = [
+                    SNMPVariable(walked[i].oid, walked[i].oid_index)
+                    for i in (
+                        len(walked) * part // max_in_flight
+                        for part in range(1, max_in_flight)
+                    )
+                ]
+            elif split_oids is None and split_varlist:
+                self._walk_splits[key] = split_varlist
+
+            while len(self._walk_splits) > MAX_WALK_SPLITS:
+                self._walk_splits.popitem(last=False)
+
+            responsevars.extend(walked)
+
+        # Validate the variable list returned
+        if self.abort_on_nonexistent:
+            validate_results(responsevars)
+
+        # Return a list of variables
+        return responsevars
+
     def bulkwalk(
-        self, oids='.1.3.6.1.2.1', non_repeaters=0, max_repetitions=10
+        self, oids='.1.3.6.1.2.1', non_repeaters=0, max_repetitions=10,
+        parallel=False, adaptive=False
     ):
         """
         Uses SNMP GETBULK operation using the prepared session to
@@ -490,6 +727,18 @@ class Session(object):
                               instances
         :param max_repetitions: the number of objects that should be returned
                                 for all the repeating OIDs
+        :param parallel: walk every OID in the same GETBULK requests, one
+                         varbind per OID, rather than one OID after the
+                         other; the results are returned in the same
+                         order and non_repeaters is ignored
+        :param adaptive: tune max_repetitions from each response, growing
+                         it while responses come back quickly and fit in a
+                         single packet and shrinking it when the agent
+                         replies too big (a request which times out is
+                         retried with fewer repetitions only once per
+                         walk); max_repetitions only seeds the first walk
+                         as the value learned is remembered by the session
+                         for later walks
         :return: a list of SNMPVariable objects containing the values that
                  were retrieved via SNMP
         """
@@ -503,7 +752,10 @@ class Session(object):
         varlist, _ = build_varlist(oids)
 
         # Perform the SNMP walk using GETNEXT operations
-        responsevars = interface.bulkwalk(self, varlist, non_repeaters, max_repetitions)
+        responsevars = interface.bulkwalk(
+            self, varlist, non_repeaters, max_repetitions, int(parallel),
+            int(adaptive)
+        )
 
         # Validate the variable list returned
         if self.abort_on_nonexistent:
@@ -511,3 +763,186 @@ class Session(object):
 
         # Return a list of variables
         return responsevars
+
+    def iter_bulkwalk(
+        self, oids='.1.3.6.1.2.1', max_repetitions=10, parallel=False,
+        adaptive=False
+    ):
+        """
+        Uses SNMP GETBULK operation like bulkwalk but rather than returning
+        every variable at the end of the walk, returns an iterator which
+        yields a list of the SNMPVariable objects from each response as
+        soon as it arrives; the walk only proceeds as the iterator is
+        consumed
+
+        :param oids: you may pass in a single item or a list of OIDs, as
+                     for bulkwalk
+        :param max_repetitions: the number of objects that should be returned
+                                in each response
+        :param parallel: walk every OID in the same GETBULK requests rather
+                         than one OID after the other (see bulkwalk)
+        :param adaptive: tune max_repetitions from each response (see
+                         bulkwalk)
+        :return: an iterator over lists of SNMPVariable objects
+        """
+
+        if self.version == 1:
+            raise EasySNMPError(
+                'you cannot perform a bulk walk operation for SNMP version 1'
+            )
+
+        # Build our variable bindings for the C interface
+        varlist, _ = build_varlist(oids)
+
+        # Prepare the walk, nothing is sent until the first batch is needed
+        batches = interface.iter_bulkwalk(
+            self, varlist, max_repetitions, int(parallel), int(adaptive)
+        )
+
+        # Validate each batch of variables as it is returned
+        if self.abort_on_nonexistent:
+            return self._validated_batches(batches)
+
+        return batches
+
+    def prepare(self, oids, op='get', **kwargs):
+        """
+        Prepares an SNMP operation which will be performed repeatedly, such
+        as a fixed set of OIDs which is polled; the OIDs are parsed and
+        translated only once here rather than every time the request is
+        performed
+
+        :param oids: you may pass in a list of OIDs or single item, as for
+                     the operation being prepared
+        :param op: the name of the Session method performing the operation;
+                   one of get, get_next, get_bulk, walk, bulkwalk,
+                   iter_bulkwalk or bulkwalk_table
+        :param kwargs: any further arguments of the operation
+                       (e.g. max_repetitions=20)
+        :return: a PreparedRequest object; call its execute method to
+                 perform the operation, which returns the same result as
+                 the Session method would
+        """
+
+        if op not in PREPARED_OPERATIONS:
+            raise ValueError('unsupported operation {0}'.format(op))
+
+        # Build and translate our variable bindings once
+        varlist, is_list = build_varlist(oids)
+        prepared = interface.prepare(self, varlist)
+
+        return PreparedRequest(self, op, prepared, is_list, kwargs)
+
+    @staticmethod
+    def _validated_batches(batches):
+        for responsevars in batches:
+            validate_results(responsevars)
+            yield responsevars
+
+    def bulkwalk_table(self, columns, max_repetitions=10):
+        """
+        Walks the columns of a table side by side and returns the values
+        in columnar form, rather than as one SNMPVariable per value; SNMP
+        GETBULK is used for SNMP version 2 and 3 and GETNEXT for version 1
+
+        :param columns: a list of the column OIDs to walk
+                        (e.g. ['ifDescr', 'ifOperStatus']); each item may be
+                        a string or a tuple as for walk
+        :param max_repetitions: the number of rows that should be returned
+                                in each response
+        :return: an (index, columns) tuple: index is a list of the row
+                 indexes (e.g. ['1', '2']) and columns a dict holding,
+                 under each column OID as given, a list of the values of
+                 that column aligned with the index; None is given where a
+                 row has no value for a column
+        """
+
+        # Build our variable bindings for the C interface
+        varlist, _ = build_varlist(columns)
+
+        # Perform the table walk
+        return interface.bulkwalk_table(self, varlist, max_repetitions)
+
+    def walk_export(self, oids='.1.3.6.1.2.1', format='ndjson',
+                    max_repetitions=10):
+        """
+        Walks the subtree under each OID like bulkwalk (or walk for SNMP
+        version 1) but rather than building SNMPVariable objects, encodes
+        every variable straight into serialized records, ready to be
+        passed on (e.g. to a message queue) without a Python encoding pass
+
+        Each record holds the oid, oid_index, snmp_type, root_oid and value
+        an SNMPVariable would have, the value being formatted as if neither
+        use_native_types nor use_bytes were set (use_sprint_value and
+        use_enums do apply); abort_on_nonexistent is not applied.
+
+        :param oids: you may pass in a single item or a list of OIDs, as
+                     for walk; their subtrees are walked side by side and
+                     the records given one subtree after the other
+        :param format: 'ndjson' for a JSON object per line, with strings
+                       holding the values decoded as latin-1 just as
+                       SNMPVariable does; or 'msgpack' for a msgpack map
+                       per record, each preceded by its length as a 4 byte
+                       big endian integer, with OCTET STR and Opaque values
+                       as bin rather than str
+        :param max_repetitions: the number of objects that should be
+                                returned in each GETBULK response
+        :return: the records as bytes
+        """
+
+        if format not in ('ndjson', 'msgpack'):
+            raise ValueError('unsupported format {0}'.format(format))
+
+        # Build our variable bindings for the C interface
+        varlist, _ = build_varlist(oids)
+
+        # Perform the walk, records are encoded as each response arrives
+        return interface.walk_export(self, varlist, format, max_repetitions)
+
+    def stats(self, reset=False):
+        """
+        Returns what this session has seen of its agent since it was
+        created or its statistics were last reset, from which slow or
+        unreliable agents may be picked out
+
+        :param reset: start counting afresh once the statistics are taken
+        :return: a dict holding the counts of pdus_sent, responses,
+                 retries (retransmissions, as inferred from each round trip
+                 time), timeouts, nosuch_retries (requests resent without the
+                 OIDs refused by a retry_no_such GET), varbinds_decoded and
+                 bytes_received (the encoded size of the varbinds in those
+                 responses), along with rtt_total, the total round trip time
+                 in seconds, and rtt_histogram, a list of (upper bound in
+                 seconds, count) tuples whose last bound is None
+        """
+
+        return interface.session_stats(self, reset)
+
+
+class PreparedRequest(object):
+    """
+    An SNMP operation prepared with Session.prepare, whose OIDs have
+    already been parsed and translated; it may be performed as often as
+    required using execute.  A prepared request may also be passed as the
+    oids of any operation of its session it could have been prepared for.
+
+    Note that the OIDs are translated using the best_guess option of the
+    session at the time the request is prepared.
+    """
+
+    def __init__(self, session, op, varlist, is_list, kwargs):
+        self.session = session
+        self.op = op
+        self.varlist = varlist
+        self.is_list = is_list
+        self.kwargs = kwargs
+
+    def execute(self):
+        """
+        Performs the prepared operation
+
+        :return: the result of the operation, as returned by the Session
+                 method it was prepared for
+        """
+
+        return getattr(self.session, self.op)(self, **self.kwargs)
@@ -0,0 +1,129 @@
+/*
+ * Usage:
+ *
+ * A reusable arena for buffers which all live for the duration of a
+ * single call.  Allocations are carved out of one buffer and released all
+ * at once with simple_arena_reset; when a call needs more than the buffer
+ * holds, the excess is malloc'd separately and the buffer is grown to the
+ * high-water mark on the next reset, so that repeating the same call does
+ * no heap allocation at all.  The buffer is never grown beyond
+ * SIMPLE_ARENA_MAX_SIZE, so that one unusually large call does not leave
+ * its memory tied up in the arena for good.
+ *
+ * {
+ *     simple_arena arena;
+ *     int *values;
+ *
+ *     simple_arena_init(&arena);
+ *     values = simple_arena_alloc(&arena, 16 * sizeof(int));
+ *     simple_arena_reset(&arena); // values is no longer valid
+ *     simple_arena_free(&arena);
+ * }
+ */
+
+#ifndef SIMPLE_ARENA_H
+#define SIMPLE_ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (__STDC_VERSION__ < 199901L)
+#define inline
+#endif
+
+/* every allocation is aligned for any of the types stored in the arena */
+#define SIMPLE_ARENA_ALIGN (2 * sizeof(void *))
+
+#define SIMPLE_ARENA_ROUND(size) \
+    (((size) + SIMPLE_ARENA_ALIGN - 1) & ~(SIMPLE_ARENA_ALIGN - 1))
+
+/* the most the buffer kept between resets may grow to */
+#ifndef SIMPLE_ARENA_MAX_SIZE
+#define SIMPLE_ARENA_MAX_SIZE (32 * 1024)
+#endif
+
+/* allocation which did not fit in the buffer, chained until the reset */
+typedef struct simple_arena_overflow {
+    struct simple_arena_overflow *next;
+} simple_arena_overflow;
+
+typedef struct simple_arena {
+    unsigned char *buf;
+    size_t size;
+    size_t used;
+    size_t wanted; /* bytes requested since the last reset */
+    simple_arena_overflow *overflow;
+} simple_arena;
+
+static inline void simple_arena_init(simple_arena *arena)
+{
+    memset(arena, 0, sizeof(*arena));
+}
+
+static inline void *simple_arena_alloc(simple_arena *arena, size_t size)
+{
+    simple_arena_overflow *overflow;
+    void *ptr;
+
+    size = SIMPLE_ARENA_ROUND(size ? size : 1);
+    arena->wanted += size;
+
+    if (arena->size - arena->used >= size) {
+        ptr = arena->buf + arena->used;
+        arena->used += size;
+        return ptr;
+    }
+
+    overflow = (simple_arena_overflow *)malloc(
+        SIMPLE_ARENA_ROUND(sizeof(simple_arena_overflow)) + size);
+    if (!overflow) {
+        return NULL;
+    }
+    overflow->next = arena->overflow;
+    arena->overflow = overflow;
+
+    return (unsigned char *)overflow +
+           SIMPLE_ARENA_ROUND(sizeof(simple_arena_overflow));
+}
+
+/*
+ * Release every allocation at once, growing the buffer to hold all that
+ * was requested since the previous reset (up to SIMPLE_ARENA_MAX_SIZE).
+ */
+static inline void simple_arena_reset(simple_arena *arena)
+{
+    simple_arena_overflow *overflow;
+    unsigned char *buf;
+
+    while ((overflow = arena->overflow)) {
+        arena->overflow = overflow->next;
+        free(overflow);
+    }
+
+    if (arena->wanted > SIMPLE_ARENA_MAX_SIZE) {
+        arena->wanted = SIMPLE_ARENA_MAX_SIZE;
+    }
+
+    if (arena->wanted > arena->size) {
+        /* keep the old buffer if a bigger one cannot be had */
+        if ((buf = (unsigned char *)malloc(arena->wanted))) {
+            free(arena->buf);
+            arena->buf = buf;
+            arena->size = arena->wanted;
+        }
+    }
+
+    arena->used = 0;
+    arena->wanted = 0;
+}
+
+static inline void simple_arena_free(simple_arena *arena)
+{
+    /* no need to grow a buffer which is about to be freed */
+    arena->wanted = 0;
+    simple_arena_reset(arena);
+    free(arena->buf);
+    simple_arena_init(arena);
+}
+
+#endif /* SIMPLE_ARENA_H */
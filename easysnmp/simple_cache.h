@@ -0,0 +1,161 @@
+/*
+ * Usage:
+ *
+ * A bounded, direct-mapped cache from byte string keys to byte string
+ * values.  Every key hashes to exactly one slot and a new entry simply
+ * replaces whatever occupied its slot, so memory use never exceeds `size`
+ * entries and lookups never probe.
+ *
+ * {
+ *     simple_cache cache;
+ *     size_t value_len;
+ *     void *value;
+ *
+ *     simple_cache_init(&cache, 1024);
+ *     simple_cache_put(&cache, "key", 3, "value", 5);
+ *     value = simple_cache_get(&cache, "key", 3, &value_len);
+ *     simple_cache_free(&cache);
+ * }
+ *
+ * The pointer returned by simple_cache_get is owned by the cache and stays
+ * valid only until the next put or clear; callers sharing a cache between
+ * threads must serialise all calls (and any use of that pointer) with
+ * their own lock.
+ */
+
+#ifndef SIMPLE_CACHE_H
+#define SIMPLE_CACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (__STDC_VERSION__ < 199901L)
+#define inline
+#endif
+
+typedef struct simple_cache_entry {
+    size_t hash;
+    size_t key_len;
+    size_t value_len;
+    unsigned char data[]; /* key_len bytes of key, then value_len of value */
+} simple_cache_entry;
+
+typedef struct simple_cache {
+    size_t size;
+    simple_cache_entry **slots;
+} simple_cache;
+
+/* FNV-1a, which is plenty for the short keys we store */
+static inline size_t simple_cache_hash(const void *key, size_t key_len)
+{
+    const unsigned char *p = (const unsigned char *)key;
+    size_t hash = (size_t)2166136261u;
+    size_t i;
+
+    for (i = 0; i < key_len; i++) {
+        hash ^= p[i];
+        hash *= (size_t)16777619u;
+    }
+
+    return hash;
+}
+
+static inline int simple_cache_init(simple_cache *cache, size_t size)
+{
+    cache->size = size;
+    cache->slots = (simple_cache_entry **)calloc(
+        size, sizeof(simple_cache_entry *));
+
+    return cache->slots ? 0 : -1;
+}
+
+static inline void simple_cache_clear(simple_cache *cache)
+{
+    size_t i;
+
+    if (!cache->slots) {
+        return;
+    }
+
+    for (i = 0; i < cache->size; i++) {
+        free(cache->slots[i]);
+        cache->slots[i] = NULL;
+    }
+}
+
+static inline void simple_cache_free(simple_cache *cache)
+{
+    simple_cache_clear(cache);
+    free(cache->slots);
+    cache->slots = NULL;
+    cache->size = 0;
+}
+
+/*
+ * Look up key, returning a pointer to the cached value (and its length in
+ * value_len) or NULL when the key is not cached.
+ */
+static inline void *simple_cache_get(simple_cache *cache, const void *key,
+                                     size_t key_len, size_t *value_len)
+{
+    size_t hash;
+    simple_cache_entry *entry;
+
+    if (!cache->slots) {
+        return NULL;
+    }
+
+    hash = simple_cache_hash(key, key_len);
+    entry = cache->slots[hash % cache->size];
+
+    if (!entry || entry->hash != hash || entry->key_len != key_len ||
+            memcmp(entry->data, key, key_len) != 0) {
+        return NULL;
+    }
+
+    if (value_len) {
+        *value_len = entry->value_len;
+    }
+
+    return entry->data + key_len;
+}
+
+/*
+ * Store a copy of value under a copy of key, evicting whatever entry its
+ * slot held before.
+ *
+ * returns : 0 on success, -1 if memory for the entry could not be allocated
+ */
+static inline int simple_cache_put(simple_cache *cache, const void *key,
+                                   size_t key_len, const void *value,
+                                   size_t value_len)
+{
+    size_t hash;
+    size_t slot;
+    simple_cache_entry *entry;
+
+    if (!cache->slots) {
+        return -1;
+    }
+
+    entry = (simple_cache_entry *)malloc(
+        sizeof(simple_cache_entry) + key_len + value_len);
+    if (!entry) {
+        return -1;
+    }
+
+    hash = simple_cache_hash(key, key_len);
+    entry->hash = hash;
+    entry->key_len = key_len;
+    entry->value_len = value_len;
+    memcpy(entry->data, key, key_len);
+    memcpy(entry->data + key_len, value, value_len);
+
+    slot = hash % cache->size;
+    free(cache->slots[slot]);
+    cache->slots[slot] = entry;
+
+    return 0;
+}
+
+#endif /* SIMPLE_CACHE_H */
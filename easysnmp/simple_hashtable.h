@@ -0,0 +1,223 @@
+/*
+ * Usage:
+ *
+ * A hash table from byte string keys to fixed size values, using open
+ * addressing with linear probing.  Unlike simple_cache nothing is ever
+ * evicted: the table doubles in size whenever it becomes three quarters
+ * full.
+ *
+ * {
+ *     simple_hashtable table;
+ *     double *value;
+ *     int created;
+ *
+ *     simple_hashtable_init(&table, sizeof(double), 64);
+ *     value = simple_hashtable_lookup(&table, "key", 3, &created);
+ *     if (created) {
+ *         *value = 0.0; // new values start out zeroed anyway
+ *     }
+ *     simple_hashtable_free(&table);
+ * }
+ *
+ * The pointer returned by simple_hashtable_lookup stays valid only until
+ * the next lookup which creates an entry (or a clear).
+ */
+
+#ifndef SIMPLE_HASHTABLE_H
+#define SIMPLE_HASHTABLE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (__STDC_VERSION__ < 199901L)
+#define inline
+#endif
+
+typedef struct simple_hashtable_entry {
+    size_t hash;
+    size_t key_len;
+    unsigned char data[]; /* value_size bytes of value, then key_len of key */
+} simple_hashtable_entry;
+
+typedef struct simple_hashtable {
+    size_t value_size;
+    size_t size; /* always a power of two */
+    size_t count;
+    simple_hashtable_entry **slots;
+} simple_hashtable;
+
+/* values are stored first so that they are suitably aligned */
+#define SIMPLE_HASHTABLE_VALUE_SIZE(size) \
+    (((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/* FNV-1a, as for simple_cache */
+static inline size_t simple_hashtable_hash(const void *key, size_t key_len)
+{
+    const unsigned char *p = (const unsigned char *)key;
+    size_t hash = (size_t)2166136261u;
+    size_t i;
+
+    for (i = 0; i < key_len; i++) {
+        hash ^= p[i];
+        hash *= (size_t)16777619u;
+    }
+
+    return hash;
+}
+
+static inline int simple_hashtable_init(simple_hashtable *table,
+                                        size_t value_size, size_t size)
+{
+    size_t pow2 = 8;
+
+    while (pow2 < size) {
+        pow2 *= 2;
+    }
+
+    table->value_size = SIMPLE_HASHTABLE_VALUE_SIZE(value_size);
+    table->size = pow2;
+    table->count = 0;
+    table->slots = (simple_hashtable_entry **)calloc(
+        pow2, sizeof(simple_hashtable_entry *));
+
+    return table->slots ? 0 : -1;
+}
+
+static inline void simple_hashtable_clear(simple_hashtable *table)
+{
+    size_t i;
+
+    if (!table->slots) {
+        return;
+    }
+
+    for (i = 0; i < table->size; i++) {
+        free(table->slots[i]);
+        table->slots[i] = NULL;
+    }
+    table->count = 0;
+}
+
+static inline void simple_hashtable_free(simple_hashtable *table)
+{
+    simple_hashtable_clear(table);
+    free(table->slots);
+    table->slots = NULL;
+    table->size = 0;
+}
+
+/* the slot holding key, or the empty slot where it belongs */
+static inline size_t simple_hashtable_probe(simple_hashtable_entry **slots,
+                                            size_t size, size_t hash,
+                                            const void *key, size_t key_len,
+                                            size_t value_size)
+{
+    size_t slot = hash & (size - 1);
+    simple_hashtable_entry *entry;
+
+    while ((entry = slots[slot])) {
+        if (entry->hash == hash && entry->key_len == key_len &&
+                memcmp(entry->data + value_size, key, key_len) == 0) {
+            break;
+        }
+        slot = (slot + 1) & (size - 1);
+    }
+
+    return slot;
+}
+
+static inline int simple_hashtable_grow(simple_hashtable *table)
+{
+    simple_hashtable_entry **slots;
+    simple_hashtable_entry *entry;
+    size_t size = table->size * 2;
+    size_t slot;
+    size_t i;
+
+    slots = (simple_hashtable_entry **)calloc(
+        size, sizeof(simple_hashtable_entry *));
+    if (!slots) {
+        return -1;
+    }
+
+    for (i = 0; i < table->size; i++) {
+        if (!(entry = table->slots[i])) {
+            continue;
+        }
+
+        /* every key is distinct, so just find the next empty slot */
+        slot = entry->hash & (size - 1);
+        while (slots[slot]) {
+            slot = (slot + 1) & (size - 1);
+        }
+        slots[slot] = entry;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->size = size;
+
+    return 0;
+}
+
+/*
+ * Look up the value stored under key.  If there is none and created is
+ * not NULL, a zeroed value is added under a copy of key and *created set
+ * to 1 (0 when the key was already present).
+ *
+ * returns : a pointer to the value, or NULL if key is absent and was not
+ *           (or could not be) added
+ */
+static inline void *simple_hashtable_lookup(simple_hashtable *table,
+                                            const void *key, size_t key_len,
+                                            int *created)
+{
+    size_t hash;
+    size_t slot;
+    simple_hashtable_entry *entry;
+
+    if (created) {
+        *created = 0;
+    }
+
+    if (!table->slots) {
+        return NULL;
+    }
+
+    hash = simple_hashtable_hash(key, key_len);
+    slot = simple_hashtable_probe(table->slots, table->size, hash, key,
+                                  key_len, table->value_size);
+    if (table->slots[slot]) {
+        return table->slots[slot]->data;
+    }
+
+    if (!created) {
+        return NULL;
+    }
+
+    if ((table->count + 1) * 4 > table->size * 3) {
+        if (simple_hashtable_grow(table) < 0) {
+            return NULL;
+        }
+        slot = simple_hashtable_probe(table->slots, table->size, hash, key,
+                                      key_len, table->value_size);
+    }
+
+    entry = (simple_hashtable_entry *)calloc(
+        1, sizeof(simple_hashtable_entry) + table->value_size + key_len);
+    if (!entry) {
+        return NULL;
+    }
+
+    entry->hash = hash;
+    entry->key_len = key_len;
+    memcpy(entry->data + table->value_size, key, key_len);
+
+    table->slots[slot] = entry;
+    table->count++;
+    *created = 1;
+
+    return entry->data;
+}
+
+#endif /* SIMPLE_HASHTABLE_H */
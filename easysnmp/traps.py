@@ -0,0 +1,203 @@
+from __future__ import unicode_literals
+
+import os
+
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from . import interface
+
+# The PDU types of the notifications received
+PDU_TYPES = {
+    0xA4: 'trap',
+    0xA6: 'inform',
+    0xA7: 'trap2',
+}
+
+
+class SNMPNotification(object):
+    """
+    A trap or inform received by a TrapListener.
+
+    :param source: the (host, port) tuple the notification was sent from
+    :param version: the SNMP version of the notification, 1 or 2
+    :param community: the community string it was sent with
+    :param pdu_type: 'trap' for an SNMPv1 trap, 'trap2' for an SNMPv2c trap
+                     or 'inform' for an inform (which the listener has
+                     already acknowledged)
+    :param varlist: a list of SNMPVariable objects; for SNMPv2c these start
+                    with sysUpTime.0 and snmpTrapOID.0
+    :param trap_oid: the OID identifying the notification; for an SNMPv1
+                     trap this is worked out from its enterprise and generic
+                     and specific trap numbers as in RFC 3584
+    :param uptime: the time stamp of an SNMPv1 trap in hundredths of a
+                   second, or None
+    :param enterprise: the enterprise OID of an SNMPv1 trap, or None
+    :param agent_address: the agent address of an SNMPv1 trap, or None
+    :param generic_trap: the generic trap number of an SNMPv1 trap, or None
+    :param specific_trap: the specific trap number of an SNMPv1 trap, or
+                          None
+    """
+
+    __slots__ = (
+        'source', 'version', 'community', 'pdu_type', 'varlist', 'trap_oid',
+        'uptime', 'enterprise', 'agent_address', 'generic_trap',
+        'specific_trap'
+    )
+
+    def __init__(self, source, version, community, pdu_type, varlist,
+                 trap_oid=None, uptime=None, enterprise=None,
+                 agent_address=None, generic_trap=None, specific_trap=None):
+        self.source = source
+        self.version = version
+        self.community = community
+        self.pdu_type = pdu_type
+        self.varlist = varlist
+        self.trap_oid = trap_oid
+        self.uptime = uptime
+        self.enterprise = enterprise
+        self.agent_address = agent_address
+        self.generic_trap = generic_trap
+        self.specific_trap = specific_trap
+
+    @classmethod
+    def _from_interface(cls, notification):
+        (host, port, version, community, command, varlist, enterprise,
+         agent_address, generic_trap, specific_trap, uptime,
+         trap_oid) = notification
+
+        if command == 0xA4:
+            return cls(
+                (host, port), 1, community, PDU_TYPES[command], varlist,
+                trap_oid, uptime, enterprise, agent_address, generic_trap,
+                specific_trap
+            )
+
+        return cls(
+            (host, port), 2, community, PDU_TYPES[command], varlist, trap_oid
+        )
+
+    def __repr__(self):
+        return '<{0} {1} (trap_oid={2}, source={3}:{4})>'.format(
+            self.__class__.__name__, self.pdu_type, self.trap_oid,
+            self.source[0], self.source[1]
+        )
+
+
+class TrapListener(object):
+    """
+    Receives SNMPv1 traps and SNMPv2c traps and informs on a UDP socket.
+    Datagrams are read in batches of whatever has queued up (with
+    recvmmsg where the system has it), parsed and, for informs,
+    acknowledged without holding the GIL; their variables are then decoded
+    into SNMPVariable objects just as a Session with the same options
+    would decode a response.  SNMPv3 notifications and anything else which
+    is not a notification are dropped and counted.
+
+    There is no filtering by community; check the community of each
+    notification received where that matters.  A listener may only be
+    used from one thread at a time.
+
+    :param hostname: the address to listen on, '' for every address
+    :param port: the UDP port to listen on; binding the standard port 162
+                 usually needs privileges, and 0 picks a free port (see
+                 port)
+    :param batch_size: the most datagrams read at a time, up to 256; the
+                       listener keeps an 8 KiB buffer for each (512 KiB
+                       for the default of 64), and drops any datagram
+                       bigger than that
+    :param recv_buffer_size: the size in bytes to set the socket's receive
+                             buffer to so that bursts of traps are not
+                             lost, 0 to leave the system default
+    :param use_long_names: set to True to have the <tags> of variables
+                           given with the longer MIB name convention
+                           (e.g., system.sysDescr vs just sysDescr), as
+                           for Session
+    :param use_numeric: set to True to have the <tags> of variables (and
+                        the trap_oid and enterprise of SNMPv1 traps) given
+                        untranslated (i.e. dotted-decimal), as for Session
+    :param use_sprint_value: set to True to have values formatted with the
+                             library's sprint_value function, as for
+                             Session
+    :param use_enums: set to True to have integer values converted to
+                      enumeration identifiers if possible, as for Session
+    :param use_native_types: set to True to have values returned as native
+                             Python types, as for Session
+    :param use_bytes: set to True to have OCTET STR and Opaque values
+                      returned as bytes, as for Session
+    """
+
+    def __init__(self, hostname='0.0.0.0', port=162, batch_size=64,
+                 recv_buffer_size=0, use_long_names=False, use_numeric=False,
+                 use_sprint_value=False, use_enums=False,
+                 use_native_types=False, use_bytes=False):
+        self.hostname = hostname
+        self.use_long_names = use_long_names
+        self.use_numeric = use_numeric
+        self.use_sprint_value = use_sprint_value
+        self.use_enums = use_enums
+        self.use_native_types = use_native_types
+        self.use_bytes = use_bytes
+
+        # The options above are read by the C interface once, here
+        self._socket = interface.trap_socket(
+            self, hostname, int(port), int(batch_size),
+            int(recv_buffer_size)
+        )
+
+    @property
+    def port(self):
+        """
+        The UDP port the listener is bound to
+        """
+
+        return self._socket.port
+
+    @property
+    def dropped(self):
+        """
+        The number of datagrams received which were not SNMPv1 or SNMPv2c
+        notifications
+        """
+
+        return self._socket.dropped
+
+    def receive(self, timeout=None):
+        """
+        Waits for notifications and returns the batch received
+
+        :param timeout: the most seconds to wait, None to wait for ever
+        :return: a list of SNMPNotification objects, empty if none arrived
+                 in time
+        """
+
+        notifications = interface.trap_receive(
+            self._socket, -1.0 if timeout is None else float(timeout)
+        )
+
+        return [
+            SNMPNotification._from_interface(notification)
+            for notification in notifications
+        ]
+
+    def __iter__(self):
+        """
+        Yields each batch of notifications as it is received, for ever
+        """
+
+        while True:
+            notifications = self.receive(timeout=1.0)
+            if notifications:
+                yield notifications
+
+    def close(self):
+        """
+        Closes the socket
+        """
+
+        interface.trap_close(self._socket)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
@@ -15,6 +15,13 @@ def strip_non_printable(value):
     if value is None:
         return None
 
+    # Values returned as native types (see use_native_types) are printable
+    # as they are, apart from bytes which we treat as latin-1 text
+    if isinstance(value, bytes) and not isinstance(value, text_type):
+        value = value.decode('latin-1')
+    elif not isinstance(value, text_type):
+        return value
+
     # Filter all non-printable characters
     # (note that we must use join to account for the fact that Python 3
     # returns a generator)
@@ -1,11 +1,20 @@
 from __future__ import unicode_literals
 
+import os
+
 from .compat import urepr
 from .helpers import normalize_oid
 from .utils import strip_non_printable, tostr
 
+# Don't attempt to import the C interface if building docs on RTD
+if not os.environ.get('READTHEDOCS', False):  # noqa
+    from .interface import SNMPVariableBase
+else:
+    class SNMPVariableBase(object):
+        __slots__ = ('oid', 'oid_index', 'value', 'snmp_type', 'root_oid')
+
 
-class SNMPVariable(object):
+class SNMPVariable(SNMPVariableBase):
     """
     An SNMP variable binding which is used to represent a piece of
     information being retreived via SNMP.
@@ -30,6 +39,10 @@ class SNMPVariable(object):
         'TICKS':int
     }
 
+    # The fields are stored natively by SNMPVariableBase, which lets the C
+    # interface fill in results without going through __setattr__; no
+    # __slots__ are declared here so that other attributes may still be set
+
     def __init__(self, oid=None, oid_index=None, value=None, snmp_type=None):
         self.oid, self.oid_index = normalize_oid(oid, oid_index)
         self.value = value
@@ -48,7 +61,22 @@ class SNMPVariable(object):
         )
 
     def __setattr__(self, name, value):
-        self.__dict__[name] = tostr(value)
+        super(SNMPVariable, self).__setattr__(name, tostr(value))
+
+    def __reduce__(self):
+        # Slots defined natively are not picked up by the default protocol
+        state = dict(
+            (name, getattr(self, name)) for name in (
+                'oid', 'oid_index', 'value', 'snmp_type', 'root_oid'
+            )
+        )
+        state.update(self.__dict__)
+        return self.__class__, (), state
+
+    def __setstate__(self, state):
+        # Restore values as they were, native types included
+        for name, value in state.items():
+            super(SNMPVariable, self).__setattr__(name, value)
 
     def real_value(self):
         """
@@ -9,12 +9,16 @@ from setuptools.command.test import test as TestCommand
 in_tree = False
 # Add compiler flags if debug is set
 compile_args = ['-Wno-unused-function']
-for arg in sys.argv:
+for arg in sys.argv[:]:
     if arg.startswith('--debug'):
         # Note from GCC manual:
         #       If you use multiple -O options, with or without level numbers,
         #       the last such option is the one that is effective.
         compile_args.extend('-Wall -O0 -g'.split())
+    elif arg == '--no-debug-log':
+        # Compile out all DEBUG level logging from the C extension
+        compile_args.append('-DEASYSNMP_NO_DEBUG_LOG')
+        sys.argv.remove(arg)
     elif arg.startswith('--basedir='):
         basedir = arg.split('=')[1]
         sys.argv.remove(arg)
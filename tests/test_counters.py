@@ -0,0 +1,64 @@
+from __future__ import unicode_literals
+
+import pytest
+from easysnmp.counters import CounterPoller
+from easysnmp.variables import SNMPVariable
+
+from .fixtures import sess_v1, sess_v2, sess_v3
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_counter_poller_poll(sess):
+    poller = CounterPoller()
+    oids = ['snmpInPkts.0', 'sysContact.0']
+
+    res = poller.poll(sess, oids)
+    assert len(res) == 2
+    assert res[0][0].oid == 'snmpInPkts'
+    assert res[0][1:] == (None, None)
+    assert res[1][1:] == (None, None)
+    assert len(poller) == 1
+
+    # The agent has seen at least our last request since then
+    res = poller.poll(sess, oids)
+    assert res[0][1] >= 1
+    assert res[0][2] > 0
+    assert res[1][1:] == (None, None)
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_counter_poller_poll_walk(sess):
+    poller = CounterPoller()
+
+    poller.poll_walk(sess, 'ifInOctets')
+    res = poller.poll_walk(sess, 'ifInOctets')
+    assert res
+    for variable, delta, rate in res:
+        assert variable.oid == 'ifInOctets'
+        assert delta >= 0
+        assert rate >= 0
+
+
+def test_counter_poller_wrap_and_discontinuity(sess_v2):
+    poller = CounterPoller()
+
+    def update(value, snmp_type, timestamp):
+        variable = SNMPVariable('ifInOctets', '1', value, snmp_type)
+        return poller.update(sess_v2, [variable], timestamp)[0][1:]
+
+    assert update('4294967290', 'COUNTER', 1.0) == (None, None)
+    assert update('4', 'COUNTER', 2.0) == (10, 10.0)
+
+    # Falling by more than half its range is a reset rather than a wrap
+    assert update('3', 'COUNTER', 3.0) == (None, None)
+    assert update('5', 'COUNTER', 5.0) == (2, 1.0)
+
+    # As is a 64-bit counter going backwards or the counter going missing
+    assert update('100', 'COUNTER64', 6.0) == (None, None)
+    assert update('50', 'COUNTER64', 7.0) == (None, None)
+    assert update(None, 'NOSUCHINSTANCE', 8.0) == (None, None)
+    assert update('60', 'COUNTER64', 9.0) == (None, None)
+    assert update('70', 'COUNTER64', 10.0) == (10, 10.0)
+
+    poller.clear()
+    assert len(poller) == 0
@@ -556,3 +556,30 @@ def test_snmp_bulkwalk_res(sess_args):
 def test_snmp_bulkwalk_unknown(sess_args):
     with pytest.raises(EasySNMPUnknownObjectIDError):
         snmp_bulkwalk('systemo', **sess_args)
+
+
+@pytest.mark.parametrize(
+    'sess_args', [sess_v1_args(), sess_v2_args(), sess_v3_args()]
+)
+def test_snmp_session_cache(sess_args):
+    from easysnmp import easy
+
+    easy.enable_session_cache(max_sessions=1)
+    try:
+        res = snmp_get('sysContact.0', **sess_args)
+        assert res.value == 'G. S. Marzot <gmarzot@marzot.net>'
+        assert len(easy._session_cache) == 1
+        session = list(easy._session_cache.values())[0][0]
+
+        res = snmp_walk('system', **sess_args)
+        assert len(res) >= 7
+        assert list(easy._session_cache.values())[0] == [session]
+
+        # Sessions with other options are kept apart, within the limit
+        snmp_get('sysContact.0', use_numeric=True, **sess_args)
+        assert list(easy._session_cache.values())[0] != [session]
+        assert len(easy._session_cache) == 1
+    finally:
+        easy.disable_session_cache()
+
+    assert not easy._session_cache
@@ -0,0 +1,87 @@
+from __future__ import unicode_literals
+
+import os
+import subprocess
+import sys
+
+import pytest
+from easysnmp.exceptions import EasySNMPError
+from easysnmp.mibs import load_mibs
+
+
+def run_with_mibs(mibs, code, **environ):
+    """
+    Run code in a fresh interpreter, as MIBs are chosen at import time
+    """
+
+    env = dict(os.environ, EASYSNMP_MIBS=mibs, **environ)
+    return subprocess.check_output(
+        [sys.executable, '-c', code], env=env
+    ).decode('ascii').strip()
+
+
+@pytest.mark.parametrize('mibs', ['lazy', 'SNMPv2-MIB'])
+def test_mibs_loaded_as_needed(mibs):
+    assert run_with_mibs(mibs, (
+        'import easysnmp\n'
+        's = easysnmp.Session(hostname="localhost", remote_port=11161, '
+        'version=2)\n'
+        'print(s.get("sysContact.0").oid)'
+    )) == 'sysContact'
+
+
+# Prints the label a plain session gives ifDescr.1; only with IF-MIB loaded
+# is that ifDescr
+LABEL_IF_DESCR = (
+    'import easysnmp\n'
+    's = easysnmp.Session(hostname="localhost", remote_port=11161, '
+    'version=2)\n'
+    'print(s.get(".1.3.6.1.2.1.2.2.1.2.1").oid)'
+)
+
+
+@pytest.mark.parametrize('mibs,label', [
+    ('SNMPv2-MIB', False), ('SNMPv2-MIB:IF-MIB', True), ('lazy', True)
+])
+def test_mibs_only_those_listed(mibs, label):
+    res = run_with_mibs(mibs, LABEL_IF_DESCR)
+    assert (res == 'ifDescr') == label
+
+
+def test_mibs_lazy_loads_nothing_until_needed():
+    # A numeric session does not need the MIBs, so only those loaded
+    # before the first symbolic lookup are ever loaded
+    assert run_with_mibs('lazy', (
+        'import easysnmp\n'
+        'from easysnmp.mibs import load_mibs\n'
+        's = easysnmp.Session(hostname="localhost", remote_port=11161, '
+        'version=2, use_numeric=True)\n'
+        's.get(".1.3.6.1.2.1.1.4.0")\n'
+        'load_mibs("SNMPv2-MIB")\n'
+    ) + LABEL_IF_DESCR) != 'ifDescr'
+
+
+def test_mibs_numeric():
+    assert run_with_mibs('numeric', (
+        'import easysnmp\n'
+        's = easysnmp.Session(hostname="localhost", remote_port=11161, '
+        'version=2, use_numeric=True)\n'
+        'print(s.get(".1.3.6.1.2.1.1.4.0").value)'
+    )) == 'G. S. Marzot <gmarzot@marzot.net>'
+
+
+@pytest.mark.parametrize('mibs', ['lazy', 'numeric', 'SNMPv2-MIB', ''])
+def test_mibs_leave_environment(mibs):
+    # os.environ is not updated by the C interface, so ask a child process
+    assert run_with_mibs(mibs, (
+        'import subprocess\n'
+        'import easysnmp\n'
+        'subprocess.call(["sh", "-c", "echo $MIBS $MIBDIRS"])'
+    ), MIBS='IF-MIB', MIBDIRS='/nonexistent') == 'IF-MIB /nonexistent'
+
+
+def test_load_mibs_unknown_module():
+    load_mibs('IF-MIB')
+
+    with pytest.raises(EasySNMPError):
+        load_mibs('NO-SUCH-MIB')
@@ -0,0 +1,101 @@
+from __future__ import unicode_literals
+
+import pytest
+from easysnmp.exceptions import (
+    EasySNMPError, EasySNMPNoSuchNameError, EasySNMPTimeoutError
+)
+from easysnmp.poll import poll_many
+from easysnmp.session import Session
+
+from .fixtures import sess_v1, sess_v2, sess_v3
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_poll_many_matches_session(sess):
+    oids = ['sysContact.0', 'sysDescr.0']
+    res = poll_many([
+        (sess, 'get', oids),
+        (sess, 'get_next', 'sysUpTime'),
+        (sess, 'walk', 'system'),
+    ])
+
+    assert len(res) == 3
+
+    expected = sess.get(oids)
+    assert [(v.oid, v.oid_index, v.value) for v in res[0]] == [
+        (v.oid, v.oid_index, v.value) for v in expected
+    ]
+
+    assert res[1].oid == 'sysUpTimeInstance'
+    assert res[1].snmp_type == 'TICKS'
+
+    expected = sess.walk('system')
+    assert [(v.oid, v.oid_index) for v in res[2]] == [
+        (v.oid, v.oid_index) for v in expected
+    ]
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_poll_many_bulk(sess):
+    res = poll_many([
+        (sess, 'get_bulk', ['sysUpTime', 'sysORLastChange'], 2, 4),
+        (sess, 'bulkwalk', 'system', 0, 4),
+    ], max_in_flight=1)
+
+    expected = sess.get_bulk(['sysUpTime', 'sysORLastChange'], 2, 4)
+    assert [(v.oid, v.oid_index) for v in res[0]] == [
+        (v.oid, v.oid_index) for v in expected
+    ]
+    assert [(v.oid, v.oid_index) for v in res[1]] == [
+        (v.oid, v.oid_index) for v in sess.bulkwalk('system', 0, 4)
+    ]
+
+
+def test_poll_many_bulk_v1_fails(sess_v1):
+    res = poll_many([
+        (sess_v1, 'get_bulk', 'sysUpTime'),
+        (sess_v1, 'get', 'sysUpTime.0'),
+    ])
+
+    assert isinstance(res[0], EasySNMPError)
+    assert res[1].oid == 'sysUpTimeInstance'
+
+
+def test_poll_many_v1_retry_no_such(sess_v1):
+    oids = ['sysContact.0', 'sysDescr.100', 'sysLocation.0']
+    res = poll_many([(sess_v1, 'get', oids)])
+    assert isinstance(res[0], EasySNMPNoSuchNameError)
+
+    # With retry_no_such the missing OID is elided as by Session.get
+    sess_v1.retry_no_such = True
+    res = poll_many([
+        (sess_v1, 'get', oids),
+        (sess_v1, 'get', 'sysUpTime.0'),
+    ])
+
+    expected = sess_v1.get(oids)
+    assert [(v.oid, v.oid_index, v.snmp_type) for v in res[0]] == [
+        (v.oid, v.oid_index, v.snmp_type) for v in expected
+    ]
+    assert res[0][0].value == expected[0].value
+    assert res[0][1].snmp_type == 'NOSUCHNAME'
+    assert res[1].oid == 'sysUpTimeInstance'
+
+
+def test_poll_many_timeout_per_request(sess_v2):
+    unreachable = Session(
+        hostname='localhost', remote_port=11162, community='public',
+        version=2, timeout=0.2, retries=0
+    )
+    res = poll_many([
+        (unreachable, 'get', 'sysContact.0'),
+        (sess_v2, 'get', 'sysContact.0'),
+    ])
+
+    assert isinstance(res[0], EasySNMPTimeoutError)
+    assert res[1].oid == 'sysContact'
+
+
+def test_poll_many_invalid_operation(sess_v2):
+    with pytest.raises(ValueError):
+        poll_many([(sess_v2, 'set', 'sysContact.0')])
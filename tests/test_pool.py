@@ -0,0 +1,124 @@
+from __future__ import unicode_literals
+
+import threading
+
+import pytest
+from easysnmp.exceptions import EasySNMPError
+from easysnmp.pool import SessionPool
+from easysnmp.session import Session
+
+from .fixtures import sess_v2_args
+
+
+def test_session_pool_reuses_sessions():
+    pool = SessionPool(**sess_v2_args())
+
+    with pool.session() as session:
+        first = session
+        assert session.get('sysContact.0').value == (
+            'G. S. Marzot <gmarzot@marzot.net>'
+        )
+
+    with pool.session() as session:
+        assert session is first
+
+    # different session arguments are a different shard
+    with pool.session(use_numeric=True) as session:
+        assert session is not first
+        assert session.get('sysContact.0').oid == '.1.3.6.1.2.1.1.4'
+
+    pool.close()
+    with pytest.raises(EasySNMPError):
+        pool.acquire()
+
+
+def test_session_pool_max_sessions_per_host():
+    pool = SessionPool(max_sessions_per_host=1, **sess_v2_args())
+    session = pool.acquire()
+    acquired = []
+
+    thread = threading.Thread(target=lambda: acquired.append(pool.acquire()))
+    thread.start()
+    thread.join(0.2)
+    assert not acquired
+
+    pool.release(session)
+    thread.join(5)
+    assert acquired == [session]
+
+
+def test_session_pool_map():
+    pool = SessionPool(max_sessions_per_host=2, **sess_v2_args())
+
+    res = pool.map(
+        lambda session: session.get('sysContact.0').value,
+        ['localhost'] * 8, max_workers=4
+    )
+    assert res == ['G. S. Marzot <gmarzot@marzot.net>'] * 8
+
+    res = pool.map(
+        lambda session: session.get('sysDescripto.0'), ['localhost']
+    )
+    assert isinstance(res[0], EasySNMPError)
+
+
+def test_session_pool_threads_keep_their_output_format():
+    pool = SessionPool(max_sessions_per_host=4, **sess_v2_args())
+    expected = {False: 'sysContact', True: '.1.3.6.1.2.1.1.4'}
+    errors = []
+
+    def worker(use_numeric):
+        with pool.session(use_numeric=use_numeric) as session:
+            for _ in range(50):
+                oid = session.get('sysContact.0').oid
+                if oid != expected[use_numeric]:
+                    errors.append(oid)
+
+    threads = [
+        threading.Thread(target=worker, args=(use_numeric,))
+        for use_numeric in [False, True] * 2
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert not errors
+
+
+def test_session_bulkwalks_decode_in_parallel():
+    # Responses this big are decoded without the GIL, and so side by side
+    options = [
+        {}, {'use_numeric': True}, {'use_long_names': True},
+        {'use_enums': True}, {'use_native_types': True}
+    ]
+    sessions = [
+        Session(**dict(sess_v2_args(), **option)) for option in options
+    ]
+
+    def walk(session):
+        return [
+            (var.oid, var.oid_index, var.value, var.snmp_type)
+            for var in session.bulkwalk('ifTable', max_repetitions=20)
+        ]
+
+    expected = [walk(session) for session in sessions]
+    assert all(len(res) >= 8 for res in expected)
+    errors = []
+
+    def worker(session, expected):
+        for _ in range(20):
+            res = walk(session)
+            if res != expected:
+                errors.append(res)
+
+    threads = [
+        threading.Thread(target=worker, args=args)
+        for args in zip(sessions, expected)
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert not errors
@@ -0,0 +1,54 @@
+from __future__ import unicode_literals
+
+import time
+
+import pytest
+from easysnmp.exceptions import EasySNMPError
+from easysnmp.scheduler import PollScheduler
+
+from .fixtures import sess_v1, sess_v2, sess_v3
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_poll_scheduler_polls_jobs(sess):
+    scheduler = PollScheduler(workers=2)
+    contact = scheduler.add(sess.prepare('sysContact.0'), 0.1)
+    system = scheduler.add(sess.prepare('system', op='walk'), 0.1)
+
+    scheduler.start()
+    try:
+        results = {}
+        while len(results.get(contact, [])) < 2 or system not in results:
+            job, result, _ = scheduler.results.get(timeout=5)
+            results.setdefault(job, []).append(result)
+    finally:
+        scheduler.stop()
+
+    for result in results[contact]:
+        assert result.value == 'G. S. Marzot <gmarzot@marzot.net>'
+    assert [(v.oid, v.oid_index) for v in results[system][0]] == [
+        (v.oid, v.oid_index) for v in sess.walk('system')
+    ]
+
+
+def test_poll_scheduler_limits_packets(sess_v2):
+    scheduler = PollScheduler(max_pps=5)
+    job = scheduler.add(sess_v2.prepare('sysUpTime.0'), 0.01)
+
+    scheduler.start()
+    time.sleep(1)
+    scheduler.stop()
+    scheduler.remove(job)
+
+    # A full bucket of 5, then 5 more a second
+    assert 5 <= scheduler.results.qsize() <= 11
+    assert job.missed > 0
+
+
+def test_poll_scheduler_rejects_bulk_v1(sess_v1):
+    scheduler = PollScheduler()
+
+    with pytest.raises(EasySNMPError):
+        scheduler.add(sess_v1.prepare('system', op='bulkwalk'), 1)
+    with pytest.raises(ValueError):
+        scheduler.add(sess_v1.prepare(['ifIndex'], op='bulkwalk_table'), 1)
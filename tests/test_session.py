@@ -1,15 +1,21 @@
 from __future__ import unicode_literals
 
+import io
+import json
+import logging
 import platform
 import re
+import struct
 
 import pytest
 from easysnmp.exceptions import (
     EasySNMPError, EasySNMPConnectionError, EasySNMPTimeoutError,
     EasySNMPNoSuchObjectError, EasySNMPNoSuchInstanceError,
-    EasySNMPNoSuchNameError
+    EasySNMPNoSuchNameError, EasySNMPUnknownObjectIDError
 )
 
+from easysnmp import interface, set_log_level
+from easysnmp import session as session_module
 from easysnmp.session import Session
 
 from .fixtures import sess_v1, sess_v2, sess_v3
@@ -145,6 +151,48 @@ def test_session_get(sess):
     assert res[2].snmp_type == 'OCTETSTR'
 
 
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+@pytest.mark.parametrize('max_varbinds_per_pdu', [0, 2])
+def test_session_get_packed(sess, max_varbinds_per_pdu):
+    sess.max_varbinds_per_pdu = max_varbinds_per_pdu
+    res = sess.get([
+        ('sysUpTime', '0'),
+        ('sysContact', '0'),
+        ('sysLocation', '0')
+    ])
+
+    assert len(res) == 3
+
+    assert res[0].oid == 'sysUpTimeInstance'
+    assert res[0].oid_index == ''
+    assert res[0].root_oid == 'sysUpTime'
+    assert int(res[0].value) > 0
+    assert res[0].snmp_type == 'TICKS'
+
+    assert res[1].oid == 'sysContact'
+    assert res[1].oid_index == '0'
+    assert res[1].root_oid == 'sysContact'
+    assert res[1].value == 'G. S. Marzot <gmarzot@marzot.net>'
+    assert res[1].snmp_type == 'OCTETSTR'
+
+    assert res[2].oid == 'sysLocation'
+    assert res[2].oid_index == '0'
+    assert res[2].root_oid == 'sysLocation'
+    assert res[2].value == 'my original location'
+    assert res[2].snmp_type == 'OCTETSTR'
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_session_get_packed_invalid_instance(sess):
+    sess.max_varbinds_per_pdu = 0
+    res = sess.get(['sysContact.0', 'sysDescr.100', 'sysLocation.0'])
+
+    assert len(res) == 3
+    assert res[0].value == 'G. S. Marzot <gmarzot@marzot.net>'
+    assert res[1].snmp_type == 'NOSUCHINSTANCE'
+    assert res[2].value == 'my original location'
+
+
 @pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
 def test_session_get_use_numeric(sess):
     sess.use_numeric = True
@@ -233,6 +281,61 @@ def test_session_set_multiple(sess):
     assert res[1].value == '160'
 
 
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_set_batch(sess):
+    status = sess.set_batch([
+        ('sysLocation.0', 'my batched location'),
+        ('sysDescr.0', 'not writable'),
+        (('nsCacheTimeout', '.1.3.6.1.2.1.2.2'), 170),
+    ], max_varbinds_per_pdu=2)
+
+    # The read-only sysDescr is refused without holding up the others
+    assert len(status) == 3
+    assert status[0] == 0
+    assert status[1] not in (0, None)
+    assert status[2] == 0
+
+    res = sess.get(['sysLocation.0', 'nsCacheTimeout.1.3.6.1.2.1.2.2'])
+    assert res[0].value == 'my batched location'
+    assert res[1].value == '170'
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_set_batch_packs_pdus(sess):
+    sess.stats(reset=True)
+    status = sess.set_batch([
+        ('sysLocation.0', 'my packed location'),
+        (('nsCacheTimeout', '.1.3.6.1.2.1.2.2'), 180),
+    ])
+
+    # Both values go in the one request by default
+    assert status == [0, 0]
+    assert sess.stats()['pdus_sent'] == 1
+
+    res = sess.get(['sysLocation.0', 'nsCacheTimeout.1.3.6.1.2.1.2.2'])
+    assert res[0].value == 'my packed location'
+    assert res[1].value == '180'
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_stats(sess):
+    sess.stats(reset=True)
+    sess.get(['sysUpTime.0', 'sysContact.0', 'sysLocation.0'])
+
+    stats = sess.stats()
+    assert stats['pdus_sent'] == 3
+    assert stats['responses'] == 3
+    assert stats['timeouts'] == 0
+    assert stats['varbinds_decoded'] == 3
+    assert stats['bytes_received'] > 0
+    assert stats['rtt_total'] > 0
+    assert sum(count for _, count in stats['rtt_histogram']) == 3
+    assert stats['rtt_histogram'][-1][0] is None
+
+    sess.stats(reset=True)
+    assert sess.stats()['pdus_sent'] == 0
+
+
 @pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
 def test_session_get_bulk(sess):  # noqa
     if sess.version == 1:
@@ -307,6 +410,41 @@ def test_session_get_invalid_object_with_abort_enabled(sess):
             sess.get('iso')
 
 
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_session_get_bulk_columns(sess):
+    scalars, columns = sess.get_bulk_columns(
+        ['sysUpTime', 'sysContact'], ['ifIndex', 'ifDescr'], 50
+    )
+
+    assert [(v.oid, v.oid_index) for v in scalars] == [
+        ('sysUpTimeInstance', ''), ('sysContact', '0')
+    ]
+    assert scalars[1].value == 'G. S. Marzot <gmarzot@marzot.net>'
+
+    assert len(columns) == 2
+    for column, oid in zip(columns, ['ifIndex', 'ifDescr']):
+        assert [(v.oid, v.oid_index, v.value) for v in column] == [
+            (v.oid, v.oid_index, v.value) for v in sess.walk(oid)
+        ]
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_session_get_bulk_columns_end_of_mib(sess):
+    # Nothing follows .2, so the second scalar runs off the end of the MIB
+    scalars, columns = sess.get_bulk_columns(
+        ['sysUpTime', '.2', 'sysContact'], ['ifIndex']
+    )
+
+    assert len(scalars) == 3
+    assert scalars[1].snmp_type == 'ENDOFMIBVIEW'
+    assert scalars[2].value == 'G. S. Marzot <gmarzot@marzot.net>'
+
+
+def test_session_get_bulk_columns_v1_fails(sess_v1):
+    with pytest.raises(EasySNMPError):
+        sess_v1.get_bulk_columns(['sysUpTime'], ['ifIndex'])
+
+
 @pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
 def test_session_walk(sess):
     res = sess.walk('system')
@@ -366,6 +504,42 @@ def test_session_walk_all(sess):
         assert res[5].snmp_type == 'OCTETSTR'
 
 
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_pipelined_walk(sess):
+    def names(res):
+        return [(v.oid, v.oid_index) for v in res]
+
+    expected = names(sess.walk(['system', 'ifTable']))
+
+    # Split at the columns of ifTable, then where the first walk learned
+    res = sess.pipelined_walk(['system', 'ifTable'], rows=2)
+    assert names(res) == expected
+    assert res[0].value == sess.get('sysDescr.0').value
+
+    res = sess.pipelined_walk(['system', 'ifTable'], max_in_flight=2)
+    assert names(res) == expected
+
+    res = sess.pipelined_walk('system', split_oids=['sysContact.0'])
+    assert names(res) == expected[:len(res)]
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2()])
+def test_session_pipelined_walk_chains(sess):
+    # One chain for each of the nine children of system; every chain takes
+    # one request per variable and one more to find its end
+    sess.stats(reset=True)
+    res = sess.pipelined_walk('system', max_in_flight=16)
+    assert sess.stats()['pdus_sent'] == len(res) + 9
+
+
+def test_session_pipelined_walk_forgets_splits(sess_v2, monkeypatch):
+    monkeypatch.setattr(session_module, 'MAX_WALK_SPLITS', 1)
+
+    sess_v2.pipelined_walk('system', max_in_flight=2)
+    sess_v2.pipelined_walk('sysORTable', max_in_flight=2)
+    assert list(sess_v2._walk_splits) == [('sysORTable', None)]
+
+
 @pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
 def test_session_bulkwalk(sess):
     res = sess.bulkwalk('system')
@@ -423,3 +597,410 @@ def test_session_bulkwalk_all(sess):
         assert res[5].oid_index == '0'
         assert res[5].value == 'my original location'
         assert res[5].snmp_type == 'OCTETSTR'
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_session_bulkwalk_parallel(sess):
+    oids = ['sysORID', 'sysORDescr', 'sysORUpTime']
+    sequential = sess.bulkwalk(oids, max_repetitions=4)
+    res = sess.bulkwalk(oids, max_repetitions=4, parallel=True)
+
+    assert len(res) == len(sequential)
+    assert len(res) >= 3
+
+    for parallel_var, sequential_var in zip(res, sequential):
+        assert parallel_var.oid == sequential_var.oid
+        assert parallel_var.oid_index == sequential_var.oid_index
+        assert parallel_var.root_oid == sequential_var.root_oid
+        assert parallel_var.snmp_type == sequential_var.snmp_type
+
+    assert res[0].oid == 'sysORID'
+    assert res[-1].oid == 'sysORUpTime'
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+@pytest.mark.parametrize('parallel', [False, True])
+def test_session_bulkwalk_adaptive(sess, parallel):
+    oids = ['sysORID', 'ifDescr']
+    expected = sess.bulkwalk(oids, max_repetitions=10, parallel=parallel)
+
+    # Once from a single repetition and again from the learned value
+    for _ in range(2):
+        res = sess.bulkwalk(
+            oids, max_repetitions=1, parallel=parallel, adaptive=True
+        )
+
+        assert [(v.oid, v.oid_index, v.value) for v in res] == [
+            (v.oid, v.oid_index, v.value) for v in expected
+        ]
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_get_native_types(sess):
+    sess.use_native_types = True
+    res = sess.get([
+        'sysUpTime.0', 'sysContact.0', 'sysObjectID.0', 'ifIndex.1'
+    ])
+
+    assert isinstance(res[0].value, int)
+    assert res[0].value > 0
+    assert res[0].snmp_type == 'TICKS'
+
+    assert res[1].value == b'G. S. Marzot <gmarzot@marzot.net>'
+    assert res[1].snmp_type == 'OCTETSTR'
+
+    assert isinstance(res[2].value, tuple)
+    assert res[2].value[:6] == (1, 3, 6, 1, 4, 1)
+    assert res[2].snmp_type == 'OBJECTID'
+
+    assert res[3].value == 1
+    assert res[3].real_value() == 1
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_get_bytes(sess):
+    sess.use_bytes = True
+    res = sess.get(['sysContact.0', 'sysUpTime.0'])
+
+    assert res[0].value == b'G. S. Marzot <gmarzot@marzot.net>'
+    assert res[0].snmp_type == 'OCTETSTR'
+
+    # Other types are still returned as strings
+    assert not isinstance(res[1].value, bytes)
+    assert int(res[1].value) > 0
+
+    sess.use_bytes = False
+    res = sess.get('sysContact.0')
+    assert res.value == 'G. S. Marzot <gmarzot@marzot.net>'
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_bulkwalk_table(sess):
+    index, table = sess.bulkwalk_table(['ifIndex', 'ifDescr', 'ifType'])
+
+    assert set(table) == set(['ifIndex', 'ifDescr', 'ifType'])
+    assert len(index) >= 1
+    for column in ('ifIndex', 'ifDescr', 'ifType'):
+        assert len(table[column]) == len(index)
+
+    rows = sess.walk('ifDescr')
+    assert index == [var.oid_index for var in rows]
+    assert table['ifDescr'] == [var.value for var in rows]
+    assert table['ifIndex'] == index
+
+    with pytest.raises(ValueError):
+        sess.bulkwalk_table(['ifDescr', 'ifDescr'])
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_walk_export_ndjson(sess):
+    oids = ['sysORID', 'ifDescr']
+    expected = sess.walk(oids)
+
+    res = sess.walk_export(oids, max_repetitions=3)
+    assert isinstance(res, bytes)
+    assert res.endswith(b'\n')
+
+    records = [json.loads(line) for line in res.decode('ascii').splitlines()]
+    assert [
+        (r['oid'], r['oid_index'], r['value'], r['snmp_type'], r['root_oid'])
+        for r in records
+    ] == [
+        (v.oid, v.oid_index, v.value, v.snmp_type, v.root_oid)
+        for v in expected
+    ]
+
+
+def read_msgpack_record(data):
+    """
+    Decodes a record of walk_export's msgpack output: a map of str keys to
+    str, bin or nil values, which is all the export writes
+    """
+
+    stream = io.BytesIO(data)
+
+    def read_uint(size):
+        fmt = {1: '>B', 2: '>H', 4: '>I'}[size]
+        return struct.unpack(fmt, stream.read(size))[0]
+
+    def read_item():
+        marker = read_uint(1)
+        if marker == 0xc0:
+            return None
+        elif marker & 0xe0 == 0xa0:
+            return stream.read(marker & 0x1f).decode('utf-8')
+        elif marker in (0xd9, 0xda, 0xdb):
+            length = read_uint(1 << (marker - 0xd9))
+            return stream.read(length).decode('utf-8')
+        elif marker in (0xc4, 0xc5, 0xc6):
+            return stream.read(read_uint(1 << (marker - 0xc4)))
+        raise AssertionError('unexpected msgpack type {0:#x}'.format(marker))
+
+    header = read_uint(1)
+    assert header & 0xf0 == 0x80
+
+    record = {}
+    for _ in range(header & 0x0f):
+        key = read_item()
+        record[key] = read_item()
+
+    assert stream.read() == b''
+    return record
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_walk_export_msgpack(sess):
+    expected = sess.walk('system')
+
+    res = sess.walk_export('system', format='msgpack')
+
+    # Every record is a map of five fields behind its length
+    offset = 0
+    records = []
+    while offset < len(res):
+        length, = struct.unpack('>I', res[offset:offset + 4])
+        assert res[offset + 4:offset + 5] == b'\x85'
+        records.append(
+            read_msgpack_record(res[offset + 4:offset + 4 + length])
+        )
+        offset += 4 + length
+
+    assert offset == len(res)
+    assert [
+        (r['oid'], r['oid_index'], r['snmp_type'], r['root_oid'])
+        for r in records
+    ] == [
+        (v.oid, v.oid_index, v.snmp_type, v.root_oid) for v in expected
+    ]
+
+    # Octet strings are kept as bin, everything else is a str
+    assert records[0]['oid'] == 'sysDescr'
+    assert records[0]['snmp_type'] == 'OCTETSTR'
+    assert isinstance(records[0]['value'], bytes)
+    assert records[0]['value'].decode('latin-1') == expected[0].value
+
+    for record, var in zip(records, expected):
+        if var.oid == 'sysUpTimeInstance':
+            continue
+        value = record['value']
+        if isinstance(value, bytes):
+            value = value.decode('latin-1')
+        assert value == var.value
+
+
+def test_session_walk_export_invalid_format(sess_v2):
+    with pytest.raises(ValueError):
+        sess_v2.walk_export('system', format='arrow')
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+@pytest.mark.parametrize('parallel', [False, True])
+def test_session_iter_bulkwalk(sess, parallel):
+    oids = ['sysORID', 'ifDescr']
+    expected = sess.bulkwalk(oids, max_repetitions=3, parallel=parallel)
+
+    batches = list(
+        sess.iter_bulkwalk(oids, max_repetitions=3, parallel=parallel)
+    )
+    assert len(batches) > 1
+    assert all(batches)
+
+    res = [var for batch in batches for var in batch]
+    assert [(v.oid, v.oid_index, v.value) for v in res] == [
+        (v.oid, v.oid_index, v.value) for v in expected
+    ]
+
+
+def test_session_iter_bulkwalk_v1(sess_v1):
+    with pytest.raises(EasySNMPError):
+        sess_v1.iter_bulkwalk('system')
+
+
+def test_session_option_change_after_use(sess_v2):
+    res = sess_v2.get('sysUpTime.0')
+    assert res.oid == 'sysUpTimeInstance'
+
+    sess_v2.use_numeric = True
+    res = sess_v2.get('sysUpTime.0')
+    assert res.oid == '.1.3.6.1.2.1.1.3'
+    assert res.oid_index == '0'
+
+    sess_v2.max_varbinds_per_pdu = 0
+    res = sess_v2.get(['sysUpTime.0', 'sysContact.0'])
+    assert [var.oid for var in res] == [
+        '.1.3.6.1.2.1.1.3', '.1.3.6.1.2.1.1.4'
+    ]
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_oid_translation_cache(sess):
+    def walk():
+        return [
+            (var.oid, var.oid_index, var.snmp_type)
+            for var in sess.walk('system')
+        ]
+
+    first = walk()
+    assert walk() == first
+
+    interface.clear_oid_cache()
+    assert walk() == first
+
+    # the same tag with different indexes must not share a translation
+    res = sess.get([('sysORDescr', '1'), ('sysORDescr', '2')])
+    assert [var.oid_index for var in res] == ['1', '2']
+    assert res[0].value != res[1].value
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_prepare_get(sess):
+    request = sess.prepare(['sysContact.0', ('sysLocation', 0)])
+
+    for _ in range(3):
+        res = request.execute()
+        assert [(var.oid, var.oid_index, var.value) for var in res] == [
+            ('sysContact', '0', 'G. S. Marzot <gmarzot@marzot.net>'),
+            ('sysLocation', '0', 'my original location')
+        ]
+
+    # a prepared request may also be passed straight to its operation
+    assert sess.get(request)[0].value == res[0].value
+
+    res = sess.prepare('sysContact.0').execute()
+    assert res.oid == 'sysContact'
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_session_prepare_bulkwalk(sess):
+    request = sess.prepare(
+        ['sysORID', 'ifDescr'], op='bulkwalk', max_repetitions=3,
+        parallel=True
+    )
+    expected = sess.bulkwalk(
+        ['sysORID', 'ifDescr'], max_repetitions=3, parallel=True
+    )
+
+    for _ in range(2):
+        assert [(v.oid, v.oid_index, v.value) for v in request.execute()] == [
+            (v.oid, v.oid_index, v.value) for v in expected
+        ]
+
+
+def test_session_prepare_invalid(sess_v2):
+    with pytest.raises(ValueError):
+        sess_v2.prepare('sysContact.0', op='set')
+
+    with pytest.raises(EasySNMPUnknownObjectIDError):
+        sess_v2.prepare('sysDescripto.0')
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_get_varying_varlist_sizes(sess):
+    oids = ['sysContact.0', 'sysLocation.0', 'sysName.0', 'sysDescr.0']
+
+    # the per-call buffers are reused and grown from one call to the next
+    for count in [1, 4, 2, 4, 1]:
+        res = sess.get(oids[:count])
+        assert [var.oid for var in res] == [
+            oid.split('.')[0] for oid in oids[:count]
+        ]
+
+
+@pytest.mark.parametrize('sess', [sess_v1(), sess_v2(), sess_v3()])
+def test_session_output_formats_are_per_session(sess):
+    long_sess = Session(
+        hostname=sess.hostname, version=sess.version,
+        remote_port=sess.remote_port, community=sess.community,
+        security_level=sess.security_level,
+        security_username=sess.security_username,
+        privacy_password=sess.privacy_password,
+        auth_password=sess.auth_password, use_long_names=True
+    )
+
+    res = long_sess.get('sysContact.0')
+    assert res.oid.endswith('.mgmt.mib-2.system.sysContact')
+    assert res.oid_index == '0'
+
+    # formatting for one session leaves the others alone
+    res = sess.get('sysContact.0')
+    assert res.oid == 'sysContact'
+    assert res.oid_index == '0'
+
+
+def test_session_retry_no_such_remembers_missing(sess_v1):
+    sess_v1.retry_no_such = True
+    sess_v1.max_varbinds_per_pdu = 0
+    oids = ['sysUpTime.0', 'sysContact.1', 'sysName.0', 'sysName.1']
+
+    # Without missing_oid_ttl the agent is asked about every OID each time
+    sess_v1.get(oids)
+    sess_v1.stats(reset=True)
+    res = sess_v1.get(oids)
+    assert [var.snmp_type == 'NULL' for var in res] == [
+        False, True, False, True
+    ]
+    assert sess_v1.stats()['pdus_sent'] == 3
+
+    sess_v1.missing_oid_ttl = 60
+    res = sess_v1.get(oids)
+    assert len(res) == 4
+    assert [var.snmp_type == 'NULL' for var in res] == [
+        False, True, False, True
+    ]
+
+    # Knowing which OIDs the agent lacks, it is asked for the rest at once
+    sess_v1.stats(reset=True)
+    res = sess_v1.get(oids)
+    assert [var.snmp_type == 'NULL' for var in res] == [
+        False, True, False, True
+    ]
+    assert sess_v1.stats()['pdus_sent'] == 1
+
+
+@pytest.mark.parametrize('sess', [sess_v2(), sess_v3()])
+def test_session_missing_oid_ttl(sess):
+    sess.max_varbinds_per_pdu = 0
+    sess.missing_oid_ttl = 60
+    oids = ['sysDescr.100', 'iso']
+
+    res = sess.get(oids)
+    assert res[0].snmp_type == 'NOSUCHINSTANCE'
+    assert res[1].snmp_type == 'NOSUCHOBJECT'
+
+    # The missing OIDs are answered without asking the agent again
+    sess.stats(reset=True)
+    res = sess.get(oids + ['sysContact.0'])
+    assert res[0].snmp_type == 'NOSUCHINSTANCE'
+    assert res[1].snmp_type == 'NOSUCHOBJECT'
+    assert res[2].value == 'G. S. Marzot <gmarzot@marzot.net>'
+    assert sess.stats()['pdus_sent'] == 1
+
+    res = sess.get(oids)
+    assert res[0].snmp_type == 'NOSUCHINSTANCE'
+    assert res[1].snmp_type == 'NOSUCHOBJECT'
+    assert sess.stats()['pdus_sent'] == 1
+
+    # Disabling missing_oid_ttl forgets them
+    sess.missing_oid_ttl = 0
+    sess.get(oids)
+    assert sess.stats()['pdus_sent'] == 2
+
+
+def test_session_set_log_level(sess_v2, caplog):
+    def debug_records():
+        return [r for r in caplog.records
+                if r.name == 'easysnmp.interface' and
+                r.levelno == logging.DEBUG]
+
+    try:
+        # The level is picked up by the existing session straight away
+        set_log_level(logging.INFO)
+        caplog.clear()
+        sess_v2.get('sysContact.0')
+        assert not debug_records()
+
+        set_log_level(logging.DEBUG)
+        sess_v2.get('sysContact.0')
+        assert debug_records()
+    finally:
+        set_log_level(logging.NOTSET)
@@ -0,0 +1,116 @@
+from __future__ import unicode_literals
+
+import errno
+import os
+import socket
+import subprocess
+
+import pytest
+from easysnmp.traps import TrapListener
+
+
+def send_via_cli(command, port, *args):
+    """Sends a notification to localhost:port with snmptrap or snmpinform"""
+
+    dev_null = open(os.devnull, 'w')
+    return subprocess.Popen(
+        [command, '-c', 'public', 'localhost:{0}'.format(port)] +
+        list(args), stdout=dev_null, stderr=dev_null
+    )
+
+
+def receive(listener, count):
+    notifications = []
+    for _ in range(10):
+        notifications.extend(listener.receive(timeout=1))
+        if len(notifications) >= count:
+            break
+    return notifications
+
+
+@pytest.yield_fixture
+def listener():
+    listener = TrapListener(hostname='127.0.0.1', port=0)
+    yield listener
+    listener.close()
+
+
+def test_trap_listener_v2c_trap(listener):
+    send_via_cli(
+        'snmptrap', listener.port, '-v2c', '', 'SNMPv2-MIB::coldStart',
+        'sysContact.0', 's', 'trap contact'
+    ).communicate()
+
+    notification, = receive(listener, 1)
+    assert notification.version == 2
+    assert notification.pdu_type == 'trap2'
+    assert notification.community == 'public'
+    assert notification.source[0] == '127.0.0.1'
+    assert len(notification.varlist) == 3
+    assert notification.varlist[1].oid == 'snmpTrapOID'
+    assert notification.varlist[2].oid == 'sysContact'
+    assert notification.varlist[2].value == 'trap contact'
+    assert notification.trap_oid is not None
+
+
+def test_trap_listener_v1_trap():
+    with TrapListener(hostname='127.0.0.1', port=0,
+                      use_numeric=True) as listener:
+        send_via_cli(
+            'snmptrap', listener.port, '-v1', '.1.3.6.1.4.1.8072', '', '6',
+            '17', '', 'sysContact.0', 's', 'v1 contact'
+        ).communicate()
+
+        notification, = receive(listener, 1)
+        assert notification.version == 1
+        assert notification.pdu_type == 'trap'
+        assert notification.generic_trap == 6
+        assert notification.specific_trap == 17
+        assert notification.enterprise == '.1.3.6.1.4.1.8072'
+        assert notification.trap_oid == '.1.3.6.1.4.1.8072.0.17'
+        assert notification.varlist[0].oid == '.1.3.6.1.2.1.1.4'
+        assert notification.varlist[0].value == 'v1 contact'
+
+
+def test_trap_listener_inform_is_acknowledged(listener):
+    process = send_via_cli(
+        'snmpinform', listener.port, '-v2c', '-t', '2', '-r', '0', '',
+        'SNMPv2-MIB::warmStart'
+    )
+
+    notification, = receive(listener, 1)
+    assert notification.pdu_type == 'inform'
+
+    # snmpinform only succeeds once it has had its response
+    process.communicate()
+    assert process.returncode == 0
+
+
+def test_trap_listener_batches_and_drops(listener):
+    for _ in range(5):
+        send_via_cli(
+            'snmptrap', listener.port, '-v2c', '', 'SNMPv2-MIB::coldStart'
+        ).communicate()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.sendto(b'not a trap', ('127.0.0.1', listener.port))
+    sock.close()
+
+    notifications = receive(listener, 5)
+    assert len(notifications) == 5
+    assert all(n.pdu_type == 'trap2' for n in notifications)
+
+    assert listener.receive(timeout=0.5) == []
+    assert listener.dropped == 1
+
+
+def test_trap_listener_bad_option():
+    with pytest.raises(TypeError):
+        TrapListener(hostname='127.0.0.1', port=0, use_enums='yes')
+
+
+def test_trap_listener_port_in_use(listener):
+    # A second listener must not quietly share the port with the first
+    with pytest.raises(OSError) as excinfo:
+        TrapListener(hostname='127.0.0.1', port=listener.port)
+    assert excinfo.value.errno == errno.EADDRINUSE
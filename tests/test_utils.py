@@ -20,6 +20,17 @@ def test_strip_non_printable_only_binary():
     )
 
 
+def test_strip_non_printable_bytes():
+    assert strip_non_printable(b'\x14my thingo') == (
+        'my thingo (contains binary)'
+    )
+
+
+def test_strip_non_printable_native():
+    assert strip_non_printable(12345) == 12345
+    assert strip_non_printable((1, 3, 6, 1)) == (1, 3, 6, 1)
+
+
 def test_tostr_none():
     assert tostr(None) is None
 
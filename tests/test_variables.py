@@ -1,5 +1,7 @@
 from __future__ import unicode_literals
 
+import pickle
+
 from easysnmp.compat import ub
 from easysnmp.variables import SNMPVariable, SNMPVariableList
 
@@ -92,6 +94,35 @@ def test_snmp_variable_numeric():
     assert var.snmp_type is None
 
 
+def test_snmp_variable_attributes_converted():
+    var = SNMPVariable('sysUpTime', 0, 12345, 'TICKS')
+    assert var.oid_index == '0'
+    assert var.value == '12345'
+    assert var.real_value() == 12345
+
+
+def test_snmp_variable_pickle():
+    var = SNMPVariable('sysDescr', '0', 'my thingo', 'OCTETSTR')
+    var.root_oid = 'sysDescr'
+
+    copy = pickle.loads(pickle.dumps(var))
+    assert copy.oid == 'sysDescr'
+    assert copy.oid_index == '0'
+    assert copy.value == 'my thingo'
+    assert copy.snmp_type == 'OCTETSTR'
+    assert copy.root_oid == 'sysDescr'
+
+
+def test_snmp_variable_extra_attributes():
+    var = SNMPVariable('sysDescr', '0', 'my thingo', 'OCTETSTR')
+    var.polled_from = 'localhost'
+    assert var.polled_from == 'localhost'
+
+    copy = pickle.loads(pickle.dumps(var))
+    assert copy.polled_from == 'localhost'
+    assert copy.value == 'my thingo'
+
+
 def test_snmp_variable_list():
     varlist = SNMPVariableList(['sysContact.0', 'sysLocation.0', 'sysDescr.0'])
     assert varlist.varbinds == ['sysContact.0', 'sysLocation.0', 'sysDescr.0']